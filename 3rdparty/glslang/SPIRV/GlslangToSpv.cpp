@@ -7649,12 +7649,16 @@ void GlslangToSpv(const TIntermediate& intermediate, std::vector<unsigned int>&
     if (options == nullptr)
         options = &defaultOptions;
 
+    // The SPIR-V IR of the builder is allocated from this pool (see spvIR.h), so
+    // the traverser is destroyed before the pool is popped
     GetThreadPoolAllocator().push();
 
-    TGlslangToSpvTraverser it(intermediate.getSpv().spv, &intermediate, logger, *options);
-    root->traverse(&it);
-    it.finishSpv();
-    it.dumpSpv(spirv);
+    {
+        TGlslangToSpvTraverser it(intermediate.getSpv().spv, &intermediate, logger, *options);
+        root->traverse(&it);
+        it.finishSpv();
+        it.dumpSpv(spirv);
+    }
 
 #if ENABLE_OPT
     // If from HLSL, run spirv-opt to "legalize" the SPIR-V for Vulkan
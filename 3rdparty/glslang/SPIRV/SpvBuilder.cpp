@@ -153,19 +153,17 @@ Id Builder::makeSamplerType()
 Id Builder::makePointer(StorageClass storageClass, Id pointee)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypePointer].size(); ++t) {
-        type = groupedTypes[OpTypePointer][t];
-        if (type->getImmediateOperand(0) == (unsigned)storageClass &&
-            type->getIdOperand(1) == pointee)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { (unsigned)storageClass, pointee };
+    Instruction* type = findDedup(DedupTypes, { OpTypePointer, NoType, operands, 2 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypePointer);
     type->addImmediateOperand(storageClass);
     type->addIdOperand(pointee);
     groupedTypes[OpTypePointer].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -175,19 +173,17 @@ Id Builder::makePointer(StorageClass storageClass, Id pointee)
 Id Builder::makeIntegerType(int width, bool hasSign)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeInt].size(); ++t) {
-        type = groupedTypes[OpTypeInt][t];
-        if (type->getImmediateOperand(0) == (unsigned)width &&
-            type->getImmediateOperand(1) == (hasSign ? 1u : 0u))
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { (unsigned)width, hasSign ? 1u : 0u };
+    Instruction* type = findDedup(DedupTypes, { OpTypeInt, NoType, operands, 2 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeInt);
     type->addImmediateOperand(width);
     type->addImmediateOperand(hasSign ? 1 : 0);
     groupedTypes[OpTypeInt].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -210,17 +206,16 @@ Id Builder::makeIntegerType(int width, bool hasSign)
 Id Builder::makeFloatType(int width)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeFloat].size(); ++t) {
-        type = groupedTypes[OpTypeFloat][t];
-        if (type->getImmediateOperand(0) == (unsigned)width)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { (unsigned)width };
+    Instruction* type = findDedup(DedupTypes, { OpTypeFloat, NoType, operands, 1 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeFloat);
     type->addImmediateOperand(width);
     groupedTypes[OpTypeFloat].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -253,6 +248,7 @@ Id Builder::makeStructType(const std::vector<Id>& members, const char* name)
     for (int op = 0; op < (int)members.size(); ++op)
         type->addIdOperand(members[op]);
     groupedTypes[OpTypeStruct].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
     addName(type->getResultId(), name);
@@ -265,16 +261,10 @@ Id Builder::makeStructType(const std::vector<Id>& members, const char* name)
 Id Builder::makeStructResultType(Id type0, Id type1)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeStruct].size(); ++t) {
-        type = groupedTypes[OpTypeStruct][t];
-        if (type->getNumOperands() != 2)
-            continue;
-        if (type->getIdOperand(0) != type0 ||
-            type->getIdOperand(1) != type1)
-            continue;
+    const unsigned int operands[] = { type0, type1 };
+    Instruction* type = findDedup(DedupTypes, { OpTypeStruct, NoType, operands, 2 });
+    if (type)
         return type->getResultId();
-    }
 
     // not found, make it
     std::vector<spv::Id> members;
@@ -287,19 +277,17 @@ Id Builder::makeStructResultType(Id type0, Id type1)
 Id Builder::makeVectorType(Id component, int size)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeVector].size(); ++t) {
-        type = groupedTypes[OpTypeVector][t];
-        if (type->getIdOperand(0) == component &&
-            type->getImmediateOperand(1) == (unsigned)size)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { component, (unsigned)size };
+    Instruction* type = findDedup(DedupTypes, { OpTypeVector, NoType, operands, 2 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeVector);
     type->addIdOperand(component);
     type->addImmediateOperand(size);
     groupedTypes[OpTypeVector].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -313,19 +301,17 @@ Id Builder::makeMatrixType(Id component, int cols, int rows)
     Id column = makeVectorType(component, rows);
 
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeMatrix].size(); ++t) {
-        type = groupedTypes[OpTypeMatrix][t];
-        if (type->getIdOperand(0) == column &&
-            type->getImmediateOperand(1) == (unsigned)cols)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { column, (unsigned)cols };
+    Instruction* type = findDedup(DedupTypes, { OpTypeMatrix, NoType, operands, 2 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeMatrix);
     type->addIdOperand(column);
     type->addImmediateOperand(cols);
     groupedTypes[OpTypeMatrix].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -341,12 +327,10 @@ Id Builder::makeArrayType(Id element, Id sizeId, int stride)
     Instruction* type;
     if (stride == 0) {
         // try to find existing type
-        for (int t = 0; t < (int)groupedTypes[OpTypeArray].size(); ++t) {
-            type = groupedTypes[OpTypeArray][t];
-            if (type->getIdOperand(0) == element &&
-                type->getIdOperand(1) == sizeId)
-                return type->getResultId();
-        }
+        const unsigned int operands[] = { element, sizeId };
+        type = findDedup(DedupTypes, { OpTypeArray, NoType, operands, 2 });
+        if (type)
+            return type->getResultId();
     }
 
     // not found, make it
@@ -354,6 +338,7 @@ Id Builder::makeArrayType(Id element, Id sizeId, int stride)
     type->addIdOperand(element);
     type->addIdOperand(sizeId);
     groupedTypes[OpTypeArray].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -373,21 +358,13 @@ Id Builder::makeRuntimeArray(Id element)
 Id Builder::makeFunctionType(Id returnType, const std::vector<Id>& paramTypes)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeFunction].size(); ++t) {
-        type = groupedTypes[OpTypeFunction][t];
-        if (type->getIdOperand(0) != returnType || (int)paramTypes.size() != type->getNumOperands() - 1)
-            continue;
-        bool mismatch = false;
-        for (int p = 0; p < (int)paramTypes.size(); ++p) {
-            if (paramTypes[p] != type->getIdOperand(p + 1)) {
-                mismatch = true;
-                break;
-            }
-        }
-        if (! mismatch)
-            return type->getResultId();
-    }
+    std::vector<unsigned int> operands;
+    operands.reserve(paramTypes.size() + 1);
+    operands.push_back(returnType);
+    operands.insert(operands.end(), paramTypes.begin(), paramTypes.end());
+    Instruction* type = findDedup(DedupTypes, { OpTypeFunction, NoType, operands.data(), (int)operands.size() });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeFunction);
@@ -395,6 +372,7 @@ Id Builder::makeFunctionType(Id returnType, const std::vector<Id>& paramTypes)
     for (int p = 0; p < (int)paramTypes.size(); ++p)
         type->addIdOperand(paramTypes[p]);
     groupedTypes[OpTypeFunction].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -406,18 +384,11 @@ Id Builder::makeImageType(Id sampledType, Dim dim, bool depth, bool arrayed, boo
     assert(sampled == 1 || sampled == 2);
 
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeImage].size(); ++t) {
-        type = groupedTypes[OpTypeImage][t];
-        if (type->getIdOperand(0) == sampledType &&
-            type->getImmediateOperand(1) == (unsigned int)dim &&
-            type->getImmediateOperand(2) == (  depth ? 1u : 0u) &&
-            type->getImmediateOperand(3) == (arrayed ? 1u : 0u) &&
-            type->getImmediateOperand(4) == (     ms ? 1u : 0u) &&
-            type->getImmediateOperand(5) == sampled &&
-            type->getImmediateOperand(6) == (unsigned int)format)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { sampledType, (unsigned int)dim, depth ? 1u : 0u, arrayed ? 1u : 0u,
+                                      ms ? 1u : 0u, sampled, (unsigned int)format };
+    Instruction* type = findDedup(DedupTypes, { OpTypeImage, NoType, operands, 7 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeImage);
@@ -430,6 +401,7 @@ Id Builder::makeImageType(Id sampledType, Dim dim, bool depth, bool arrayed, boo
     type->addImmediateOperand((unsigned int)format);
 
     groupedTypes[OpTypeImage].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -485,18 +457,17 @@ Id Builder::makeImageType(Id sampledType, Dim dim, bool depth, bool arrayed, boo
 Id Builder::makeSampledImageType(Id imageType)
 {
     // try to find it
-    Instruction* type;
-    for (int t = 0; t < (int)groupedTypes[OpTypeSampledImage].size(); ++t) {
-        type = groupedTypes[OpTypeSampledImage][t];
-        if (type->getIdOperand(0) == imageType)
-            return type->getResultId();
-    }
+    const unsigned int operands[] = { imageType };
+    Instruction* type = findDedup(DedupTypes, { OpTypeSampledImage, NoType, operands, 1 });
+    if (type)
+        return type->getResultId();
 
     // not found, make it
     type = new Instruction(getUniqueId(), NoType, OpTypeSampledImage);
     type->addIdOperand(imageType);
 
     groupedTypes[OpTypeSampledImage].push_back(type);
+    addDedup(DedupTypes, type);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(type));
     module.mapInstruction(type);
 
@@ -660,34 +631,18 @@ bool Builder::containsType(Id typeId, spv::Op typeOp, int width) const
 
 // See if a scalar constant of this type has already been created, so it
 // can be reused rather than duplicated.  (Required by the specification).
-Id Builder::findScalarConstant(Op typeClass, Op opcode, Id typeId, unsigned value)
+Id Builder::findScalarConstant(Op /*typeClass*/, Op opcode, Id typeId, unsigned value)
 {
-    Instruction* constant;
-    for (int i = 0; i < (int)groupedConstants[typeClass].size(); ++i) {
-        constant = groupedConstants[typeClass][i];
-        if (constant->getOpCode() == opcode &&
-            constant->getTypeId() == typeId &&
-            constant->getImmediateOperand(0) == value)
-            return constant->getResultId();
-    }
-
-    return 0;
+    Instruction* constant = findDedup(DedupScalarConstants, { opcode, typeId, &value, 1 });
+    return constant ? constant->getResultId() : 0;
 }
 
 // Version of findScalarConstant (see above) for scalars that take two operands (e.g. a 'double' or 'int64').
-Id Builder::findScalarConstant(Op typeClass, Op opcode, Id typeId, unsigned v1, unsigned v2)
+Id Builder::findScalarConstant(Op /*typeClass*/, Op opcode, Id typeId, unsigned v1, unsigned v2)
 {
-    Instruction* constant;
-    for (int i = 0; i < (int)groupedConstants[typeClass].size(); ++i) {
-        constant = groupedConstants[typeClass][i];
-        if (constant->getOpCode() == opcode &&
-            constant->getTypeId() == typeId &&
-            constant->getImmediateOperand(0) == v1 &&
-            constant->getImmediateOperand(1) == v2)
-            return constant->getResultId();
-    }
-
-    return 0;
+    const unsigned int operands[] = { v1, v2 };
+    Instruction* constant = findDedup(DedupScalarConstants, { opcode, typeId, operands, 2 });
+    return constant ? constant->getResultId() : 0;
 }
 
 // Return true if consuming 'opcode' means consuming a constant.
@@ -774,6 +729,7 @@ Id Builder::makeIntConstant(Id typeId, unsigned value, bool specConstant)
     c->addImmediateOperand(value);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
     groupedConstants[OpTypeInt].push_back(c);
+    addDedup(DedupScalarConstants, c);
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -799,6 +755,7 @@ Id Builder::makeInt64Constant(Id typeId, unsigned long long value, bool specCons
     c->addImmediateOperand(op2);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
     groupedConstants[OpTypeInt].push_back(c);
+    addDedup(DedupScalarConstants, c);
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -824,6 +781,7 @@ Id Builder::makeFloatConstant(float f, bool specConstant)
     c->addImmediateOperand(value);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
     groupedConstants[OpTypeFloat].push_back(c);
+    addDedup(DedupScalarConstants, c);
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -852,6 +810,7 @@ Id Builder::makeDoubleConstant(double d, bool specConstant)
     c->addImmediateOperand(op2);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
     groupedConstants[OpTypeFloat].push_back(c);
+    addDedup(DedupScalarConstants, c);
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -880,6 +839,7 @@ Id Builder::makeFloat16Constant(float f16, bool specConstant)
     c->addImmediateOperand(value);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
     groupedConstants[OpTypeFloat].push_back(c);
+    addDedup(DedupScalarConstants, c);
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -906,54 +866,68 @@ Id Builder::makeFpConstant(Id type, double d, bool specConstant)
 
 Id Builder::findCompositeConstant(Op typeClass, const std::vector<Id>& comps)
 {
-    Instruction* constant = 0;
-    bool found = false;
-    for (int i = 0; i < (int)groupedConstants[typeClass].size(); ++i) {
-        constant = groupedConstants[typeClass][i];
+    Instruction* constant = findDedup(DedupCompositeConstants, { typeClass, NoType, comps.data(), (int)comps.size() });
+    return constant ? constant->getResultId() : NoResult;
+}
 
-        // same shape?
-        if (constant->getNumOperands() != (int)comps.size())
-            continue;
+Id Builder::findStructConstant(Id typeId, const std::vector<Id>& comps)
+{
+    Instruction* constant = findDedup(DedupStructConstants, { typeId, NoType, comps.data(), (int)comps.size() });
+    return constant ? constant->getResultId() : NoResult;
+}
 
-        // same contents?
-        bool mismatch = false;
-        for (int op = 0; op < constant->getNumOperands(); ++op) {
-            if (constant->getIdOperand(op) != comps[op]) {
-                mismatch = true;
-                break;
-            }
-        }
-        if (! mismatch) {
-            found = true;
-            break;
-        }
+// Key of an instruction in one of the dedup indexes, see DedupIndex
+Builder::DedupKey Builder::getDedupKey(DedupIndex index, const Instruction& inst) const
+{
+    switch (index) {
+    case DedupTypes:
+        return { inst.getOpCode(), NoType, inst.getOperands(), inst.getNumOperands() };
+    case DedupScalarConstants:
+        return { inst.getOpCode(), inst.getTypeId(), inst.getOperands(), inst.getNumOperands() };
+    case DedupCompositeConstants:
+        return { getTypeClass(inst.getTypeId()), NoType, inst.getOperands(), inst.getNumOperands() };
+    case DedupStructConstants:
+        return { inst.getTypeId(), NoType, inst.getOperands(), inst.getNumOperands() };
+    default:
+        assert(0);
+        return { 0, NoType, nullptr, 0 };
     }
-
-    return found ? constant->getResultId() : NoResult;
 }
 
-Id Builder::findStructConstant(Id typeId, const std::vector<Id>& comps)
+size_t Builder::hashDedupKey(const DedupKey& key)
 {
-    Instruction* constant = 0;
-    bool found = false;
-    for (int i = 0; i < (int)groupedStructConstants[typeId].size(); ++i) {
-        constant = groupedStructConstants[typeId][i];
+    // FNV-1a over the words of the key
+    unsigned long long hash = 14695981039346656037ull;
+    const auto addWord = [&hash](unsigned int word) {
+        hash = (hash ^ word) * 1099511628211ull;
+    };
+    addWord(key.group);
+    addWord(key.typeId);
+    for (int op = 0; op < key.numOperands; ++op)
+        addWord(key.operands[op]);
+    return (size_t)hash;
+}
 
-        // same contents?
-        bool mismatch = false;
-        for (int op = 0; op < constant->getNumOperands(); ++op) {
-            if (constant->getIdOperand(op) != comps[op]) {
-                mismatch = true;
-                break;
-            }
-        }
-        if (! mismatch) {
-            found = true;
-            break;
-        }
+Instruction* Builder::findDedup(DedupIndex index, const DedupKey& key) const
+{
+    auto range = dedupIndexes[index].equal_range(hashDedupKey(key));
+    for (auto it = range.first; it != range.second; ++it) {
+        DedupKey other = getDedupKey(index, *it->second);
+        if (other.group == key.group && other.typeId == key.typeId && other.numOperands == key.numOperands &&
+            std::equal(key.operands, key.operands + key.numOperands, other.operands))
+            return it->second;
     }
 
-    return found ? constant->getResultId() : NoResult;
+    return nullptr;
+}
+
+// Instructions that are not deduplicated on creation (spec constants, structs, strided arrays) can have the same
+// key as an earlier one, they are not indexed so that finding the key keeps returning the first instruction
+void Builder::addDedup(DedupIndex index, Instruction* inst)
+{
+    DedupKey key = getDedupKey(index, *inst);
+    if (! findDedup(index, key))
+        dedupIndexes[index].emplace(hashDedupKey(key), inst);
 }
 
 // Comments in header
@@ -989,10 +963,13 @@ Id Builder::makeCompositeConstant(Id typeId, const std::vector<Id>& members, boo
     for (int op = 0; op < (int)members.size(); ++op)
         c->addIdOperand(members[op]);
     constantsTypesGlobals.push_back(std::unique_ptr<Instruction>(c));
-    if (typeClass == OpTypeStruct)
+    if (typeClass == OpTypeStruct) {
         groupedStructConstants[typeId].push_back(c);
-    else
+        addDedup(DedupStructConstants, c);
+    } else {
         groupedConstants[typeClass].push_back(c);
+        addDedup(DedupCompositeConstants, c);
+    }
     module.mapInstruction(c);
 
     return c->getResultId();
@@ -646,6 +646,28 @@ public:
     Id findScalarConstant(Op typeClass, Op opcode, Id typeId, unsigned v1, unsigned v2);
     Id findCompositeConstant(Op typeClass, const std::vector<Id>& comps);
     Id findStructConstant(Id typeId, const std::vector<Id>& comps);
+
+    // Hash indexes of groupedTypes, groupedConstants and groupedStructConstants, so finding an existing
+    // type or constant doesn't scan its whole group.  A key is the group (type opcode, scalar constant
+    // opcode and type, composite constant type class, or struct type) and the operand words.  Only the
+    // first instruction of each key is indexed, which is the one that scanning the group finds.
+    enum DedupIndex {
+        DedupTypes,
+        DedupScalarConstants,
+        DedupCompositeConstants,
+        DedupStructConstants,
+        DedupIndexCount
+    };
+    struct DedupKey {
+        unsigned int group;
+        Id typeId;
+        const unsigned int* operands;
+        int numOperands;
+    };
+    DedupKey getDedupKey(DedupIndex, const Instruction&) const;
+    static size_t hashDedupKey(const DedupKey&);
+    Instruction* findDedup(DedupIndex, const DedupKey&) const;
+    void addDedup(DedupIndex, Instruction*);
     Id collapseAccessChain();
     void remapDynamicSwizzle();
     void transferAccessChainSwizzle(bool dynamic);
@@ -692,6 +714,7 @@ public:
     std::unordered_map<unsigned int, std::vector<Instruction*>> groupedConstants;       // map type opcodes to constant inst.
     std::unordered_map<unsigned int, std::vector<Instruction*>> groupedStructConstants; // map struct-id to constant instructions
     std::unordered_map<unsigned int, std::vector<Instruction*>> groupedTypes;           // map type opcodes to type instructions
+    std::unordered_multimap<size_t, Instruction*> dedupIndexes[DedupIndexCount];         // hash of DedupKey to instruction
 
     // stack of switches
     std::stack<Block*> switchMerges;
@@ -41,12 +41,19 @@
 //      - Block, which is a list of
 //        - Instruction
 //
+// Instructions, blocks and functions, and the operands of the instructions, are
+// allocated from the thread's current glslang pool allocator, like the nodes of
+// the intermediate tree.  A module doesn't do one heap allocation per
+// instruction this way, and all of it is released at once when the pool is
+// popped (see GlslangToSpv()), so the IR must not outlive that pool.
+//
 
 #pragma once
 #ifndef spvIR_H
 #define spvIR_H
 
 #include "spirv.hpp"
+#include "../glslang/Include/Common.h"
 
 #include <algorithm>
 #include <cassert>
@@ -90,6 +97,8 @@ struct IdImmediate {
 
 class Instruction {
 public:
+    POOL_ALLOCATOR_NEW_DELETE(glslang::GetThreadPoolAllocator())
+
     Instruction(Id resultId, Id typeId, Op opCode) : resultId(resultId), typeId(typeId), opCode(opCode), block(nullptr) { }
     explicit Instruction(Op opCode) : resultId(NoResult), typeId(NoType), opCode(opCode), block(nullptr) { }
     virtual ~Instruction() {}
@@ -146,6 +155,8 @@ public:
         assert(!idOperand[op]);
         return operands[op];
     }
+    // Words of all operands, both <id> and immediates
+    const unsigned int* getOperands() const { return operands.data(); }
 
     // Write out the binary form.
     void dump(std::vector<unsigned int>& out) const
@@ -175,8 +186,8 @@ protected:
     Id resultId;
     Id typeId;
     Op opCode;
-    std::vector<Id> operands;     // operands, both <id> and immediates (both are unsigned int)
-    std::vector<bool> idOperand;  // true for operands that are <id>, false for immediates
+    glslang::TVector<Id> operands;     // operands, both <id> and immediates (both are unsigned int)
+    glslang::TVector<bool> idOperand;  // true for operands that are <id>, false for immediates
     Block* block;
 };
 
@@ -186,6 +197,8 @@ protected:
 
 class Block {
 public:
+    POOL_ALLOCATOR_NEW_DELETE(glslang::GetThreadPoolAllocator())
+
     Block(Id id, Function& parent);
     virtual ~Block()
     {
@@ -197,8 +210,8 @@ public:
     void addInstruction(std::unique_ptr<Instruction> inst);
     void addPredecessor(Block* pred) { predecessors.push_back(pred); pred->successors.push_back(this);}
     void addLocalVariable(std::unique_ptr<Instruction> inst) { localVariables.push_back(std::move(inst)); }
-    const std::vector<Block*>& getPredecessors() const { return predecessors; }
-    const std::vector<Block*>& getSuccessors() const { return successors; }
+    const glslang::TVector<Block*>& getPredecessors() const { return predecessors; }
+    const glslang::TVector<Block*>& getSuccessors() const { return successors; }
     const std::vector<std::unique_ptr<Instruction> >& getInstructions() const {
         return instructions;
     }
@@ -250,7 +263,7 @@ protected:
     friend Function;
 
     std::vector<std::unique_ptr<Instruction> > instructions;
-    std::vector<Block*> predecessors, successors;
+    glslang::TVector<Block*> predecessors, successors;
     std::vector<std::unique_ptr<Instruction> > localVariables;
     Function& parent;
 
@@ -271,6 +284,8 @@ void inReadableOrder(Block* root, std::function<void(Block*)> callback);
 
 class Function {
 public:
+    POOL_ALLOCATOR_NEW_DELETE(glslang::GetThreadPoolAllocator())
+
     Function(Id id, Id resultType, Id functionType, Id firstParam, Module& parent);
     virtual ~Function()
     {
@@ -296,7 +311,7 @@ public:
     Module& getParent() const { return parent; }
     Block* getEntryBlock() const { return blocks.front(); }
     Block* getLastBlock() const { return blocks.back(); }
-    const std::vector<Block*>& getBlocks() const { return blocks; }
+    const glslang::TVector<Block*>& getBlocks() const { return blocks; }
     void addLocalVariable(std::unique_ptr<Instruction> inst);
     Id getReturnType() const { return functionInstruction.getTypeId(); }
 
@@ -324,8 +339,8 @@ protected:
 
     Module& parent;
     Instruction functionInstruction;
-    std::vector<Instruction*> parameterInstructions;
-    std::vector<Block*> blocks;
+    glslang::TVector<Instruction*> parameterInstructions;
+    glslang::TVector<Block*> blocks;
     bool implicitThis;  // true if this is a member function expecting to be passed a 'this' as the first argument
 };
 
@@ -130,6 +130,29 @@ private:
 #   endif
 };
 
+//
+// Source of the memory of pool allocators.  By default, pages come from
+// the heap, and go back to it when the pool is destroyed.  A process-wide
+// page allocator can be set with SetPoolPageAllocator(), and is used by all
+// the pools that are created after it.  It gets requests of whole pages
+// (single pages, or the multi-page allocations rounded up to the page size),
+// and they can be freed by a different thread than the one that allocated
+// them.  It must outlive all of the pools that use it.
+//
+class TPoolPageAllocator {
+public:
+    virtual ~TPoolPageAllocator() { }
+
+    // Page size of the pools that use this allocator, a multiple of the OS page size.
+    virtual size_t getPageSize() const = 0;
+
+    virtual void* allocate(size_t numBytes) = 0;
+    virtual void deallocate(void* memory, size_t numBytes) = 0;
+};
+
+TPoolPageAllocator* GetPoolPageAllocator();
+void SetPoolPageAllocator(TPoolPageAllocator* pageAllocator);
+
 //
 // There are several stacks.  One is to track the pushing and popping
 // of the user, and not yet implemented.  The others are simply a
@@ -213,6 +236,9 @@ protected:
     };
     typedef std::vector<tAllocState> tAllocStack;
 
+    tHeader* allocatePages(size_t numBytes);
+    void freePages(tHeader* page, size_t pageCount);
+
     // Track allocations if and only if we're using guard blocks
 #ifndef GUARD_BLOCKS
     void* initializeAllocation(tHeader*, unsigned char* memory, size_t) {
@@ -226,6 +252,7 @@ protected:
         return TAllocation::offsetAllocation(memory);
     }
 
+    TPoolPageAllocator* pageAllocator;  // null if pages are allocated from the heap
     size_t pageSize;        // granularity of allocation from the OS
     size_t alignment;       // all returned allocations will be aligned at
                             //      this granularity, which will be a power of 2
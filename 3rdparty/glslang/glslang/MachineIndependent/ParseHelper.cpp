@@ -272,7 +272,7 @@ void TParseContext::handlePragma(const TSourceLoc& loc, const TVector<TString>&
             error(loc, "extra tokens", "#pragma", "");
         intermediate.setUseVulkanMemoryModel();
     } else if (tokens[0].compare("once") == 0) {
-        warn(loc, "not implemented", "#pragma once", "");
+        // handled by the preprocessor, later includes of the file are skipped
     } else if (tokens[0].compare("glslang_binary_double_output") == 0)
         intermediate.setBinaryDoubleOutput();
 }
@@ -55,6 +55,19 @@ void SetThreadPoolAllocator(TPoolAllocator* poolAllocator)
     OS_SetTLSValue(PoolIndex, poolAllocator);
 }
 
+// Process-wide source of the pages of new pools, null for the heap.
+TPoolPageAllocator* PageAllocator = nullptr;
+
+TPoolPageAllocator* GetPoolPageAllocator()
+{
+    return PageAllocator;
+}
+
+void SetPoolPageAllocator(TPoolPageAllocator* pageAllocator)
+{
+    PageAllocator = pageAllocator;
+}
+
 // Process-wide set up of the TLS pool storage.
 bool InitializePoolIndex()
 {
@@ -70,7 +83,8 @@ bool InitializePoolIndex()
 // is documented in PoolAlloc.h.
 //
 TPoolAllocator::TPoolAllocator(int growthIncrement, int allocationAlignment) :
-    pageSize(growthIncrement),
+    pageAllocator(PageAllocator),
+    pageSize(PageAllocator ? PageAllocator->getPageSize() : growthIncrement),
     alignment(allocationAlignment),
     freeList(nullptr),
     inUseList(nullptr),
@@ -118,8 +132,9 @@ TPoolAllocator::~TPoolAllocator()
 {
     while (inUseList) {
         tHeader* next = inUseList->nextPage;
+        size_t pageCount = inUseList->pageCount;
         inUseList->~tHeader();
-        delete [] reinterpret_cast<char*>(inUseList);
+        freePages(inUseList, pageCount);
         inUseList = next;
     }
 
@@ -132,11 +147,32 @@ TPoolAllocator::~TPoolAllocator()
     //
     while (freeList) {
         tHeader* next = freeList->nextPage;
-        delete [] reinterpret_cast<char*>(freeList);
+        freePages(freeList, 1);
         freeList = next;
     }
 }
 
+//
+// Get memory for a new page, or a multi-page allocation of 'numBytes'.
+//
+TPoolAllocator::tHeader* TPoolAllocator::allocatePages(size_t numBytes)
+{
+    if (pageAllocator) {
+        size_t pageCount = (numBytes + pageSize - 1) / pageSize;
+        return reinterpret_cast<tHeader*>(pageAllocator->allocate(pageCount * pageSize));
+    }
+
+    return reinterpret_cast<tHeader*>(::new char[numBytes]);
+}
+
+void TPoolAllocator::freePages(tHeader* page, size_t pageCount)
+{
+    if (pageAllocator)
+        pageAllocator->deallocate(page, pageCount * pageSize);
+    else
+        delete [] reinterpret_cast<char*>(page);
+}
+
 const unsigned char TAllocation::guardBlockBeginVal = 0xfb;
 const unsigned char TAllocation::guardBlockEndVal   = 0xfe;
 const unsigned char TAllocation::userDataFill       = 0xcd;
@@ -209,7 +245,7 @@ void TPoolAllocator::pop()
         inUseList->~tHeader(); // currently, just a debug allocation checker
 
         if (pageCount > 1) {
-            delete [] reinterpret_cast<char*>(inUseList);
+            freePages(inUseList, pageCount);
         } else {
             inUseList->nextPage = freeList;
             freeList = inUseList;
@@ -266,7 +302,7 @@ void* TPoolAllocator::allocate(size_t numBytes)
         // The OS is efficient and allocating and free-ing multiple pages.
         //
         size_t numBytesToAlloc = allocationSize + headerSkip;
-        tHeader* memory = reinterpret_cast<tHeader*>(::new char[numBytesToAlloc]);
+        tHeader* memory = allocatePages(numBytesToAlloc);
         if (memory == 0)
             return 0;
 
@@ -288,7 +324,7 @@ void* TPoolAllocator::allocate(size_t numBytes)
         memory = freeList;
         freeList = freeList->nextPage;
     } else {
-        memory = reinterpret_cast<tHeader*>(::new char[pageSize]);
+        memory = allocatePages(pageSize);
         if (memory == 0)
             return 0;
     }
@@ -50,16 +50,149 @@
 #include "glslang_tab.cpp.h"
 #include "ScanContext.h"
 #include "Scan.h"
+#include "../Public/ShaderLang.h"
 
 // preprocessor includes
 #include "preprocessor/PpContext.h"
 #include "preprocessor/PpTokens.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define GLSLANG_SCAN_SSE2
+    #include <emmintrin.h>
+#endif
+
 // Required to avoid missing prototype warnings for some compilers
 int yylex(YYSTYPE*, glslang::TParseContext&);
 
 namespace glslang {
 
+namespace {
+
+#ifdef GLSLANG_SCAN_SSE2
+
+inline int FirstBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+inline int LastBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse(&index, mask);
+    return (int)index;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+}
+
+inline int CountBits(unsigned int mask)
+{
+#ifdef _MSC_VER
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1)
+        ++count;
+    return count;
+#else
+    return __builtin_popcount(mask);
+#endif
+}
+
+// Bits of the 16 characters at 'p' that are 'c'
+inline unsigned int MatchMask(__m128i chars, char c)
+{
+    return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8(c)));
+}
+
+#endif // GLSLANG_SCAN_SSE2
+
+// Returns the number of leading characters of 'text' that are not 'a', 'b' or 'c', and counts the '\n' in them
+size_t ScanUntil(const unsigned char* text, size_t length, char a, char b, char c, int& newlines, size_t& lastNewline)
+{
+    size_t i = 0;
+#ifdef GLSLANG_SCAN_SSE2
+    for (; i + 16 <= length; i += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        unsigned int stop = MatchMask(chars, a) | MatchMask(chars, b) | MatchMask(chars, c);
+        unsigned int lines = MatchMask(chars, '\n');
+        if (stop != 0)
+            lines &= (1u << FirstBit(stop)) - 1;
+        if (lines != 0) {
+            newlines += CountBits(lines);
+            lastNewline = i + LastBit(lines);
+        }
+        if (stop != 0)
+            return i + FirstBit(stop);
+    }
+#endif
+    for (; i < length; ++i) {
+        char ch = (char)text[i];
+        if (ch == a || ch == b || ch == c)
+            break;
+        if (ch == '\n') {
+            ++newlines;
+            lastNewline = i;
+        }
+    }
+
+    return i;
+}
+
+// Returns the number of leading characters of 'text' that are ' ' or '\t'
+size_t ScanSpaceTab(const unsigned char* text, size_t length)
+{
+    size_t i = 0;
+#ifdef GLSLANG_SCAN_SSE2
+    for (; i + 16 <= length; i += 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        unsigned int other = ~(MatchMask(chars, ' ') | MatchMask(chars, '\t')) & 0xffff;
+        if (other != 0)
+            return i + FirstBit(other);
+    }
+#endif
+    while (i < length && (text[i] == ' ' || text[i] == '\t'))
+        ++i;
+
+    return i;
+}
+
+} // end anonymous namespace
+
+void TInputScanner::skipSpaceTab()
+{
+    size_t length = skippableLength();
+    if (length > 0)
+        skip(ScanSpaceTab(sources[currentSource] + currentChar, length), 0, 0);
+}
+
+void TInputScanner::skipLineCommentText()
+{
+    size_t length = skippableLength();
+    if (length > 0) {
+        int newlines = 0;
+        size_t lastNewline = 0;
+        // '\n' is a stop character here, so it's never counted
+        skip(ScanUntil(sources[currentSource] + currentChar, length, '\n', '\r', '\\', newlines, lastNewline), 0, 0);
+    }
+}
+
+void TInputScanner::skipBlockCommentText()
+{
+    size_t length = skippableLength();
+    if (length > 0) {
+        int newlines = 0;
+        size_t lastNewline = 0;
+        size_t count = ScanUntil(sources[currentSource] + currentChar, length, '*', '\r', '\\', newlines, lastNewline);
+        skip(count, newlines, lastNewline);
+    }
+}
+
 // read past any white space
 void TInputScanner::consumeWhiteSpace(bool& foundNonSpaceTab)
 {
@@ -86,8 +219,10 @@ bool TInputScanner::consumeComment()
         get();  // consume the second '/'
         c = get();
         do {
-            while (c != EndOfInput && c != '\\' && c != '\r' && c != '\n')
+            while (c != EndOfInput && c != '\\' && c != '\r' && c != '\n') {
+                skipLineCommentText();
                 c = get();
+            }
 
             if (c == EndOfInput || c == '\r' || c == '\n') {
                 while (c == '\r' || c == '\n')
@@ -119,8 +254,10 @@ bool TInputScanner::consumeComment()
         get();  // consume the '*'
         c = get();
         do {
-            while (c != EndOfInput && c != '*')
+            while (c != EndOfInput && c != '*') {
+                skipBlockCommentText();
                 c = get();
+            }
             if (c == '*') {
                 c = get();
                 if (c == '/')
@@ -326,6 +463,8 @@ struct str_hash
 std::unordered_map<const char*, int, str_hash, str_eq>* KeywordMap = nullptr;
 std::unordered_set<const char*, str_hash, str_eq>* ReservedSet = nullptr;
 
+glslang::TPreprocessorObserver* PreprocessorObserver = nullptr;
+
 };
 
 namespace glslang {
@@ -759,6 +898,11 @@ void TScanContext::deleteKeywordMap()
     ReservedSet = nullptr;
 }
 
+void SetPreprocessorObserver(TPreprocessorObserver* observer)
+{
+    PreprocessorObserver = observer;
+}
+
 // Called by yylex to get the next token.
 // Returning 0 implies end of input.
 int TScanContext::tokenize(TPpContext* pp, TParserToken& token)
@@ -766,7 +910,13 @@ int TScanContext::tokenize(TPpContext* pp, TParserToken& token)
     do {
         parserToken = &token;
         TPpToken ppToken;
-        int token = pp->tokenize(ppToken);
+        int token;
+        if (PreprocessorObserver != nullptr) {
+            PreprocessorObserver->beginTokenize();
+            token = pp->tokenize(ppToken);
+            PreprocessorObserver->endTokenize();
+        } else
+            token = pp->tokenize(ppToken);
         if (token == EndOfInput)
             return 0;
 
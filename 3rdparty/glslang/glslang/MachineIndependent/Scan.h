@@ -221,7 +221,38 @@ public:
     void consumeWhitespaceComment(bool& foundNonSpaceTab);
     bool scanVersion(int& version, EProfile& profile, bool& notFirstToken);
 
+    // Fast paths for the preprocessor, to skip runs of characters that need no processing in bulk,
+    // instead of a get() per character.  They stop in front of anything get() or the caller has to
+    // handle itself, stay within the current string, and never skip its last character, so moving to
+    // the next string is still done by get().
+    void skipSpaceTab();            // skips ' ' and '\t'
+    void skipLineCommentText();     // skips up to '\n', '\r' or '\\'
+    void skipBlockCommentText();    // skips up to '*', '\r' or '\\', counting the newlines
+
 protected:
+    // number of characters that can be skipped in bulk in the current string
+    size_t skippableLength() const
+    {
+        if (currentSource >= numSources || currentChar + 1 >= lengths[currentSource])
+            return 0;
+        return lengths[currentSource] - currentChar - 1;
+    }
+
+    // moves over 'count' characters of the current string, 'newlines' of them are '\n' and the
+    // last one is at 'lastNewline'
+    void skip(size_t count, int newlines, size_t lastNewline)
+    {
+        currentChar += count;
+        if (newlines > 0) {
+            loc[currentSource].line += newlines;
+            logicalSourceLoc.line += newlines;
+            loc[currentSource].column = (int)(count - lastNewline - 1);
+            logicalSourceLoc.column = (int)(count - lastNewline - 1);
+        } else {
+            loc[currentSource].column += (int)count;
+            logicalSourceLoc.column += (int)count;
+        }
+    }
 
     // advance one character
     void advance()
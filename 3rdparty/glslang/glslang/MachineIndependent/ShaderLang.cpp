@@ -282,97 +282,92 @@ int CommonIndex(EProfile profile, EShLanguage language)
 }
 
 //
-// To initialize per-stage shared tables, with the common table already complete.
+// Returns true if the version/profile has built-ins for the stage.
 //
-void InitializeStageSymbolTable(TBuiltInParseables& builtInParseables, int version, EProfile profile, const SpvVersion& spvVersion,
-                                EShLanguage language, EShSource source, TInfoSink& infoSink, TSymbolTable** commonTable,
-                                TSymbolTable** symbolTables)
+bool IsStageSupported(int version, EProfile profile, EShLanguage language)
 {
-    (*symbolTables[language]).adoptLevels(*commonTable[CommonIndex(profile, language)]);
-    InitializeSymbolTable(builtInParseables.getStageString(language), version, profile, spvVersion, language, source,
-                          infoSink, *symbolTables[language]);
-    builtInParseables.identifyBuiltIns(version, profile, spvVersion, language, *symbolTables[language]);
-    if (profile == EEsProfile && version >= 300)
-        (*symbolTables[language]).setNoBuiltInRedeclarations();
-    if (version == 110)
-        (*symbolTables[language]).setSeparateNameSpaces();
+    switch (language) {
+    // always have vertex and fragment
+    case EShLangVertex:
+    case EShLangFragment:
+        return true;
+
+    // check for tessellation and geometry
+    case EShLangTessControl:
+    case EShLangTessEvaluation:
+    case EShLangGeometry:
+        return (profile != EEsProfile && version >= 150) ||
+               (profile == EEsProfile && version >= 310);
+
+    // check for compute
+    case EShLangCompute:
+        return (profile != EEsProfile && version >= 420) ||
+               (profile == EEsProfile && version >= 310);
+
+#ifdef NV_EXTENSIONS
+    // check for ray tracing, mesh and task stages
+    case EShLangRayGenNV:
+    case EShLangIntersectNV:
+    case EShLangAnyHitNV:
+    case EShLangClosestHitNV:
+    case EShLangMissNV:
+    case EShLangMeshNV:
+    case EShLangTaskNV:
+        return profile != EEsProfile && version >= 450;
+#endif
+
+    default:
+        return false;
+    }
 }
 
 //
-// Initialize the full set of shareable symbol tables;
-// The common (cross-stage) and those shareable per-stage.
+// Initialize the common (cross-stage) tables.
 //
-bool InitializeSymbolTables(TInfoSink& infoSink, TSymbolTable** commonTable,  TSymbolTable** symbolTables, int version, EProfile profile, const SpvVersion& spvVersion, EShSource source)
+// The per-stage tables are built separately, only for the stages that are actually compiled, but
+// identifyBuiltIns() of every stage also tags the common built-ins.  So those are tagged here for all
+// the stages, with only the common levels in the table, the same way as if all the stage tables
+// were built together with them.
+//
+void InitializeCommonSymbolTables(TBuiltInParseables& builtInParseables, int version, EProfile profile,
+                                  const SpvVersion& spvVersion, EShSource source, TInfoSink& infoSink,
+                                  TSymbolTable** commonTable)
 {
-    std::unique_ptr<TBuiltInParseables> builtInParseables(CreateBuiltInParseables(infoSink, source));
-
-    if (builtInParseables == nullptr)
-        return false;
-
-    builtInParseables->initialize(version, profile, spvVersion);
-
-    // do the common tables
-    InitializeSymbolTable(builtInParseables->getCommonString(), version, profile, spvVersion, EShLangVertex, source,
+    InitializeSymbolTable(builtInParseables.getCommonString(), version, profile, spvVersion, EShLangVertex, source,
                           infoSink, *commonTable[EPcGeneral]);
     if (profile == EEsProfile)
-        InitializeSymbolTable(builtInParseables->getCommonString(), version, profile, spvVersion, EShLangFragment, source,
+        InitializeSymbolTable(builtInParseables.getCommonString(), version, profile, spvVersion, EShLangFragment, source,
                               infoSink, *commonTable[EPcFragment]);
 
-    // do the per-stage tables
-
-    // always have vertex and fragment
-    InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangVertex, source,
-                               infoSink, commonTable, symbolTables);
-    InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangFragment, source,
-                               infoSink, commonTable, symbolTables);
-
-    // check for tessellation
-    if ((profile != EEsProfile && version >= 150) ||
-        (profile == EEsProfile && version >= 310)) {
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangTessControl, source,
-                                   infoSink, commonTable, symbolTables);
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangTessEvaluation, source,
-                                   infoSink, commonTable, symbolTables);
-    }
-
-    // check for geometry
-    if ((profile != EEsProfile && version >= 150) ||
-        (profile == EEsProfile && version >= 310))
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangGeometry, source,
-                                   infoSink, commonTable, symbolTables);
-
-    // check for compute
-    if ((profile != EEsProfile && version >= 420) ||
-        (profile == EEsProfile && version >= 310))
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangCompute, source,
-                                   infoSink, commonTable, symbolTables);
+    for (int stage = 0; stage < EShLangCount; ++stage) {
+        if (! IsStageSupported(version, profile, (EShLanguage)stage))
+            continue;
 
-#ifdef NV_EXTENSIONS
-    // check for ray tracing stages
-    if (profile != EEsProfile && version >= 450) {
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangRayGenNV, source,
-            infoSink, commonTable, symbolTables);
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangIntersectNV, source,
-            infoSink, commonTable, symbolTables);
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangAnyHitNV, source,
-            infoSink, commonTable, symbolTables);
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangClosestHitNV, source,
-            infoSink, commonTable, symbolTables);
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangMissNV, source,
-            infoSink, commonTable, symbolTables);
+        TSymbolTable commonLevels;
+        commonLevels.adoptLevels(*commonTable[CommonIndex(profile, (EShLanguage)stage)]);
+        builtInParseables.identifyBuiltIns(version, profile, spvVersion, (EShLanguage)stage, commonLevels);
     }
-    // check for mesh
-    if (profile != EEsProfile && version >= 450)
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangMeshNV, source,
-                                   infoSink, commonTable, symbolTables);
-
-    // check for task
-    if (profile != EEsProfile && version >= 450)
-        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, EShLangTaskNV, source,
-                                   infoSink, commonTable, symbolTables);
-#endif
+}
 
-    return true;
+//
+// To initialize a per-stage shared table, with the common table already complete.
+//
+// 'commonLevels' stands in for the common table, it has the same number of (empty) levels and the same
+// symbol ids, so the stage table can be attached to the real common table with copyTable(), but
+// identifyBuiltIns() doesn't tag the common built-ins a second time.
+//
+void InitializeStageSymbolTable(TBuiltInParseables& builtInParseables, int version, EProfile profile, const SpvVersion& spvVersion,
+                                EShLanguage language, EShSource source, TInfoSink& infoSink, TSymbolTable& commonLevels,
+                                TSymbolTable& symbolTable)
+{
+    symbolTable.adoptLevels(commonLevels);
+    InitializeSymbolTable(builtInParseables.getStageString(language), version, profile, spvVersion, language, source,
+                          infoSink, symbolTable);
+    builtInParseables.identifyBuiltIns(version, profile, spvVersion, language, symbolTable);
+    if (profile == EEsProfile && version >= 300)
+        symbolTable.setNoBuiltInRedeclarations();
+    if (version == 110)
+        symbolTable.setSeparateNameSpaces();
 }
 
 bool AddContextSpecificSymbols(const TBuiltInResource* resources, TInfoSink& infoSink, TSymbolTable& symbolTable, int version,
@@ -400,21 +395,28 @@ bool AddContextSpecificSymbols(const TBuiltInResource* resources, TInfoSink& inf
 //  - Switch back to the original thread's pool
 //
 // This only gets done the first time any thread needs a particular symbol table
-// (lazy evaluation).
+// (lazy evaluation).  The common tables are built with the first stage of a
+// version/profile combination, and every stage table is built the first time
+// that stage is compiled, so the built-ins of unused stages are never parsed.
 //
-void SetupBuiltinSymbolTable(int version, EProfile profile, const SpvVersion& spvVersion, EShSource source)
+void SetupBuiltinSymbolTable(int version, EProfile profile, const SpvVersion& spvVersion, EShSource source,
+                             EShLanguage language)
 {
     TInfoSink infoSink;
 
     // Make sure only one thread tries to do this at a time
     glslang::GetGlobalLock();
 
-    // See if it's already been done for this version/profile combination
+    // See if it's already been done for this version/profile/stage combination
     int versionIndex = MapVersionToIndex(version);
     int spvVersionIndex = MapSpvVersionToIndex(spvVersion);
     int profileIndex = MapProfileToIndex(profile);
     int sourceIndex = MapSourceToIndex(source);
-    if (CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex][EPcGeneral]) {
+    TSymbolTable** globalCommonTable = CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex];
+    TSymbolTable*& globalStageTable = SharedSymbolTables[versionIndex][spvVersionIndex][profileIndex][sourceIndex][language];
+    bool buildCommon = globalCommonTable[EPcGeneral] == nullptr;
+    bool buildStage = globalStageTable == nullptr && IsStageSupported(version, profile, language);
+    if (! buildCommon && ! buildStage) {
         glslang::ReleaseGlobalLock();
 
         return;
@@ -425,44 +427,60 @@ void SetupBuiltinSymbolTable(int version, EProfile profile, const SpvVersion& sp
     TPoolAllocator* builtInPoolAllocator = new TPoolAllocator;
     SetThreadPoolAllocator(builtInPoolAllocator);
 
-    // Dynamically allocate the local symbol tables so we can control when they are deallocated WRT when the pool is popped.
-    TSymbolTable* commonTable[EPcCount];
-    TSymbolTable* stageTables[EShLangCount];
-    for (int precClass = 0; precClass < EPcCount; ++precClass)
-        commonTable[precClass] = new TSymbolTable;
-    for (int stage = 0; stage < EShLangCount; ++stage)
-        stageTables[stage] = new TSymbolTable;
-
-    // Generate the local symbol tables using the new pool
-    InitializeSymbolTables(infoSink, commonTable, stageTables, version, profile, spvVersion, source);
-
-    // Switch to the process-global pool
-    SetThreadPoolAllocator(PerProcessGPA);
-
-    // Copy the local symbol tables from the new pool to the global tables using the process-global pool
-    for (int precClass = 0; precClass < EPcCount; ++precClass) {
-        if (! commonTable[precClass]->isEmpty()) {
-            CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex][precClass] = new TSymbolTable;
-            CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex][precClass]->copyTable(*commonTable[precClass]);
-            CommonSymbolTable[versionIndex][spvVersionIndex][profileIndex][sourceIndex][precClass]->readOnly();
-        }
-    }
-    for (int stage = 0; stage < EShLangCount; ++stage) {
-        if (! stageTables[stage]->isEmpty()) {
-            SharedSymbolTables[versionIndex][spvVersionIndex][profileIndex][sourceIndex][stage] = new TSymbolTable;
-            SharedSymbolTables[versionIndex][spvVersionIndex][profileIndex][sourceIndex][stage]->adoptLevels(*CommonSymbolTable
-                              [versionIndex][spvVersionIndex][profileIndex][sourceIndex][CommonIndex(profile, (EShLanguage)stage)]);
-            SharedSymbolTables[versionIndex][spvVersionIndex][profileIndex][sourceIndex][stage]->copyTable(*stageTables[stage]);
-            SharedSymbolTables[versionIndex][spvVersionIndex][profileIndex][sourceIndex][stage]->readOnly();
+    // The built-in strings are generated for all the stages at once, they're cheap compared to parsing them
+    std::unique_ptr<TBuiltInParseables> builtInParseables(CreateBuiltInParseables(infoSink, source));
+    if (builtInParseables != nullptr)
+        builtInParseables->initialize(version, profile, spvVersion);
+    else
+        buildCommon = buildStage = false;
+
+    if (buildCommon) {
+        // Dynamically allocate the local symbol tables so we can control when they are deallocated WRT when the pool is popped.
+        TSymbolTable* commonTable[EPcCount];
+        for (int precClass = 0; precClass < EPcCount; ++precClass)
+            commonTable[precClass] = new TSymbolTable;
+
+        // Generate the local symbol tables using the new pool
+        InitializeCommonSymbolTables(*builtInParseables, version, profile, spvVersion, source, infoSink, commonTable);
+
+        // Copy the local symbol tables from the new pool to the global tables using the process-global pool
+        SetThreadPoolAllocator(PerProcessGPA);
+        for (int precClass = 0; precClass < EPcCount; ++precClass) {
+            if (! commonTable[precClass]->isEmpty()) {
+                globalCommonTable[precClass] = new TSymbolTable;
+                globalCommonTable[precClass]->copyTable(*commonTable[precClass]);
+                globalCommonTable[precClass]->readOnly();
+            }
         }
+        SetThreadPoolAllocator(builtInPoolAllocator);
+
+        // Clean up the local tables before deleting the pool they used.
+        for (int precClass = 0; precClass < EPcCount; ++precClass)
+            delete commonTable[precClass];
     }
 
-    // Clean up the local tables before deleting the pool they used.
-    for (int precClass = 0; precClass < EPcCount; ++precClass)
-        delete commonTable[precClass];
-    for (int stage = 0; stage < EShLangCount; ++stage)
-        delete stageTables[stage];
+    if (buildStage) {
+        TSymbolTable& commonTable = *globalCommonTable[CommonIndex(profile, language)];
+        TSymbolTable* commonLevels = new TSymbolTable;
+        TSymbolTable* stageTable = new TSymbolTable;
+        commonLevels->push();
+        commonLevels->setMaxSymbolId(commonTable.getMaxSymbolId());
+
+        InitializeStageSymbolTable(*builtInParseables, version, profile, spvVersion, language, source, infoSink,
+                                   *commonLevels, *stageTable);
+
+        SetThreadPoolAllocator(PerProcessGPA);
+        globalStageTable = new TSymbolTable;
+        globalStageTable->adoptLevels(commonTable);
+        globalStageTable->copyTable(*stageTable);
+        globalStageTable->readOnly();
+        SetThreadPoolAllocator(builtInPoolAllocator);
+
+        delete stageTable;
+        delete commonLevels;
+    }
 
+    builtInParseables.reset();
     delete builtInPoolAllocator;
     SetThreadPoolAllocator(&previousAllocator);
 
@@ -775,7 +793,8 @@ bool ProcessDeferred(
     bool requireNonempty,
     TShader::Includer& includer,
     const std::string sourceEntryPointName = "",
-    const TEnvironment* environment = nullptr)  // optional way of fully setting all versions, overriding the above
+    const TEnvironment* environment = nullptr,  // optional way of fully setting all versions, overriding the above
+    bool builtInSymbols = true) // false when only preprocessing, which doesn't need the built-in symbol tables
 {
     // This must be undone (.pop()) by the caller, after it finishes consuming the created tree.
     GetThreadPoolAllocator().push();
@@ -876,24 +895,26 @@ bool ProcessDeferred(
         for (int s = 0; s < numStrings; ++s)
             intermediate.addSourceText(strings[numPre + s]);
     }
-    SetupBuiltinSymbolTable(version, profile, spvVersion, source);
-
-    TSymbolTable* cachedTable = SharedSymbolTables[MapVersionToIndex(version)]
-                                                  [MapSpvVersionToIndex(spvVersion)]
-                                                  [MapProfileToIndex(profile)]
-                                                  [MapSourceToIndex(source)]
-                                                  [stage];
-
     // Dynamically allocate the symbol table so we can control when it is deallocated WRT the pool.
     std::unique_ptr<TSymbolTable> symbolTable(new TSymbolTable);
-    if (cachedTable)
-        symbolTable->adoptLevels(*cachedTable);
 
-    // Add built-in symbols that are potentially context dependent;
-    // they get popped again further down.
-    if (! AddContextSpecificSymbols(resources, compiler->infoSink, *symbolTable, version, profile, spvVersion,
-                                    stage, source)) {
-        return false;
+    if (builtInSymbols) {
+        SetupBuiltinSymbolTable(version, profile, spvVersion, source, stage);
+
+        TSymbolTable* cachedTable = SharedSymbolTables[MapVersionToIndex(version)]
+                                                      [MapSpvVersionToIndex(spvVersion)]
+                                                      [MapProfileToIndex(profile)]
+                                                      [MapSourceToIndex(source)]
+                                                      [stage];
+        if (cachedTable)
+            symbolTable->adoptLevels(*cachedTable);
+
+        // Add built-in symbols that are potentially context dependent;
+        // they get popped again further down.
+        if (! AddContextSpecificSymbols(resources, compiler->infoSink, *symbolTable, version, profile, spvVersion,
+                                        stage, source)) {
+            return false;
+        }
     }
 
     //
@@ -1198,14 +1219,15 @@ bool PreprocessDeferred(
     EShMessages messages,       // warnings/errors/AST; things to print out
     TShader::Includer& includer,
     TIntermediate& intermediate, // returned tree, etc.
-    std::string* outputString)
+    std::string* outputString,
+    const TEnvironment* environment = nullptr)
 {
     DoPreprocessing parser(outputString);
     return ProcessDeferred(compiler, shaderStrings, numStrings, inputLengths, stringNames,
                            preamble, optLevel, resources, defaultVersion,
                            defaultProfile, forceDefaultVersionAndProfile,
                            forwardCompatible, messages, intermediate, parser,
-                           false, includer);
+                           false, includer, "", environment, false);
 }
 
 //
@@ -1806,7 +1828,8 @@ bool TShader::preprocess(const TBuiltInResource* builtInResources,
     return PreprocessDeferred(compiler, strings, numStrings, lengths, stringNames, preamble,
                               EShOptNone, builtInResources, defaultVersion,
                               defaultProfile, forceDefaultVersionAndProfile,
-                              forwardCompatible, message, includer, *intermediate, output_string);
+                              forwardCompatible, message, includer, *intermediate, output_string,
+                              &environment);
 }
 
 const char* TShader::getInfoLog()
@@ -233,16 +233,10 @@ TSymbolTableLevel::~TSymbolTableLevel()
 //
 void TSymbolTableLevel::relateToOperator(const char* name, TOperator op)
 {
-    tLevel::const_iterator candidate = level.lower_bound(name);
-    while (candidate != level.end()) {
-        const TString& candidateName = (*candidate).first;
-        TString::size_type parenAt = candidateName.find_first_of('(');
-        if (parenAt != candidateName.npos && candidateName.compare(0, parenAt, name) == 0) {
-            TFunction* function = (*candidate).second->getAsFunction();
+    const tFunctionList* candidates = findFunctionList(name);
+    if (candidates) {
+        for (TFunction* function : *candidates)
             function->relateToOperator(op);
-        } else
-            break;
-        ++candidate;
     }
 }
 
@@ -250,16 +244,10 @@ void TSymbolTableLevel::relateToOperator(const char* name, TOperator op)
 // Should only be used for a version/profile that actually needs the extension(s).
 void TSymbolTableLevel::setFunctionExtensions(const char* name, int num, const char* const extensions[])
 {
-    tLevel::const_iterator candidate = level.lower_bound(name);
-    while (candidate != level.end()) {
-        const TString& candidateName = (*candidate).first;
-        TString::size_type parenAt = candidateName.find_first_of('(');
-        if (parenAt != candidateName.npos && candidateName.compare(0, parenAt, name) == 0) {
-            TSymbol* symbol = candidate->second;
-            symbol->setExtensions(num, extensions);
-        } else
-            break;
-        ++candidate;
+    const tFunctionList* candidates = findFunctionList(name);
+    if (candidates) {
+        for (TFunction* function : *candidates)
+            function->setExtensions(num, extensions);
     }
 }
 
@@ -385,15 +385,15 @@ public:
             const TString& insertName = symbol.getMangledName();
             if (symbol.getAsFunction()) {
                 // make sure there isn't a variable of this name
-                if (! separateNameSpaces && level.find(name) != level.end())
+                if (! separateNameSpaces && index.find(name) != index.end())
                     return false;
 
                 // insert, and whatever happens is okay
-                level.insert(tLevelPair(insertName, &symbol));
+                insertIndexed(insertName, symbol);
 
                 return true;
             } else
-                return level.insert(tLevelPair(insertName, &symbol)).second;
+                return insertIndexed(insertName, symbol);
         }
     }
 
@@ -414,7 +414,7 @@ public:
         const TTypeList& types = *symbol.getAsVariable()->getType().getStruct();
         for (unsigned int m = firstMember; m < types.size(); ++m) {
             TAnonMember* member = new TAnonMember(&types[m].type->getFieldName(), m, *symbol.getAsVariable(), symbol.getAsVariable()->getAnonId());
-            if (! level.insert(tLevelPair(member->getMangledName(), member)).second)
+            if (! insertIndexed(member->getMangledName(), *member))
                 return false;
         }
 
@@ -423,8 +423,8 @@ public:
 
     TSymbol* find(const TString& name) const
     {
-        tLevel::const_iterator it = level.find(name);
-        if (it == level.end())
+        tIndex::const_iterator it = index.find(name);
+        if (it == index.end())
             return 0;
         else
             return (*it).second;
@@ -433,53 +433,31 @@ public:
     void findFunctionNameList(const TString& name, TVector<const TFunction*>& list)
     {
         size_t parenAt = name.find_first_of('(');
-        TString base(name, 0, parenAt + 1);
-
-        tLevel::const_iterator begin = level.lower_bound(base);
-        base[parenAt] = ')';  // assume ')' is lexically after '('
-        tLevel::const_iterator end = level.upper_bound(base);
-        for (tLevel::const_iterator it = begin; it != end; ++it)
-            list.push_back(it->second->getAsFunction());
+        tFunctionIndex::const_iterator it = functions.find(TString(name, 0, parenAt));
+        if (it != functions.end())
+            list.insert(list.end(), it->second.begin(), it->second.end());
     }
 
     // See if there is already a function in the table having the given non-function-style name.
     bool hasFunctionName(const TString& name) const
     {
-        tLevel::const_iterator candidate = level.lower_bound(name);
-        if (candidate != level.end()) {
-            const TString& candidateName = (*candidate).first;
-            TString::size_type parenAt = candidateName.find_first_of('(');
-            if (parenAt != candidateName.npos && candidateName.compare(0, parenAt, name) == 0)
-
-                return true;
-        }
-
-        return false;
+        return findFunctionList(name) != 0;
     }
 
     // See if there is a variable at this level having the given non-function-style name.
     // Return true if name is found, and set variable to true if the name was a variable.
     bool findFunctionVariableName(const TString& name, bool& variable) const
     {
-        tLevel::const_iterator candidate = level.lower_bound(name);
-        if (candidate != level.end()) {
-            const TString& candidateName = (*candidate).first;
-            TString::size_type parenAt = candidateName.find_first_of('(');
-            if (parenAt == candidateName.npos) {
-                // not a mangled name
-                if (candidateName == name) {
-                    // found a variable name match
-                    variable = true;
-                    return true;
-                }
-            } else {
-                // a mangled name
-                if (candidateName.compare(0, parenAt, name) == 0) {
-                    // found a function name match
-                    variable = false;
-                    return true;
-                }
-            }
+        if (index.find(name) != index.end()) {
+            // found a variable name match
+            variable = true;
+            return true;
+        }
+
+        if (functions.find(name) != functions.end()) {
+            // found a function name match
+            variable = false;
+            return true;
         }
 
         return false;
@@ -528,8 +506,42 @@ protected:
     typedef std::map<TString, TSymbol*, std::less<TString>, pool_allocator<std::pair<const TString, TSymbol*> > > tLevel;
     typedef const tLevel::value_type tLevelPair;
     typedef std::pair<tLevel::iterator, bool> tInsertResult;
+    typedef TUnorderedMap<TString, TSymbol*> tIndex;
+    typedef TVector<TFunction*> tFunctionList;
+    typedef TUnorderedMap<TString, tFunctionList> tFunctionIndex;
+
+    // Adds the symbol to the ordered map and the hash indexes, returns false if the mangled name is already taken
+    bool insertIndexed(const TString& insertName, TSymbol& symbol)
+    {
+        if (! level.insert(tLevelPair(insertName, &symbol)).second)
+            return false;
+        index[insertName] = &symbol;
+
+        // overloads are kept in the order of their mangled names, the same order the ordered map has them
+        TFunction* function = symbol.getAsFunction();
+        if (function) {
+            tFunctionList& overloads = functions[TString(insertName, 0, insertName.find_first_of('('))];
+            tFunctionList::iterator it = std::lower_bound(overloads.begin(), overloads.end(), insertName,
+                [](const TFunction* f, const TString& n) { return f->getMangledName() < n; });
+            overloads.insert(it, function);
+        }
+
+        return true;
+    }
+
+    // Returns the overloads of a function name (without the parenthesis)
+    // A variable of the same name hides them, as it sorts before them in the ordered map
+    const tFunctionList* findFunctionList(const TString& name) const
+    {
+        if (index.find(name) != index.end())
+            return 0;
+        tFunctionIndex::const_iterator it = functions.find(name);
+        return it != functions.end() ? &it->second : 0;
+    }
 
-    tLevel level;  // named mappings
+    tLevel level;               // named mappings, ordered, owns the symbols
+    tIndex index;               // hash index of 'level' by mangled name, for lookups
+    tFunctionIndex functions;   // function overloads by their base (non-mangled) name
     TPrecisionQualifier *defaultPrecision;
     int anonId;
     bool thisLevel;  // True if this level of the symbol table is a structure scope containing member function
@@ -796,6 +808,7 @@ public:
     }
 
     int getMaxSymbolId() { return uniqueId; }
+    void setMaxSymbolId(int id) { uniqueId = id; }
     void dump(TInfoSink &infoSink) const;
     void copyTable(const TSymbolTable& copyOf);
 
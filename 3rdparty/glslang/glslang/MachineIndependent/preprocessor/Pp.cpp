@@ -185,9 +185,8 @@ int TPpContext::CPPdefine(TPpToken* ppToken)
                 } while (newToken > 0);
             }
         }
-        *existing = mac;
-    } else
-        addMacroDef(defAtom, mac);
+    }
+    addMacroDef(defAtom, mac);
 
     return '\n';
 }
@@ -595,6 +594,106 @@ int TPpContext::CPPifdef(int defined, TPpToken* ppToken)
     return token;
 }
 
+// Finds the guard macro of an include file, if the whole file is wrapped in '#ifndef NAME ... #endif'.
+// Only comments and white space may come before the #ifndef and after the matching #endif, and there must
+// not be an #else or #elif for it.  When NAME is defined, including the file again produces nothing.
+static bool FindIncludeGuard(const char* text, size_t length, std::string& guard)
+{
+    int depth = 0;
+    bool lineStart = true;
+    bool ended = false;
+    size_t pos = 0;
+    while (pos < length) {
+        const char c = text[pos];
+        const char next = pos + 1 < length ? text[pos + 1] : 0;
+        if (c == '\n') {
+            lineStart = true;
+            ++pos;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            ++pos;
+        } else if (c == '\\' && (next == '\n' || next == '\r')) {
+            pos += next == '\r' && pos + 2 < length && text[pos + 2] == '\n' ? 3 : 2;
+        } else if (c == '/' && next == '/') {
+            while (pos < length && text[pos] != '\n')
+                ++pos;
+        } else if (c == '/' && next == '*') {
+            const char* end = nullptr;
+            for (size_t p = pos + 2; p + 1 < length && end == nullptr; ++p) {
+                if (text[p] == '*' && text[p + 1] == '/')
+                    end = text + p + 2;
+            }
+            if (end == nullptr)
+                return false;
+            pos = end - text;
+        } else if (ended) {
+            return false;
+        } else if (c == '#' && lineStart) {
+            lineStart = false;
+            ++pos;
+            while (pos < length && (text[pos] == ' ' || text[pos] == '\t'))
+                ++pos;
+            size_t nameStart = pos;
+            while (pos < length && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+                ++pos;
+            const std::string name(text + nameStart, pos - nameStart);
+
+            if (guard.empty()) {
+                if (name != "ifndef")
+                    return false;
+                while (pos < length && (text[pos] == ' ' || text[pos] == '\t'))
+                    ++pos;
+                size_t macroStart = pos;
+                while (pos < length && (isalnum((unsigned char)text[pos]) || text[pos] == '_'))
+                    ++pos;
+                if (pos == macroStart)
+                    return false;
+                guard.assign(text + macroStart, pos - macroStart);
+                depth = 1;
+            } else if (name == "if" || name == "ifdef" || name == "ifndef") {
+                ++depth;
+            } else if (name == "else" || name == "elif") {
+                if (depth == 1)
+                    return false;
+            } else if (name == "endif") {
+                ended = --depth == 0;
+            }
+        } else if (guard.empty()) {
+            return false;
+        } else {
+            // header names of #include may have comment delimiters in them
+            if (c == '"') {
+                ++pos;
+                while (pos < length && text[pos] != '"' && text[pos] != '\n')
+                    ++pos;
+            }
+            lineStart = false;
+            ++pos;
+        }
+    }
+    return ended;
+}
+
+// Returns true if including the file again would produce nothing
+bool TPpContext::isIncludeGuarded(const std::string& headerName)
+{
+    auto it = includeGuards.find(headerName);
+    if (it == includeGuards.end())
+        return false;
+    if (it->second.once)
+        return true;
+    if (it->second.macroAtom == 0)
+        return false;
+    MacroSymbol* macro = lookupMacroDef(it->second.macroAtom);
+    return macro != nullptr && macro->undef == 0;
+}
+
+// #pragma once in an included file
+void TPpContext::setIncludeOnce()
+{
+    if (! includeStack.empty())
+        includeGuards[currentSourceFile].once = true;
+}
+
 // Handle #include ...
 // TODO: Handle macro expansions for the header name
 int TPpContext::CPPinclude(TPpToken* ppToken)
@@ -630,6 +729,12 @@ int TPpContext::CPPinclude(TPpToken* ppToken)
 
     // Process well-formed directive
 
+    // Skip guarded files that are already included, without resolving them again
+    std::string resolveKey = (startWithLocalSearch ? "\"" : "<") + filename + "\n" + currentSourceFile;
+    auto resolved = resolvedIncludes.find(resolveKey);
+    if (resolved != resolvedIncludes.end() && isIncludeGuarded(resolved->second))
+        return token;
+
     // Find the inclusion, first look in "Local" ("") paths, if requested,
     // otherwise, only search the "System" (<>) paths.
     TShader::Includer::IncludeResult* res = nullptr;
@@ -642,7 +747,18 @@ int TPpContext::CPPinclude(TPpToken* ppToken)
 
     // Process the results
     if (res != nullptr && !res->headerName.empty()) {
-        if (res->headerData != nullptr && res->headerLength > 0) {
+        resolvedIncludes[resolveKey] = res->headerName;
+        if (isIncludeGuarded(res->headerName)) {
+            includer.releaseInclude(res);
+        } else if (res->headerData != nullptr && res->headerLength > 0) {
+            // Guard is found once, the first time the file is included
+            if (includeGuards.find(res->headerName) == includeGuards.end()) {
+                TIncludeGuard& includeGuard = includeGuards[res->headerName];
+                std::string guard;
+                if (FindIncludeGuard(res->headerData, res->headerLength, guard))
+                    includeGuard.macroAtom = atomStrings.getAddAtom(guard.c_str());
+            }
+
             // path for processing one or more tokens from an included header, hand off 'res'
             const bool forNextLine = parseContext.lineDirectiveShouldSetNextLine();
             std::ostringstream prologue;
@@ -790,8 +906,11 @@ int TPpContext::CPPpragma(TPpToken* ppToken)
 
     if (token == EndOfInput)
         parseContext.ppError(loc, "directive must end with a newline", "#pragma", "");
-    else
+    else {
+        if (tokens.size() == 1 && tokens[0] == "once")
+            setIncludeOnce();
         parseContext.handlePragma(loc, tokens);
+    }
 
     return token;
 }
@@ -1009,7 +1128,7 @@ int TPpContext::scanHeaderName(TPpToken* ppToken, char delimit)
 TPpContext::TokenStream* TPpContext::PrescanMacroArg(TokenStream& arg, TPpToken* ppToken, bool newLineOkay)
 {
     // expand the argument
-    TokenStream* expandedArg = new TokenStream;
+    TokenStream* expandedArg = newTokenStream();
     pushInput(new tMarkerInput(this));
     pushTokenStreamInput(arg);
     int token;
@@ -1034,7 +1153,7 @@ TPpContext::TokenStream* TPpContext::PrescanMacroArg(TokenStream& arg, TPpToken*
 
     if (token == EndOfInput) {
         // Error, or MacroExpand ate the marker, so had bad input, recover
-        delete expandedArg;
+        releaseTokenStream(expandedArg);
         expandedArg = nullptr;
     } else {
         // remove the marker
@@ -1203,7 +1322,7 @@ MacroExpandResult TPpContext::MacroExpand(TPpToken* ppToken, bool expandUndef, b
         }
         in->args.resize(in->mac->args.size());
         for (size_t i = 0; i < in->mac->args.size(); i++)
-            in->args[i] = new TokenStream;
+            in->args[i] = newTokenStream();
         in->expandedArgs.resize(in->mac->args.size());
         for (size_t i = 0; i < in->mac->args.size(); i++)
             in->expandedArgs[i] = nullptr;
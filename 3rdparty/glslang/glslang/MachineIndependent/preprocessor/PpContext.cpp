@@ -103,6 +103,9 @@ TPpContext::~TPpContext()
     // free up the inputStack
     while (! inputStack.empty())
         popInput();
+
+    for (size_t i = 0; i < freeTokenStreams.size(); ++i)
+        delete freeTokenStreams[i];
 }
 
 void TPpContext::setInput(TInputScanner& input, bool versionWillBeError)
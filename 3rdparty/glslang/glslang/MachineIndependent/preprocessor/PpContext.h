@@ -252,6 +252,8 @@ public:
         bool peekTokenizedPasting(bool lastTokenPastes);
         bool peekUntokenizedPasting();
         void reset() { current = 0; }
+        void swap(TokenStream& other) { data.swap(other.data); std::swap(current, other.current); }
+        void clear() { data.clear(); current = 0; }  // keeps the memory, for reusing the stream
 
     protected:
         void putSubtoken(char);
@@ -275,14 +277,26 @@ public:
         unsigned undef     : 1;
     };
 
-    typedef TMap<int, MacroSymbol> TSymbolMap;
-    TSymbolMap macroDefs;  // map atoms to macro definitions
+    // Macro definitions, indexed by atom (atoms are small and contiguous), nullptr if the atom is not a macro.
+    // Definitions are allocated from the pool once, and their bodies are moved in, not copied.
+    TVector<MacroSymbol*> macroDefs;
     MacroSymbol* lookupMacroDef(int atom)
     {
-        auto existingMacroIt = macroDefs.find(atom);
-        return (existingMacroIt == macroDefs.end()) ? nullptr : &(existingMacroIt->second);
+        return (atom >= 0 && atom < (int)macroDefs.size()) ? macroDefs[atom] : nullptr;
+    }
+    void addMacroDef(int atom, MacroSymbol& macroDef)
+    {
+        if (atom >= (int)macroDefs.size())
+            macroDefs.resize(atom + 1, nullptr);
+        MacroSymbol*& mac = macroDefs[atom];
+        if (mac == nullptr)
+            mac = new (GetThreadPoolAllocator().allocate(sizeof(MacroSymbol))) MacroSymbol;
+        mac->args.swap(macroDef.args);
+        mac->body.swap(macroDef.body);
+        mac->emptyArgs = macroDef.emptyArgs;
+        mac->busy = macroDef.busy;
+        mac->undef = macroDef.undef;
     }
-    void addMacroDef(int atom, MacroSymbol& macroDef) { macroDefs[atom] = macroDef; }
 
 protected:
     TPpContext(TPpContext&);
@@ -334,9 +348,9 @@ protected:
         virtual ~tMacroInput()
         {
             for (size_t i = 0; i < args.size(); ++i)
-                delete args[i];
+                pp->releaseTokenStream(args[i]);
             for (size_t i = 0; i < expandedArgs.size(); ++i)
-                delete expandedArgs[i];
+                pp->releaseTokenStream(expandedArgs[i]);
         }
 
         virtual int scan(TPpToken*) override;
@@ -415,6 +429,11 @@ protected:
     void pushTokenStreamInput(TokenStream&, bool pasting = false);
     void UngetToken(int token, TPpToken*);
 
+    // Streams of macro arguments are reused by later expansions, with their memory
+    TokenStream* newTokenStream();
+    void releaseTokenStream(TokenStream*);
+    std::vector<TokenStream*> freeTokenStreams;
+
     class tTokenInput : public tInput {
     public:
         tTokenInput(TPpContext* pp, TokenStream* t, bool prepasting) : tInput(pp), tokens(t), lastTokenPastes(prepasting) { }
@@ -624,10 +643,22 @@ protected:
         }
     }
 
+    // Include guards of the included files, by resolved header name: '#ifndef NAME ... #endif' around the
+    // whole file, or '#pragma once'.  Later includes of a guarded file are skipped without calling the includer.
+    struct TIncludeGuard {
+        TIncludeGuard() : macroAtom(0), once(false) { }
+        int macroAtom;      // 0 if the file is not wrapped in #ifndef
+        bool once;
+    };
+    bool isIncludeGuarded(const std::string& headerName);
+    void setIncludeOnce();
+
     bool inComment;
     std::string rootFileName;
     std::stack<TShader::Includer::IncludeResult*> includeStack;
     std::string currentSourceFile;
+    std::unordered_map<std::string, TIncludeGuard> includeGuards;
+    std::unordered_map<std::string, std::string> resolvedIncludes;  // header-name and includer -> resolved name
 
     std::istringstream strtodStream;
 };
@@ -465,6 +465,7 @@ int TPpContext::tStringInput::scan(TPpToken* ppToken)
     for (;;) {
         while (ch == ' ' || ch == '\t') {
             ppToken->space = true;
+            input->skipSpaceTab();
             ch = getch();
         }
 
@@ -975,6 +976,7 @@ int TPpContext::tStringInput::scan(TPpToken* ppToken)
             if (ch == '/') {
                 pp->inComment = true;
                 do {
+                    input->skipLineCommentText();
                     ch = getch();
                 } while (ch != '\n' && ch != EndOfInput);
                 ppToken->space = true;
@@ -989,6 +991,7 @@ int TPpContext::tStringInput::scan(TPpToken* ppToken)
                             pp->parseContext.ppError(ppToken->loc, "End of input in comment", "comment", "");
                             return ch;
                         }
+                        input->skipBlockCommentText();
                         ch = getch();
                     }
                     ch = getch();
@@ -312,6 +312,24 @@ bool TPpContext::TokenStream::peekUntokenizedPasting()
     return pasting;
 }
 
+TPpContext::TokenStream* TPpContext::newTokenStream()
+{
+    if (freeTokenStreams.empty())
+        return new TokenStream;
+
+    TokenStream* ts = freeTokenStreams.back();
+    freeTokenStreams.pop_back();
+    return ts;
+}
+
+void TPpContext::releaseTokenStream(TokenStream* ts)
+{
+    if (ts != nullptr) {
+        ts->clear();
+        freeTokenStreams.push_back(ts);
+    }
+}
+
 void TPpContext::pushTokenStreamInput(TokenStream& ts, bool prepasting)
 {
     pushInput(new tTokenInput(this, &ts, prepasting));
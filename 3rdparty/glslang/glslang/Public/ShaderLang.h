@@ -365,6 +365,19 @@ bool InitializeProcess();
 // Call once per process to tear down everything
 void FinalizeProcess();
 
+// Observer of the preprocessor, for profiling.  The parser pulls tokens from the
+// preprocessor one at a time, so the time spent preprocessing (including the
+// includer) is only visible around each token request.  Process-wide, it's
+// called from every thread that parses a shader, and it's null by default.
+class TPreprocessorObserver {
+public:
+    virtual ~TPreprocessorObserver() { }
+    virtual void beginTokenize() = 0;
+    virtual void endTokenize() = 0;
+};
+
+void SetPreprocessorObserver(TPreprocessorObserver* observer);
+
 // Resource type for IO resolver
 enum TResourceType {
     EResSampler,
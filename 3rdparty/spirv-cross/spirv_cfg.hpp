@@ -48,6 +48,11 @@ public:
 		return immediate_dominators[block];
 	}
 
+	bool is_reachable(uint32_t block) const
+	{
+		return visit_order[block] > 0;
+	}
+
 	uint32_t get_visit_order(uint32_t block) const
 	{
 		int v = visit_order[block];
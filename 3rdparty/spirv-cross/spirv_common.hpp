@@ -20,6 +20,7 @@
 #include "spirv.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstring>
 #include <functional>
@@ -30,6 +31,7 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -290,13 +292,173 @@ struct Instruction
 	uint32_t length;
 };
 
+// Typed pool for the objects held by Variant, a lot of them (expressions, temporaries) are created and
+// destroyed again on every recompile pass.
+// Every thread allocates from its own pool, and objects always go back to the pool that allocated them:
+// the owning thread reuses them without locking, other threads hand them back through a lock-free list.
+// A pool and its blocks are freed when its thread has exited and the last of its objects is freed.
+template <typename T>
+class ObjectPool
+{
+public:
+	static void *allocate()
+	{
+		ThreadPool &thread_pool = get_thread_pool();
+		if (thread_pool.pool)
+			return thread_pool.pool->pop();
+
+		auto *pool = new ObjectPool;
+		if (!thread_pool.exited)
+		{
+			thread_pool.pool = pool;
+			return pool->pop();
+		}
+
+		// The thread is exiting, so the pool only holds this object.
+		void *object = pool->pop();
+		pool->release_thread();
+		return object;
+	}
+
+	static void free(void *ptr)
+	{
+		auto *slot = static_cast<Slot *>(ptr);
+		ObjectPool *pool = slot->owner;
+		if (pool == get_thread_pool().pool)
+		{
+			slot->next = pool->free_list;
+			pool->free_list = slot;
+			pool->live--;
+		}
+		else
+			pool->free_remote(slot);
+	}
+
+private:
+	// The object is first, so its address is the address of the slot.
+	struct Slot
+	{
+		union {
+			Slot *next;
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type object;
+		};
+		ObjectPool *owner;
+	};
+
+	struct ThreadPool
+	{
+		ObjectPool *pool = nullptr;
+		bool exited = false;
+
+		~ThreadPool()
+		{
+			exited = true;
+			if (pool)
+				pool->release_thread();
+			pool = nullptr;
+		}
+	};
+
+	enum
+	{
+		ObjectsPerBlock = 64
+	};
+
+	Slot *free_list = nullptr;
+	std::atomic<Slot *> remote_free_list{ nullptr };
+	std::vector<Slot *> blocks;
+
+	// Objects handed out minus objects freed by the owning thread.
+	intptr_t live = 0;
+	// Minus objects freed by other threads, and plus 'live' once the thread has exited, so it drops to zero
+	// with the last object.
+	std::atomic<intptr_t> remote_live{ 0 };
+
+	ObjectPool() = default;
+
+	~ObjectPool()
+	{
+		for (auto *block : blocks)
+			::operator delete(block);
+	}
+
+	static ThreadPool &get_thread_pool()
+	{
+		static thread_local ThreadPool thread_pool;
+		return thread_pool;
+	}
+
+	void *pop()
+	{
+		if (!free_list)
+			free_list = remote_free_list.exchange(nullptr, std::memory_order_acquire);
+		if (!free_list)
+			allocate_block();
+
+		Slot *slot = free_list;
+		free_list = slot->next;
+		live++;
+		return slot;
+	}
+
+	void free_remote(Slot *slot)
+	{
+		Slot *head = remote_free_list.load(std::memory_order_relaxed);
+		do
+			slot->next = head;
+		while (!remote_free_list.compare_exchange_weak(head, slot, std::memory_order_release,
+		                                               std::memory_order_relaxed));
+
+		if (remote_live.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete this;
+	}
+
+	void release_thread()
+	{
+		if (remote_live.fetch_add(live, std::memory_order_acq_rel) + live == 0)
+			delete this;
+	}
+
+	void allocate_block()
+	{
+		auto *block = static_cast<Slot *>(::operator new(sizeof(Slot) * ObjectsPerBlock));
+		blocks.push_back(block);
+
+		for (uint32_t i = 0; i < ObjectsPerBlock; i++)
+		{
+			block[i].owner = this;
+			block[i].next = free_list;
+			free_list = &block[i];
+		}
+	}
+};
+
 // Helper for Variant interface.
 struct IVariant
 {
 	virtual ~IVariant() = default;
+	virtual IVariant *clone() const = 0;
 	uint32_t self = 0;
 };
 
+// Deep copies and pooled allocation, for every type that is held by Variant.
+#define SPIRV_CROSS_DECLARE_VARIANT(T)                                                   \
+	IVariant *clone() const override                                                     \
+	{                                                                                    \
+		return new T(*this);                                                             \
+	}                                                                                    \
+	static void *operator new(size_t size)                                               \
+	{                                                                                    \
+		return size == sizeof(T) ? ObjectPool<T>::allocate() : ::operator new(size);    \
+	}                                                                                    \
+	static void operator delete(void *ptr, size_t size)                                  \
+	{                                                                                    \
+		if (size == sizeof(T))                                                           \
+			ObjectPool<T>::free(ptr);                                                    \
+		else                                                                             \
+			::operator delete(ptr);                                                      \
+	}
+
 enum Types
 {
 	TypeNone,
@@ -321,6 +483,8 @@ struct SPIRUndef : IVariant
 	{
 		type = TypeUndef
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRUndef)
+
 	SPIRUndef(uint32_t basetype_)
 	    : basetype(basetype_)
 	{
@@ -336,6 +500,8 @@ struct SPIRCombinedImageSampler : IVariant
 	{
 		type = TypeCombinedImageSampler
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRCombinedImageSampler)
+
 	SPIRCombinedImageSampler(uint32_t type_, uint32_t image_, uint32_t sampler_)
 	    : combined_type(type_)
 	    , image(image_)
@@ -353,6 +519,7 @@ struct SPIRConstantOp : IVariant
 	{
 		type = TypeConstantOp
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRConstantOp)
 
 	SPIRConstantOp(uint32_t result_type, spv::Op op, const uint32_t *args, uint32_t length)
 	    : opcode(op)
@@ -372,6 +539,7 @@ struct SPIRType : IVariant
 	{
 		type = TypeType
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRType)
 
 	enum BaseType
 	{
@@ -446,6 +614,7 @@ struct SPIRExtension : IVariant
 	{
 		type = TypeExtension
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRExtension)
 
 	enum Extension
 	{
@@ -500,6 +669,7 @@ struct SPIRExpression : IVariant
 	{
 		type = TypeExpression
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRExpression)
 
 	// Only created by the backend target to avoid creating tons of temporaries.
 	SPIRExpression(std::string expr, uint32_t expression_type_, bool immutable_)
@@ -541,6 +711,7 @@ struct SPIRFunctionPrototype : IVariant
 	{
 		type = TypeFunctionPrototype
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRFunctionPrototype)
 
 	SPIRFunctionPrototype(uint32_t return_type_)
 	    : return_type(return_type_)
@@ -557,6 +728,7 @@ struct SPIRBlock : IVariant
 	{
 		type = TypeBlock
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRBlock)
 
 	enum Terminator
 	{
@@ -692,6 +864,7 @@ struct SPIRFunction : IVariant
 	{
 		type = TypeFunction
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRFunction)
 
 	SPIRFunction(uint32_t return_type_, uint32_t function_type_)
 	    : return_type(return_type_)
@@ -777,6 +950,7 @@ struct SPIRAccessChain : IVariant
 	{
 		type = TypeAccessChain
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRAccessChain)
 
 	SPIRAccessChain(uint32_t basetype_, spv::StorageClass storage_, std::string base_, std::string dynamic_index_,
 	                int32_t static_index_)
@@ -811,6 +985,7 @@ struct SPIRVariable : IVariant
 	{
 		type = TypeVariable
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRVariable)
 
 	SPIRVariable() = default;
 	SPIRVariable(uint32_t basetype_, spv::StorageClass storage_, uint32_t initializer_ = 0, uint32_t basevariable_ = 0)
@@ -864,6 +1039,7 @@ struct SPIRConstant : IVariant
 	{
 		type = TypeConstant
 	};
+	SPIRV_CROSS_DECLARE_VARIANT(SPIRConstant)
 
 	union Constant {
 		uint32_t u32;
@@ -1118,11 +1294,13 @@ class Variant
 public:
 	// MSVC 2013 workaround, we shouldn't need these constructors.
 	Variant() = default;
-	Variant(Variant &&other)
+	// Moves must not throw, or growing the ids vector would fall back to deep copies,
+	// invalidating references into it.
+	Variant(Variant &&other) noexcept
 	{
 		*this = std::move(other);
 	}
-	Variant &operator=(Variant &&other)
+	Variant &operator=(Variant &&other) noexcept
 	{
 		if (this != &other)
 		{
@@ -1133,6 +1311,22 @@ public:
 		return *this;
 	}
 
+	// Copies are deep, used to give every compiler its own copy of a parsed module.
+	Variant(const Variant &other)
+	{
+		*this = other;
+	}
+	Variant &operator=(const Variant &other)
+	{
+		if (this != &other)
+		{
+			holder.reset(other.holder ? other.holder->clone() : nullptr);
+			type = other.type;
+			allow_type_rewrite = other.allow_type_rewrite;
+		}
+		return *this;
+	}
+
 	void set(std::unique_ptr<IVariant> val, uint32_t new_type)
 	{
 		holder = std::move(val);
@@ -1254,6 +1448,93 @@ struct Meta
 	uint32_t hlsl_magic_counter_buffer = 0;
 };
 
+// Meta of every ID. Once frozen, copies of the table share the entries, and an entry is only copied
+// when it's accessed for writing.
+class MetaTable
+{
+public:
+	MetaTable() = default;
+	MetaTable(MetaTable &&) = default;
+	MetaTable &operator=(MetaTable &&) = default;
+
+	MetaTable(const MetaTable &other)
+	{
+		*this = other;
+	}
+
+	MetaTable &operator=(const MetaTable &other)
+	{
+		if (this == &other)
+			return *this;
+
+		shared = other.shared;
+		local.clear();
+		local.resize(other.local.size());
+		for (size_t i = 0; i < local.size(); i++)
+			if (other.local[i])
+				local[i].reset(new Meta(*other.local[i]));
+		return *this;
+	}
+
+	Meta &operator[](uint32_t id)
+	{
+		auto &m = local[id];
+		if (!m)
+			m.reset(shared && id < shared->size() ? new Meta(*(*shared)[id]) : new Meta());
+		return *m;
+	}
+
+	const Meta &operator[](uint32_t id) const
+	{
+		if (local[id])
+			return *local[id];
+		if (shared && id < shared->size())
+			return *(*shared)[id];
+		return empty_meta();
+	}
+
+	Meta &at(uint32_t id)
+	{
+		local.at(id);
+		return (*this)[id];
+	}
+
+	const Meta &at(uint32_t id) const
+	{
+		local.at(id);
+		return (*this)[id];
+	}
+
+	size_t size() const
+	{
+		return local.size();
+	}
+
+	void resize(size_t count)
+	{
+		local.resize(count);
+	}
+
+	// Moves all entries to the shared part, only call it on a table that isn't shared yet.
+	void freeze()
+	{
+		auto entries = std::make_shared<std::vector<std::unique_ptr<const Meta>>>(local.size());
+		for (size_t i = 0; i < local.size(); i++)
+			(*entries)[i].reset(local[i] ? local[i].release() : new Meta());
+		shared = std::move(entries);
+	}
+
+private:
+	static const Meta &empty_meta()
+	{
+		static const Meta empty = Meta();
+		return empty;
+	}
+
+	std::shared_ptr<const std::vector<std::unique_ptr<const Meta>>> shared;
+	std::vector<std::unique_ptr<Meta>> local;
+};
+
 // A user callback that remaps the type of any variable.
 // var_name is the declared name of the variable.
 // name_of_type is the textual name of the type which will be used in the code unless written to by the callback.
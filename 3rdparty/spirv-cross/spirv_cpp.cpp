@@ -302,11 +302,12 @@ string CompilerCPP::compile()
 
 	build_function_control_flow_graphs_and_analyze();
 	update_active_builtins();
+	analyze_expression_reads();
 
-	uint32_t pass_count = 0;
+	compile_pass_count = 0;
 	do
 	{
-		if (pass_count >= 3)
+		if (compile_pass_count >= 3)
 			SPIRV_CROSS_THROW("Over 3 compilation loops detected. Must be a bug!");
 
 		resource_registrations.clear();
@@ -320,7 +321,7 @@ string CompilerCPP::compile()
 
 		emit_function(get<SPIRFunction>(entry_point), Bitset());
 
-		pass_count++;
+		compile_pass_count++;
 	} while (force_recompile);
 
 	// Match opening scope of emit_header().
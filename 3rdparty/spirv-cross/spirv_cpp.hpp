@@ -36,6 +36,11 @@ public:
 	{
 	}
 
+	explicit CompilerCPP(ParsedIR ir)
+	    : CompilerGLSL(std::move(ir))
+	{
+	}
+
 	std::string compile() override;
 
 	// Sets a custom symbol name that can override
@@ -79,15 +79,42 @@ Instruction::Instruction(const vector<uint32_t> &spirv, uint32_t &index)
 }
 
 Compiler::Compiler(vector<uint32_t> ir)
-    : spirv(move(ir))
 {
-	parse();
+	parse(move(ir));
 }
 
 Compiler::Compiler(const uint32_t *ir, size_t word_count)
-    : spirv(ir, ir + word_count)
 {
-	parse();
+	parse(vector<uint32_t>(ir, ir + word_count));
+}
+
+Compiler::Compiler(ParsedIR ir)
+    : shared_ir(move(ir.shared_ir))
+    , ids(move(ir.ids))
+    , meta(move(ir.meta))
+    , global_variables(move(ir.global_variables))
+    , aliased_variables(move(ir.aliased_variables))
+    , entry_point(ir.entry_point)
+    , entry_points(move(ir.entry_points))
+    , source(ir.source)
+{
+}
+
+Compiler::ParsedIR Compiler::parse_ir(vector<uint32_t> ir)
+{
+	Compiler compiler(move(ir));
+
+	ParsedIR parsed;
+	parsed.shared_ir = move(compiler.shared_ir);
+	parsed.meta = move(compiler.meta);
+	parsed.meta.freeze();
+	parsed.ids = move(compiler.ids);
+	parsed.global_variables = move(compiler.global_variables);
+	parsed.aliased_variables = move(compiler.aliased_variables);
+	parsed.entry_point = compiler.entry_point;
+	parsed.entry_points = move(compiler.entry_points);
+	parsed.source = compiler.source;
+	return parsed;
 }
 
 string Compiler::compile()
@@ -891,8 +918,13 @@ void Compiler::fixup_type_alias()
 	}
 }
 
-void Compiler::parse()
+void Compiler::parse(vector<uint32_t> spirv_words)
 {
+	auto parsed = make_shared<SharedIR>();
+	auto &spirv = parsed->spirv;
+	spirv = move(spirv_words);
+	shared_ir = parsed;
+
 	auto len = spirv.size();
 	if (len < 5)
 		SPIRV_CROSS_THROW("SPIRV file too small.");
@@ -910,12 +942,13 @@ void Compiler::parse()
 	ids.resize(bound);
 	meta.resize(bound);
 
+	vector<Instruction> inst;
 	uint32_t offset = 5;
 	while (offset < len)
 		inst.emplace_back(spirv, offset);
 
 	for (auto &i : inst)
-		parse(i);
+		parse(*parsed, i);
 
 	if (current_function)
 		SPIRV_CROSS_THROW("Function was not terminated.");
@@ -1538,7 +1571,7 @@ bool Compiler::get_binary_offset_for_decoration(uint32_t id, spv::Decoration dec
 	return true;
 }
 
-void Compiler::parse(const Instruction &instruction)
+void Compiler::parse(SharedIR &parsed, const Instruction &instruction)
 {
 	auto ops = stream(instruction);
 	auto op = static_cast<Op>(instruction.op);
@@ -1602,21 +1635,21 @@ void Compiler::parse(const Instruction &instruction)
 		if (cap == CapabilityKernel)
 			SPIRV_CROSS_THROW("Kernel capability not supported.");
 
-		declared_capabilities.push_back(static_cast<Capability>(ops[0]));
+		parsed.declared_capabilities.push_back(static_cast<Capability>(ops[0]));
 		break;
 	}
 
 	case OpExtension:
 	{
-		auto ext = extract_string(spirv, instruction.offset);
-		declared_extensions.push_back(move(ext));
+		auto ext = extract_string(parsed.spirv, instruction.offset);
+		parsed.declared_extensions.push_back(move(ext));
 		break;
 	}
 
 	case OpExtInstImport:
 	{
 		uint32_t id = ops[0];
-		auto ext = extract_string(spirv, instruction.offset + 1);
+		auto ext = extract_string(parsed.spirv, instruction.offset + 1);
 		if (ext == "GLSL.std.450")
 			set<SPIRExtension>(id, SPIRExtension::GLSL);
 		else if (ext == "SPV_AMD_shader_ballot")
@@ -1639,7 +1672,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		auto itr =
 		    entry_points.insert(make_pair(ops[1], SPIREntryPoint(ops[1], static_cast<ExecutionModel>(ops[0]),
-		                                                         extract_string(spirv, instruction.offset + 2))));
+		                                                         extract_string(parsed.spirv, instruction.offset + 2))));
 		auto &e = itr.first->second;
 
 		// Strings need nul-terminator and consume the whole word.
@@ -1686,7 +1719,7 @@ void Compiler::parse(const Instruction &instruction)
 	case OpName:
 	{
 		uint32_t id = ops[0];
-		set_name(id, extract_string(spirv, instruction.offset + 1));
+		set_name(id, extract_string(parsed.spirv, instruction.offset + 1));
 		break;
 	}
 
@@ -1694,7 +1727,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
-		set_member_name(id, member, extract_string(spirv, instruction.offset + 2));
+		set_member_name(id, member, extract_string(parsed.spirv, instruction.offset + 2));
 		break;
 	}
 
@@ -1706,7 +1739,7 @@ void Compiler::parse(const Instruction &instruction)
 		auto decoration = static_cast<Decoration>(ops[1]);
 		if (length >= 3)
 		{
-			meta[id].decoration_word_offset[decoration] = uint32_t(&ops[2] - spirv.data());
+			meta[id].decoration_word_offset[decoration] = uint32_t(&ops[2] - parsed.spirv.data());
 			set_decoration(id, decoration, ops[2]);
 		}
 		else
@@ -1719,7 +1752,7 @@ void Compiler::parse(const Instruction &instruction)
 	{
 		uint32_t id = ops[0];
 		auto decoration = static_cast<Decoration>(ops[1]);
-		set_decoration_string(id, decoration, extract_string(spirv, instruction.offset + 2));
+		set_decoration_string(id, decoration, extract_string(parsed.spirv, instruction.offset + 2));
 		break;
 	}
 
@@ -1740,7 +1773,7 @@ void Compiler::parse(const Instruction &instruction)
 		uint32_t id = ops[0];
 		uint32_t member = ops[1];
 		auto decoration = static_cast<Decoration>(ops[2]);
-		set_member_decoration_string(id, member, decoration, extract_string(spirv, instruction.offset + 3));
+		set_member_decoration_string(id, member, decoration, extract_string(parsed.spirv, instruction.offset + 3));
 		break;
 	}
 
@@ -2223,7 +2256,7 @@ void Compiler::parse(const Instruction &instruction)
 			current_block->cases.push_back({ ops[i], ops[i + 1] });
 
 		// If we jump to next block, make it break instead since we're inside a switch case block at that point.
-		multiselect_merge_targets.insert(current_block->next_block);
+		parsed.multiselect_merge_targets.insert(current_block->next_block);
 
 		current_block = nullptr;
 		break;
@@ -2273,7 +2306,7 @@ void Compiler::parse(const Instruction &instruction)
 
 		current_block->next_block = ops[0];
 		current_block->merge = SPIRBlock::MergeSelection;
-		selection_merge_targets.insert(current_block->next_block);
+		parsed.selection_merge_targets.insert(current_block->next_block);
 
 		if (length >= 2)
 		{
@@ -2294,16 +2327,16 @@ void Compiler::parse(const Instruction &instruction)
 		current_block->continue_block = ops[1];
 		current_block->merge = SPIRBlock::MergeLoop;
 
-		loop_blocks.insert(current_block->self);
-		loop_merge_targets.insert(current_block->merge_block);
+		parsed.loop_blocks.insert(current_block->self);
+		parsed.loop_merge_targets.insert(current_block->merge_block);
 
-		continue_block_to_loop_header[current_block->continue_block] = current_block->self;
+		parsed.continue_block_to_loop_header[current_block->continue_block] = current_block->self;
 
 		// Don't add loop headers to continue blocks,
 		// which would make it impossible branch into the loop header since
 		// they are treated as continues.
 		if (current_block->continue_block != current_block->self)
-			continue_blocks.insert(current_block->continue_block);
+			parsed.continue_blocks.insert(current_block->continue_block);
 
 		if (length >= 3)
 		{
@@ -4141,7 +4174,7 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 				// The continue block is dominated by the inner part of the loop, which does not make sense in high-level
 				// language output because it will be declared before the body,
 				// so we will have to lift the dominator up to the relevant loop header instead.
-				builder.add_block(continue_block_to_loop_header[block]);
+				builder.add_block(shared_ir->continue_block_to_loop_header.at(block));
 
 				// Arrays or structs cannot be loop variables.
 				if (type.vecsize == 1 && type.columns == 1 && type.basetype != SPIRType::Struct && type.array.empty())
@@ -4197,7 +4230,7 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 			// If a temporary is used in more than one block, we might have to lift continue block
 			// access up to loop header like we did for variables.
 			if (blocks.size() != 1 && is_continue(block))
-				builder.add_block(continue_block_to_loop_header[block]);
+				builder.add_block(shared_ir->continue_block_to_loop_header.at(block));
 			else if (blocks.size() != 1 && is_single_block_loop(block))
 			{
 				// Awkward case, because the loop header is also the continue block.
@@ -4256,7 +4289,7 @@ void Compiler::analyze_variable_scope(SPIRFunction &entry, AnalyzeVariableScopeA
 		uint32_t header = 0;
 
 		// Find the loop header for this block.
-		for (auto b : loop_blocks)
+		for (auto b : shared_ir->loop_blocks)
 		{
 			auto &potential_header = get<SPIRBlock>(b);
 			if (potential_header.continue_block == block)
@@ -4832,12 +4865,12 @@ void Compiler::make_constant_null(uint32_t id, uint32_t type)
 
 const std::vector<spv::Capability> &Compiler::get_declared_capabilities() const
 {
-	return declared_capabilities;
+	return shared_ir->declared_capabilities;
 }
 
 const std::vector<std::string> &Compiler::get_declared_extensions() const
 {
-	return declared_extensions;
+	return shared_ir->declared_extensions;
 }
 
 std::string Compiler::get_remapped_declared_block_name(uint32_t id) const
@@ -124,6 +124,16 @@ public:
 	Compiler(std::vector<uint32_t> ir);
 	Compiler(const uint32_t *ir, size_t word_count);
 
+	// The parsed module, it's everything a compiler starts from before any options or queries.
+	struct ParsedIR;
+
+	// Parses a buffer of SPIR-V words without compiling it, so that it's only parsed once
+	// when it's compiled by several compilers.
+	static ParsedIR parse_ir(std::vector<uint32_t> ir);
+
+	// Constructs from a parsed module, pass a copy of it to keep the original for other compilers.
+	explicit Compiler(ParsedIR ir);
+
 	virtual ~Compiler() = default;
 
 	// After parsing, API users can modify the SPIR-V via reflection and call this
@@ -444,6 +454,13 @@ public:
 		return uint32_t(ids.size());
 	}
 
+	// Number of passes that the last compile() needed, code is emitted again when
+	// a pass finds out that earlier code must change (force_recompile).
+	uint32_t get_compile_pass_count() const
+	{
+		return compile_pass_count;
+	}
+
 	// API for querying buffer objects.
 	// The type passed in here should be the base type of a resource, i.e.
 	// get_type(resource.base_type_id)
@@ -519,15 +536,28 @@ protected:
 		if (!instr.length)
 			return nullptr;
 
-		if (instr.offset + instr.length > spirv.size())
+		if (instr.offset + instr.length > shared_ir->spirv.size())
 			SPIRV_CROSS_THROW("Compiler::stream() out of range.");
-		return &spirv[instr.offset];
+		return &shared_ir->spirv[instr.offset];
 	}
-	std::vector<uint32_t> spirv;
 
-	std::vector<Instruction> inst;
+	// The parts of the module which are only written by parsing, compilers of the same ParsedIR share them.
+	struct SharedIR
+	{
+		std::vector<uint32_t> spirv;
+		std::unordered_set<uint32_t> loop_blocks;
+		std::unordered_set<uint32_t> continue_blocks;
+		std::unordered_set<uint32_t> loop_merge_targets;
+		std::unordered_set<uint32_t> selection_merge_targets;
+		std::unordered_set<uint32_t> multiselect_merge_targets;
+		std::unordered_map<uint32_t, uint32_t> continue_block_to_loop_header;
+		std::vector<spv::Capability> declared_capabilities;
+		std::vector<std::string> declared_extensions;
+	};
+	std::shared_ptr<const SharedIR> shared_ir;
+
 	std::vector<Variant> ids;
-	std::vector<Meta> meta;
+	MetaTable meta;
 
 	SPIRFunction *current_function = nullptr;
 	SPIRBlock *current_block = nullptr;
@@ -593,13 +623,6 @@ protected:
 		Source() = default;
 	} source;
 
-	std::unordered_set<uint32_t> loop_blocks;
-	std::unordered_set<uint32_t> continue_blocks;
-	std::unordered_set<uint32_t> loop_merge_targets;
-	std::unordered_set<uint32_t> selection_merge_targets;
-	std::unordered_set<uint32_t> multiselect_merge_targets;
-	std::unordered_map<uint32_t, uint32_t> continue_block_to_loop_header;
-
 	virtual std::string to_name(uint32_t id, bool allow_alias = true) const;
 	bool is_builtin_variable(const SPIRVariable &var) const;
 	bool is_builtin_type(const SPIRType &type) const;
@@ -622,7 +645,7 @@ protected:
 
 	inline bool is_continue(uint32_t next) const
 	{
-		return continue_blocks.find(next) != end(continue_blocks);
+		return shared_ir->continue_blocks.count(next) != 0;
 	}
 
 	inline bool is_single_block_loop(uint32_t next) const
@@ -633,19 +656,18 @@ protected:
 
 	inline bool is_break(uint32_t next) const
 	{
-		return loop_merge_targets.find(next) != end(loop_merge_targets) ||
-		       multiselect_merge_targets.find(next) != end(multiselect_merge_targets);
+		return shared_ir->loop_merge_targets.count(next) != 0 || shared_ir->multiselect_merge_targets.count(next) != 0;
 	}
 
 	inline bool is_loop_break(uint32_t next) const
 	{
-		return loop_merge_targets.find(next) != end(loop_merge_targets);
+		return shared_ir->loop_merge_targets.count(next) != 0;
 	}
 
 	inline bool is_conditional(uint32_t next) const
 	{
-		return selection_merge_targets.find(next) != end(selection_merge_targets) &&
-		       multiselect_merge_targets.find(next) == end(multiselect_merge_targets);
+		return shared_ir->selection_merge_targets.count(next) != 0 &&
+		       shared_ir->multiselect_merge_targets.count(next) == 0;
 	}
 
 	// Dependency tracking for temporaries read from variables.
@@ -669,6 +691,7 @@ protected:
 	SPIRBlock::ContinueBlockType continue_block_type(const SPIRBlock &continue_block) const;
 
 	bool force_recompile = false;
+	uint32_t compile_pass_count = 0;
 
 	bool block_is_loop_candidate(const SPIRBlock &block, SPIRBlock::Method method) const;
 
@@ -689,8 +712,8 @@ protected:
 			variable_remap_callback(type, var_name, type_name);
 	}
 
-	void parse();
-	void parse(const Instruction &i);
+	void parse(std::vector<uint32_t> spirv);
+	void parse(SharedIR &parsed, const Instruction &i);
 
 	// Used internally to implement various traversals for queries.
 	struct OpcodeHandler
@@ -931,8 +954,6 @@ protected:
 
 	void make_constant_null(uint32_t id, uint32_t type);
 
-	std::vector<spv::Capability> declared_capabilities;
-	std::vector<std::string> declared_extensions;
 	std::unordered_map<uint32_t, std::string> declared_block_names;
 
 	bool instruction_to_result_type(uint32_t &result_type, uint32_t &result_id, spv::Op op, const uint32_t *args,
@@ -951,6 +972,19 @@ private:
 	void fixup_type_alias();
 	bool type_is_block_like(const SPIRType &type) const;
 };
+
+struct Compiler::ParsedIR
+{
+	// Copies share everything that compilers don't change, and the decorations until they're written.
+	std::shared_ptr<const SharedIR> shared_ir;
+	MetaTable meta;
+	std::vector<Variant> ids;
+	std::vector<uint32_t> global_variables;
+	std::vector<uint32_t> aliased_variables;
+	uint32_t entry_point = 0;
+	std::unordered_map<uint32_t, SPIREntryPoint> entry_points;
+	Source source;
+};
 } // namespace spirv_cross
 
 #endif
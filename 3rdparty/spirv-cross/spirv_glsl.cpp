@@ -428,11 +428,12 @@ string CompilerGLSL::compile()
 	fixup_image_load_store_access();
 	update_active_builtins();
 	analyze_image_and_sampler_usage();
+	analyze_expression_reads();
 
-	uint32_t pass_count = 0;
+	compile_pass_count = 0;
 	do
 	{
-		if (pass_count >= 3)
+		if (compile_pass_count >= 3)
 			SPIRV_CROSS_THROW("Over 3 compilation loops detected. Must be a bug!");
 
 		reset();
@@ -445,7 +446,7 @@ string CompilerGLSL::compile()
 
 		emit_function(get<SPIRFunction>(entry_point), Bitset());
 
-		pass_count++;
+		compile_pass_count++;
 	} while (force_recompile);
 
 	// Entry point in GLSL is always main().
@@ -3867,7 +3868,7 @@ void CompilerGLSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > shared_ir->spirv.size())
 		SPIRV_CROSS_THROW("Compiler::parse() opcode out of range.");
 
 	vector<uint32_t> inherited_expressions;
@@ -5888,6 +5889,147 @@ void CompilerGLSL::track_expression_read(uint32_t id)
 	}
 }
 
+// Reading a forwarded expression twice forces it to a temporary in track_expression_read(), which costs a full
+// recompile pass when it's only found out while emitting. Most of these are plain ALU results, which are always
+// forwarded with usage tracking, so those which are certain to be read more than once are forced up front.
+// Reads are only counted where emitting the instruction always reads the operand, anything missed is still
+// caught by a recompile.
+void CompilerGLSL::analyze_expression_reads()
+{
+	unordered_map<uint32_t, uint32_t> result_types;
+	unordered_map<uint32_t, uint32_t> read_counts;
+
+	const auto read = [&](uint32_t id, uint32_t count) {
+		auto itr = read_counts.find(id);
+		if (itr != end(read_counts))
+			itr->second += count;
+	};
+
+	for (auto &cfg : function_cfgs)
+	{
+		auto &func = get<SPIRFunction>(cfg.first);
+		for (auto block_id : func.blocks)
+		{
+			// Blocks appear before the blocks they dominate, so results are seen before they are read.
+			if (!cfg.second->is_reachable(block_id))
+				continue;
+
+			for (auto &i : get<SPIRBlock>(block_id).ops)
+			{
+				auto ops = stream(i);
+				auto op = static_cast<Op>(i.op);
+
+				uint32_t result_type = 0, result_id = 0;
+				if (instruction_to_result_type(result_type, result_id, op, ops, i.length))
+					result_types[result_id] = result_type;
+
+				switch (op)
+				{
+				case OpSNegate:
+				case OpFNegate:
+				case OpNot:
+				case OpLogicalNot:
+				case OpIsNan:
+				case OpIsInf:
+				case OpAny:
+				case OpAll:
+				case OpTranspose:
+				case OpIAdd:
+				case OpFAdd:
+				case OpISub:
+				case OpFSub:
+				case OpIMul:
+				case OpFMul:
+				case OpUDiv:
+				case OpSDiv:
+				case OpFDiv:
+				case OpUMod:
+				case OpSMod:
+				case OpFMod:
+				case OpSRem:
+				case OpFRem:
+				case OpVectorTimesScalar:
+				case OpMatrixTimesScalar:
+				case OpVectorTimesMatrix:
+				case OpMatrixTimesVector:
+				case OpMatrixTimesMatrix:
+				case OpOuterProduct:
+				case OpDot:
+				case OpShiftRightLogical:
+				case OpShiftRightArithmetic:
+				case OpShiftLeftLogical:
+				case OpBitwiseOr:
+				case OpBitwiseXor:
+				case OpBitwiseAnd:
+				case OpLogicalOr:
+				case OpLogicalAnd:
+				case OpLogicalEqual:
+				case OpLogicalNotEqual:
+				case OpIEqual:
+				case OpINotEqual:
+				case OpUGreaterThan:
+				case OpSGreaterThan:
+				case OpUGreaterThanEqual:
+				case OpSGreaterThanEqual:
+				case OpULessThan:
+				case OpSLessThan:
+				case OpULessThanEqual:
+				case OpSLessThanEqual:
+				case OpFOrdEqual:
+				case OpFOrdNotEqual:
+				case OpFOrdLessThan:
+				case OpFOrdGreaterThan:
+				case OpFOrdLessThanEqual:
+				case OpFOrdGreaterThanEqual:
+					for (uint32_t arg = 2; arg < i.length; arg++)
+						read(ops[arg], 1);
+					read_counts[ops[1]] = 0;
+					break;
+
+				case OpCompositeExtract:
+				{
+					// Scalars might be split from their base expression, which is then read later, or not at all
+					// when they are combined again by OpCompositeConstruct.
+					auto &type = get<SPIRType>(ops[0]);
+					if (type.vecsize > 1 || type.columns > 1)
+						read(ops[2], 1);
+					break;
+				}
+
+				case OpVectorShuffle:
+				{
+					// Shuffling from two vectors reads them once per component, see emit_instruction().
+					auto itr = result_types.find(ops[2]);
+					if (itr == end(result_types))
+						break;
+
+					uint32_t left_components = get<SPIRType>(itr->second).vecsize;
+					uint32_t left_reads = 0, right_reads = 0;
+					for (uint32_t arg = 4; arg < i.length; arg++)
+						ops[arg] >= left_components ? right_reads++ : left_reads++;
+
+					if (right_reads)
+					{
+						read(ops[2], left_reads);
+						read(ops[3], right_reads);
+					}
+					else
+						read(ops[2], 1);
+					break;
+				}
+
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	for (auto &count : read_counts)
+		if (count.second > 1)
+			forced_temporaries.insert(count.first);
+}
+
 bool CompilerGLSL::args_will_forward(uint32_t id, const uint32_t *args, uint32_t num_args, bool pure)
 {
 	if (forced_temporaries.find(id) != end(forced_temporaries))
@@ -9268,7 +9410,7 @@ void CompilerGLSL::branch(uint32_t from, uint32_t to)
 	flush_all_active_variables();
 
 	// This is only a continue if we branch to our loop dominator.
-	if (loop_blocks.find(to) != end(loop_blocks) && get<SPIRBlock>(from).loop_dominator == to)
+	if (shared_ir->loop_blocks.count(to) != 0 && get<SPIRBlock>(from).loop_dominator == to)
 	{
 		// This can happen if we had a complex continue block which was emitted.
 		// Once the continue block tries to branch to the loop header, just emit continue;
@@ -9423,7 +9565,7 @@ string CompilerGLSL::emit_continue_block(uint32_t continue_block)
 	redirect_statement = &statements;
 
 	// Stamp out all blocks one after each other.
-	while (loop_blocks.find(block->self) == end(loop_blocks))
+	while (shared_ir->loop_blocks.count(block->self) == 0)
 	{
 		propagate_loop_dominators(*block);
 		// Write out all instructions we have in this block.
@@ -139,6 +139,12 @@ public:
 		init();
 	}
 
+	explicit CompilerGLSL(ParsedIR ir)
+	    : Compiler(std::move(ir))
+	{
+		init();
+	}
+
 	// Deprecate this interface because it doesn't overload properly with subclasses.
 	// Requires awkward static casting, which was a mistake.
 	SPIRV_CROSS_DEPRECATED("get_options() is obsolete, use get_common_options() instead.")
@@ -514,6 +520,7 @@ protected:
 	// avoid AST explosion when SPIRV is generated with pure SSA and doesn't write stuff to variables.
 	std::unordered_map<uint32_t, uint32_t> expression_usage_counts;
 	void track_expression_read(uint32_t id);
+	void analyze_expression_reads();
 
 	std::vector<std::string> forced_extensions;
 	std::vector<std::string> header_lines;
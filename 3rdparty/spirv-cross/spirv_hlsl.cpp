@@ -2425,7 +2425,7 @@ void CompilerHLSL::emit_texture_op(const Instruction &i)
 	auto op = static_cast<Op>(i.op);
 	uint32_t length = i.length;
 
-	if (i.offset + length > spirv.size())
+	if (i.offset + length > shared_ir->spirv.size())
 		SPIRV_CROSS_THROW("Compiler::parse() opcode out of range.");
 
 	vector<uint32_t> inherited_expressions;
@@ -4605,15 +4605,16 @@ string CompilerHLSL::compile()
 	build_function_control_flow_graphs_and_analyze();
 	update_active_builtins();
 	analyze_image_and_sampler_usage();
+	analyze_expression_reads();
 
 	// Subpass input needs SV_Position.
 	if (need_subpass_input)
 		active_input_builtins.set(BuiltInFragCoord);
 
-	uint32_t pass_count = 0;
+	compile_pass_count = 0;
 	do
 	{
-		if (pass_count >= 3)
+		if (compile_pass_count >= 3)
 			SPIRV_CROSS_THROW("Over 3 compilation loops detected. Must be a bug!");
 
 		reset();
@@ -4627,7 +4628,7 @@ string CompilerHLSL::compile()
 		emit_function(get<SPIRFunction>(entry_point), Bitset());
 		emit_hlsl_entry_point();
 
-		pass_count++;
+		compile_pass_count++;
 	} while (force_recompile);
 
 	// Entry point in HLSL is always main() for the time being.
@@ -66,6 +66,11 @@ public:
 	{
 	}
 
+	explicit CompilerHLSL(ParsedIR ir)
+	    : CompilerGLSL(std::move(ir))
+	{
+	}
+
 	SPIRV_CROSS_DEPRECATED("CompilerHLSL::get_options() is obsolete, use get_hlsl_options() instead.")
 	const Options &get_options() const
 	{
@@ -41,6 +41,19 @@ CompilerMSL::CompilerMSL(vector<uint32_t> spirv_, vector<MSLVertexAttr> *p_vtx_a
 			resource_bindings.push_back(&rb);
 }
 
+CompilerMSL::CompilerMSL(ParsedIR ir, vector<MSLVertexAttr> *p_vtx_attrs,
+                         vector<MSLResourceBinding> *p_res_bindings)
+    : CompilerGLSL(move(ir))
+{
+	if (p_vtx_attrs)
+		for (auto &va : *p_vtx_attrs)
+			vtx_attrs_by_location[va.location] = &va;
+
+	if (p_res_bindings)
+		for (auto &rb : *p_res_bindings)
+			resource_bindings.push_back(&rb);
+}
+
 CompilerMSL::CompilerMSL(const uint32_t *ir, size_t word_count, MSLVertexAttr *p_vtx_attrs, size_t vtx_attrs_count,
                          MSLResourceBinding *p_res_bindings, size_t res_bindings_count)
     : CompilerGLSL(ir, word_count)
@@ -323,6 +336,7 @@ string CompilerMSL::compile()
 	build_function_control_flow_graphs_and_analyze();
 	update_active_builtins();
 	analyze_image_and_sampler_usage();
+	analyze_expression_reads();
 	build_implicit_builtins();
 
 	fixup_image_load_store_access();
@@ -354,10 +368,10 @@ string CompilerMSL::compile()
 	if (msl_options.resolve_specialized_array_lengths)
 		resolve_specialized_array_lengths();
 
-	uint32_t pass_count = 0;
+	compile_pass_count = 0;
 	do
 	{
-		if (pass_count >= 3)
+		if (compile_pass_count >= 3)
 			SPIRV_CROSS_THROW("Over 3 compilation loops detected. Must be a bug!");
 
 		reset();
@@ -373,7 +387,7 @@ string CompilerMSL::compile()
 		emit_custom_functions();
 		emit_function(get<SPIRFunction>(entry_point), Bitset());
 
-		pass_count++;
+		compile_pass_count++;
 	} while (force_recompile);
 
 	return buffer->str();
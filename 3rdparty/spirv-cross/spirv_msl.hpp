@@ -261,6 +261,10 @@ public:
 	CompilerMSL(const uint32_t *ir, size_t word_count, MSLVertexAttr *p_vtx_attrs = nullptr, size_t vtx_attrs_count = 0,
 	            MSLResourceBinding *p_res_bindings = nullptr, size_t res_bindings_count = 0);
 
+	// Constructs from a parsed module (see Compiler::parse_ir()).
+	explicit CompilerMSL(ParsedIR ir, std::vector<MSLVertexAttr> *p_vtx_attrs = nullptr,
+	                     std::vector<MSLResourceBinding> *p_res_bindings = nullptr);
+
 	// Compiles the SPIR-V code into Metal Shading Language.
 	std::string compile() override;
 
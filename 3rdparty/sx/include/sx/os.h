@@ -2,7 +2,7 @@
 // Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
 // License: https://github.com/septag/sx#license-bsd-2-clause
 //
-// os.h - v1.1.0 - Common portable OS related functions
+// os.h - v1.2.0 - Common portable OS related functions
 //
 #pragma once
 
@@ -30,8 +30,12 @@ typedef struct sx_file_info
 {
     sx_file_type type;
     uint64_t     size;
+    uint64_t     last_modified;     // seconds since epoch
 } sx_file_info;
 
+// callback for sx_os_listdir, 'filename' is the name of the entry without the directory
+typedef void (sx_os_listdir_cb)(const char* filename, const sx_file_info* info, void* user);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +52,7 @@ void*  sx_os_dlsym(void* handle, const char* symbol);
 int    sx_os_chdir(const char* path);
 void   sx_os_sleep(int ms);
 void*  sx_os_exec(const char* const* argv);
+int    sx_os_getpid();
 
 char*  sx_os_path_pwd(char* dst, int size);
 char*  sx_os_path_abspath(char* dst, int size, const char* path);
@@ -66,6 +71,11 @@ bool   sx_os_path_isfile(const char* path);
 bool   sx_os_path_isdir(const char* path);
 
 sx_file_info sx_os_stat(const char* filepath);
+bool   sx_os_mkdir(const char* path);
+bool   sx_os_rename(const char* src, const char* dst);
+bool   sx_os_del(const char* filepath);
+bool   sx_os_touch(const char* filepath);
+bool   sx_os_listdir(const char* path, sx_os_listdir_cb* callback, void* user);
 
 #ifdef __cplusplus
 }
@@ -77,4 +87,5 @@ sx_file_info sx_os_stat(const char* filepath);
 // Version history
 //      1.0.0   Initial release
 //      1.1.0   Added path functions, sx_os_path_xxxx
+//      1.2.0   Added file modification time, sx_os_mkdir/rename/del/touch/listdir, sx_os_getpid
 //
\ No newline at end of file
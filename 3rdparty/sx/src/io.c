@@ -47,8 +47,9 @@ void sx_mem_destroy_block(sx_mem_block* mem)
     sx_assert(mem);
     
     if (mem->alloc) {
-        sx_free(mem->alloc, mem);
+        const sx_alloc* alloc = mem->alloc;
         mem->alloc = NULL;
+        sx_free(alloc, mem);
     }
 }
 
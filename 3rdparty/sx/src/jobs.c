@@ -36,6 +36,8 @@ typedef struct sx__job_thread_data
 {
     sx__job*        cur_job;
     sx_fiber_stack  selector_stack;
+    sx_fiber_stack  selector_stack2;    // main thread: the next selector is created on the stack that's not running
+    int             selector_stack_idx;
     sx_fiber_t      selector_fiber;
     uint32_t        tid;
     bool            main_thrd;
@@ -195,7 +197,10 @@ static void sx__job_selector_main_thrd(sx_fiber_transfer transfer)
         }
     }
 
-    tdata->selector_fiber = sx_fiber_create(tdata->selector_stack, sx__job_selector_main_thrd);
+    // This selector is still running on it's own stack, so the new one must not overwrite it
+    tdata->selector_stack_idx ^= 1;
+    tdata->selector_fiber = sx_fiber_create(tdata->selector_stack_idx ? tdata->selector_stack2 : tdata->selector_stack,
+                                            sx__job_selector_main_thrd);
     sx_fiber_switch(transfer.from, transfer.user);
 }
 
@@ -335,6 +340,8 @@ static sx__job_thread_data* sx__job_create_tdata(const sx_alloc* alloc, uint32_t
     tdata->main_thrd = main_thrd;
 
     bool r = sx_fiber_stack_init(&tdata->selector_stack, sx_os_minstacksz());
+    if (main_thrd)
+        r = r && sx_fiber_stack_init(&tdata->selector_stack2, sx_os_minstacksz());
     sx_assert(r && "Not enough memory for temp stacks");
     SX_UNUSED(r);
 
@@ -344,6 +351,8 @@ static sx__job_thread_data* sx__job_create_tdata(const sx_alloc* alloc, uint32_t
 static void sx__job_destroy_tdata(sx__job_thread_data* tdata, const sx_alloc* alloc)
 {
     sx_fiber_stack_release(&tdata->selector_stack);
+    if (tdata->main_thrd)
+        sx_fiber_stack_release(&tdata->selector_stack2);
     sx_free(alloc, tdata);
 }
 
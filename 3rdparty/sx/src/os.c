@@ -15,6 +15,8 @@
 #	include <windows.h>
 #	include <Psapi.h>
 #	include <direct.h>   	// _getcwd
+#	include <process.h>   	// _getpid
+#	include <sys/utime.h>	// _utime
 #elif SX_PLATFORM_POSIX
 #   include <unistd.h>
 #   include <sys/resource.h>
@@ -23,6 +25,7 @@
 #   include <pthread.h>
 #	include <limits.h>
 #	include <dirent.h>   	// S_IFREG
+#	include <utime.h>		// utime
 #   if !SX_PLATFORM_PS4
 #       include <dlfcn.h>   // dlopen, dlclose, dlsym
 #   endif
@@ -221,6 +224,17 @@ void sx_os_sleep(int ms)
 #endif // SX_PLATFORM_
 }
 
+int sx_os_getpid()
+{
+#if SX_PLATFORM_WINDOWS
+	return _getpid();
+#elif SX_PLATFORM_POSIX
+	return (int)getpid();
+#else
+	return 0;
+#endif
+}
+
 void* sx_os_exec(const char* const* argv)
 {
 #if SX_PLATFORM_LINUX || SX_PLATFORM_HURD
@@ -289,6 +303,7 @@ sx_file_info sx_os_stat(const char* filepath)
 		info.type = SX_FILE_TYPE_REGULAR;
 	else if (0 != (st.st_mode & _S_IFDIR))
 		info.type = SX_FILE_TYPE_DIRECTORY;
+	info.last_modified = (uint64_t)st.st_mtime;
 #else
 	struct stat st;
 	int32_t result = stat(filepath, &st);
@@ -299,12 +314,103 @@ sx_file_info sx_os_stat(const char* filepath)
 		info.type = SX_FILE_TYPE_REGULAR;
 	else if (0 != (st.st_mode & S_IFDIR))
 		info.type = SX_FILE_TYPE_DIRECTORY;
+	info.last_modified = (uint64_t)st.st_mtime;
 #endif // SX_COMPILER_MSVC
 
     info.size = st.st_size;
 	return info;
 }
 
+bool sx_os_mkdir(const char* path)
+{
+#if SX_PLATFORM_WINDOWS
+	return _mkdir(path) == 0;
+#else
+	return mkdir(path, 0755) == 0;
+#endif
+}
+
+// replaces 'dst' if it already exists, the operation is atomic on posix systems
+bool sx_os_rename(const char* src, const char* dst)
+{
+#if SX_PLATFORM_WINDOWS
+	return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING) ? true : false;
+#else
+	return rename(src, dst) == 0;
+#endif
+}
+
+bool sx_os_del(const char* filepath)
+{
+#if SX_PLATFORM_WINDOWS
+	return DeleteFileA(filepath) ? true : false;
+#else
+	return unlink(filepath) == 0;
+#endif
+}
+
+// sets modification time of the file to current time
+bool sx_os_touch(const char* filepath)
+{
+#if SX_COMPILER_MSVC
+	return _utime(filepath, NULL) == 0;
+#else
+	return utime(filepath, NULL) == 0;
+#endif
+}
+
+// calls 'callback' for every regular file and directory in 'path', except '.' and '..'
+bool sx_os_listdir(const char* path, sx_os_listdir_cb* callback, void* user)
+{
+	sx_assert(callback);
+
+#if SX_PLATFORM_WINDOWS
+	char filter[512];
+	sx_os_path_join(filter, sizeof(filter), path, "*");
+	WIN32_FIND_DATAA fd;
+	HANDLE hfind = FindFirstFileA(filter, &fd);
+	if (hfind == INVALID_HANDLE_VALUE)
+		return false;
+
+	do {
+		if (sx_strequal(fd.cFileName, ".") || sx_strequal(fd.cFileName, ".."))
+			continue;
+		sx_file_info info;
+		info.type = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? SX_FILE_TYPE_DIRECTORY : SX_FILE_TYPE_REGULAR;
+		info.size = ((uint64_t)fd.nFileSizeHigh << 32) | (uint64_t)fd.nFileSizeLow;
+		// FILETIME is in 100ns intervals since 1601-01-01
+		uint64_t ft = ((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32) | (uint64_t)fd.ftLastWriteTime.dwLowDateTime;
+		info.last_modified = ft / 10000000ull - 11644473600ull;
+		callback(fd.cFileName, &info, user);
+	} while (FindNextFileA(hfind, &fd));
+
+	FindClose(hfind);
+	return true;
+#elif SX_PLATFORM_POSIX
+	DIR* dir = opendir(path);
+	if (!dir)
+		return false;
+
+	struct dirent* ent;
+	char filepath[PATH_MAX];
+	while ((ent = readdir(dir)) != NULL) {
+		if (sx_strequal(ent->d_name, ".") || sx_strequal(ent->d_name, ".."))
+			continue;
+		sx_os_path_join(filepath, sizeof(filepath), path, ent->d_name);
+		sx_file_info info = sx_os_stat(filepath);
+		if (info.type != SX_FILE_TYPE_INVALID)
+			callback(ent->d_name, &info, user);
+	}
+
+	closedir(dir);
+	return true;
+#else
+	SX_UNUSED(path);
+	SX_UNUSED(user);
+	return false;
+#endif
+}
+
 char* sx_os_path_pwd(char* dst, int size)
 {
 #if SX_PLATFORM_PS4     \
@@ -412,7 +518,7 @@ char* sx_os_path_splitext(char* ext, int ext_size, char* basename, int basename_
 			if (*e != '.') 
 				continue;
 			sx_strcpy(ext, ext_size, e);
-			sx_strncpy(basename, basename_size, path, (int)(intptr_t)(e - path - 1));
+			sx_strncpy(basename, basename_size, path, (int)(intptr_t)(e - path));
 			return ext;
 		}
 	}
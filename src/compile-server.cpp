@@ -0,0 +1,303 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "compile-server.h"
+
+#include "sx/os.h"
+#include "sx/string.h"
+
+#include <stdio.h>
+#include <string>
+
+#if SX_PLATFORM_POSIX
+#   include <unistd.h>
+#   include <signal.h>
+#   include <errno.h>
+#   include <sys/socket.h>
+#   include <sys/time.h>
+#   include <sys/un.h>
+
+// Requests are served one at a time, a client that stops sending or receiving is dropped after this time, so it
+// can't block the server and the clients after it
+static const int k_compile_server_io_timeout_sec = 10;
+
+static volatile sig_atomic_t g_quit = 0;
+
+static void compile_server__signal_handler(int sig)
+{
+    SX_UNUSED(sig);
+    g_quit = 1;
+}
+
+static bool compile_server__read(int fd, void* data, size_t size)
+{
+    uint8_t* buff = (uint8_t*)data;
+    while (size > 0) {
+        ssize_t r = read(fd, buff, size);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        buff += r;
+        size -= (size_t)r;
+    }
+    return true;
+}
+
+static bool compile_server__write(int fd, const void* data, size_t size)
+{
+    const uint8_t* buff = (const uint8_t*)data;
+    while (size > 0) {
+        ssize_t r = write(fd, buff, size);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return false;
+        buff += r;
+        size -= (size_t)r;
+    }
+    return true;
+}
+
+static bool compile_server__make_addr(const char* socket_path, sockaddr_un* addr)
+{
+    sx_memset(addr, 0x0, sizeof(sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if (sx_strlen(socket_path) >= (int)sizeof(addr->sun_path))
+        return false;
+    sx_strcpy(addr->sun_path, sizeof(addr->sun_path), socket_path);
+    return true;
+}
+
+static int compile_server__connect(const char* socket_path)
+{
+    sockaddr_un addr;
+    if (!compile_server__make_addr(socket_path, &addr))
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Redirects stdout or stderr to a temp file until 'end' is called
+struct compile_server__capture
+{
+    int     fd;
+    int     saved_fd;
+    FILE*   file;
+
+    bool begin(FILE* stream)
+    {
+        fflush(stream);
+        fd = fileno(stream);
+        file = tmpfile();
+        if (!file)
+            return false;
+        saved_fd = dup(fd);
+        dup2(fileno(file), fd);
+        return true;
+    }
+
+    std::string end(FILE* stream)
+    {
+        std::string text;
+        if (!file)
+            return text;
+
+        fflush(stream);
+        dup2(saved_fd, fd);
+        close(saved_fd);
+
+        long size = ftell(file);
+        if (size > 0) {
+            text.resize((size_t)size);
+            fseek(file, 0, SEEK_SET);
+            text.resize(fread(&text[0], 1, (size_t)size, file));
+        }
+        fclose(file);
+        file = nullptr;
+        return text;
+    }
+};
+
+static void compile_server__process(const sx_alloc* alloc, int fd, const char* server_dir,
+                                    compile_server_cb* callback, void* user)
+{
+    compile_server_request req;
+    if (!compile_server__read(fd, &req, sizeof(req)) || req.sig != COMPILE_SERVER_SIG ||
+        req.version != COMPILE_SERVER_VERSION || req.num_args < 0 || req.data_size <= 0)
+    {
+        return;
+    }
+
+    std::string data;
+    data.resize((size_t)req.data_size);
+    if (!compile_server__read(fd, &data[0], data.size()) || data.back() != '\0')
+        return;
+
+    // data: working directory, then arguments, all null-terminated
+    const char* cwd = data.c_str();
+    const char** argv = (const char**)sx_malloc(alloc, sizeof(const char*)*(req.num_args + 1));
+    sx_assert(argv);
+    argv[0] = "glslcc";
+    const char* arg = cwd + sx_strlen(cwd) + 1;
+    const char* data_end = data.c_str() + data.size();
+    int argc = 1;
+    for (int i = 0; i < req.num_args && arg < data_end; i++) {
+        argv[argc++] = arg;
+        arg += sx_strlen(arg) + 1;
+    }
+
+    compile_server__capture out = {}, err = {};
+    compile_server_response resp;
+    resp.sig = COMPILE_SERVER_SIG;
+
+    // Errors are sent back to the client, instead of being printed by the server
+    std::string error;
+    if (!out.begin(stdout) || !err.begin(stderr))
+        error = "compile server: capturing output failed\n";
+    else if (sx_os_chdir(cwd) != 0)
+        error = std::string("compile server: changing directory to '") + cwd + "' failed\n";
+
+    resp.result = error.empty() ? callback(argc, argv, user) : -1;
+    std::string out_text = out.end(stdout);
+    std::string err_text = err.end(stderr) + error;
+    sx_os_chdir(server_dir);
+    sx_free(alloc, argv);
+
+    resp.out_size = (int)out_text.size();
+    resp.err_size = (int)err_text.size();
+    if (compile_server__write(fd, &resp, sizeof(resp)) &&
+        compile_server__write(fd, out_text.c_str(), out_text.size()))
+    {
+        compile_server__write(fd, err_text.c_str(), err_text.size());
+    }
+}
+
+bool compile_server_run(const sx_alloc* alloc, const char* socket_path, compile_server_cb* callback, void* user)
+{
+    sockaddr_un addr;
+    if (!compile_server__make_addr(socket_path, &addr)) {
+        printf("compile server: socket path '%s' is too long\n", socket_path);
+        return false;
+    }
+
+    // Socket file of a server that's not running anymore, is removed
+    int running_fd = compile_server__connect(socket_path);
+    if (running_fd >= 0) {
+        close(running_fd);
+        printf("compile server: another server is already running on '%s'\n", socket_path);
+        return false;
+    }
+    unlink(socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        printf("compile server: creating socket '%s' failed\n", socket_path);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    // SA_RESTART is not set, so 'accept' is interrupted by the signal
+    struct sigaction sa;
+    sx_memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = compile_server__signal_handler;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);     // client may disconnect before receiving the response
+
+    char server_dir[512];
+    sx_os_path_pwd(server_dir, sizeof(server_dir));
+
+    printf("compile server: listening on '%s'\n", socket_path);
+    fflush(stdout);
+
+    while (!g_quit) {
+        int client_fd = accept(fd, nullptr, nullptr);
+        if (client_fd < 0)
+            continue;
+
+        struct timeval timeout;
+        timeout.tv_sec = k_compile_server_io_timeout_sec;
+        timeout.tv_usec = 0;
+        setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        compile_server__process(alloc, client_fd, server_dir, callback, user);
+        close(client_fd);
+    }
+
+    close(fd);
+    unlink(socket_path);
+    puts("compile server: stopped");
+    return true;
+}
+
+bool compile_server_forward(const char* socket_path, int argc, const char* argv[], int* result)
+{
+    int fd = compile_server__connect(socket_path);
+    if (fd < 0)
+        return false;
+    signal(SIGPIPE, SIG_IGN);
+
+    char cwd[512];
+    sx_os_path_pwd(cwd, sizeof(cwd));
+    std::string data(cwd, sx_strlen(cwd) + 1);
+    for (int i = 1; i < argc; i++)
+        data.append(argv[i], sx_strlen(argv[i]) + 1);
+
+    compile_server_request req;
+    req.sig = COMPILE_SERVER_SIG;
+    req.version = COMPILE_SERVER_VERSION;
+    req.num_args = argc - 1;
+    req.data_size = (int)data.size();
+
+    compile_server_response resp;
+    bool r = compile_server__write(fd, &req, sizeof(req)) && compile_server__write(fd, data.c_str(), data.size()) &&
+             compile_server__read(fd, &resp, sizeof(resp)) && resp.sig == COMPILE_SERVER_SIG &&
+             resp.out_size >= 0 && resp.err_size >= 0;
+    if (r) {
+        std::string text;
+        text.resize((size_t)(resp.out_size + resp.err_size));
+        r = text.empty() || compile_server__read(fd, &text[0], text.size());
+        if (r) {
+            fwrite(text.c_str(), 1, (size_t)resp.out_size, stdout);
+            fwrite(text.c_str() + resp.out_size, 1, (size_t)resp.err_size, stderr);
+            *result = resp.result;
+        }
+    }
+
+    close(fd);
+    return r;
+}
+
+#else
+
+bool compile_server_run(const sx_alloc* alloc, const char* socket_path, compile_server_cb* callback, void* user)
+{
+    SX_UNUSED(alloc);
+    SX_UNUSED(socket_path);
+    SX_UNUSED(callback);
+    SX_UNUSED(user);
+    puts("compile server is not supported on this platform");
+    return false;
+}
+
+bool compile_server_forward(const char* socket_path, int argc, const char* argv[], int* result)
+{
+    SX_UNUSED(socket_path);
+    SX_UNUSED(argc);
+    SX_UNUSED(argv);
+    SX_UNUSED(result);
+    return false;
+}
+
+#endif // SX_PLATFORM_POSIX
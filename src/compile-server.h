@@ -0,0 +1,51 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Compile server over a local (unix domain) socket
+// The server keeps the compiler initialized between requests, so builtin symbol tables are only built once
+// Clients send their command line arguments and working directory, the server runs them one at a time, and
+// replies with the exit code and everything that is printed to stdout/stderr during the compilation
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+#pragma pack(push, 1)
+
+#define COMPILE_SERVER_SIG          0x52534347  // "GCSR"
+#define COMPILE_SERVER_VERSION      100
+
+// Followed by 'data_size' bytes: null-terminated working directory, and 'num_args' null-terminated arguments
+struct compile_server_request
+{
+    uint32_t    sig;
+    int         version;
+    int         num_args;
+    int         data_size;
+};
+
+// Followed by 'out_size' bytes of stdout and 'err_size' bytes of stderr
+struct compile_server_response
+{
+    uint32_t    sig;
+    int         result;
+    int         out_size;
+    int         err_size;
+};
+
+#pragma pack(pop)
+
+// Called for every request, with working directory already set to the client's
+typedef int (compile_server_cb)(int argc, const char* argv[], void* user);
+
+// Runs until the process gets SIGINT or SIGTERM, returns false if the socket can't be created
+bool compile_server_run(const sx_alloc* alloc, const char* socket_path, compile_server_cb* callback, void* user);
+
+// Sends the arguments (without argv[0]) to the server and prints the output
+// Returns false if the server is not available, so the caller can compile in its own process
+bool compile_server_forward(const char* socket_path, int argc, const char* argv[], int* result);
@@ -0,0 +1,405 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "compile-stats.h"
+
+#include "sx/string.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <new>
+#include <stdlib.h>
+#include <vector>
+
+// sjson (implementation is in glslcc.cpp)
+#include "../3rdparty/sjson/sjson.h"
+
+static const char* k_compile_stats_phase_names[COMPILE_STATS_COUNT] = {
+    "load",
+    "include",
+    "preprocess",
+    "parse",
+    "link",
+    "spirv",
+    "cross_parse",
+    "cross_compile",
+    "reflect",
+    "write"
+};
+
+static const int k_compile_stats_max_depth = 16;
+
+struct compile_stats__entry
+{
+    compile_stats*      st;
+    compile_stats_phase phase;
+};
+
+// Measurement state of the thread, every phase change adds the time and allocations since the last change to
+// the innermost phase
+struct compile_stats__thread
+{
+    compile_stats__entry    stack[k_compile_stats_max_depth];
+    int                     depth;
+    uint64_t                last_tick;
+    uint64_t                last_allocs;
+    uint64_t                last_alloc_bytes;
+};
+
+struct compile_stats__program
+{
+    std::string                 name;
+    std::vector<std::string>    stage_names;
+    std::vector<compile_stats>  stages;
+    compile_stats               program;
+};
+
+struct compile_stats_report
+{
+    const sx_alloc*                     alloc;
+    sx_mutex                            lock;
+    uint64_t                            start_tick;
+    std::vector<compile_stats__program> programs;
+};
+
+// Only the plain overloads of the global operator new are replaced, so the reports say what is counted
+static const char* k_compile_stats_allocs_note =
+    "allocs: global operator new and new[] only, aligned new, malloc and --pool pages are not counted";
+
+static bool g_compile_stats_enabled = false;
+static thread_local compile_stats__thread t_compile_stats;
+static thread_local uint64_t t_compile_stats_allocs = 0;
+static thread_local uint64_t t_compile_stats_alloc_bytes = 0;
+
+#ifndef GLSLCC_LIB
+// Heap allocations of glslang and SPIRV-Cross, counted for every thread
+// Without --stats, allocations only pay for the check of the global flag, thread-local counters are not touched
+void* operator new(size_t size)
+{
+    if (g_compile_stats_enabled) {
+        ++t_compile_stats_allocs;
+        t_compile_stats_alloc_bytes += size;
+    }
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    if (g_compile_stats_enabled) {
+        ++t_compile_stats_allocs;
+        t_compile_stats_alloc_bytes += size;
+    }
+    return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nt) noexcept
+{
+    return operator new(size, nt);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+    free(ptr);
+}
+#endif
+
+static void compile_stats__flush(compile_stats__thread* t)
+{
+    uint64_t tick = sx_tm_now();
+    if (t->depth > 0 && t->depth <= k_compile_stats_max_depth) {
+        const compile_stats__entry& e = t->stack[t->depth - 1];
+        if (e.st) {
+            compile_stats_counter* c = &e.st->phases[e.phase];
+            c->ticks += tick - t->last_tick;
+            c->allocs += t_compile_stats_allocs - t->last_allocs;
+            c->alloc_bytes += t_compile_stats_alloc_bytes - t->last_alloc_bytes;
+        }
+    }
+    t->last_tick = tick;
+    t->last_allocs = t_compile_stats_allocs;
+    t->last_alloc_bytes = t_compile_stats_alloc_bytes;
+}
+
+void compile_stats_enable()
+{
+    g_compile_stats_enabled = true;
+}
+
+void compile_stats_disable()
+{
+    g_compile_stats_enabled = false;
+}
+
+bool compile_stats_enabled()
+{
+    return g_compile_stats_enabled;
+}
+
+void compile_stats_begin(compile_stats* st, compile_stats_phase phase)
+{
+    if (!g_compile_stats_enabled)
+        return;
+
+    compile_stats__thread* t = &t_compile_stats;
+    compile_stats__flush(t);
+    if (t->depth < k_compile_stats_max_depth) {
+        if (!st && t->depth > 0)
+            st = t->stack[t->depth - 1].st;
+        t->stack[t->depth] = {st, phase};
+    }
+    ++t->depth;
+}
+
+void compile_stats_end()
+{
+    if (!g_compile_stats_enabled)
+        return;
+
+    compile_stats__thread* t = &t_compile_stats;
+    sx_assert(t->depth > 0);
+    compile_stats__flush(t);
+    --t->depth;
+}
+
+void compile_stats_add(compile_stats* dst, const compile_stats& src)
+{
+    for (int i = 0; i < COMPILE_STATS_COUNT; i++) {
+        dst->phases[i].ticks += src.phases[i].ticks;
+        dst->phases[i].allocs += src.phases[i].allocs;
+        dst->phases[i].alloc_bytes += src.phases[i].alloc_bytes;
+    }
+    dst->cross_compiles += src.cross_compiles;
+    dst->cross_passes += src.cross_passes;
+}
+
+compile_stats_report* compile_stats_create_report(const sx_alloc* alloc)
+{
+    compile_stats_report* r = new(sx_malloc(alloc, sizeof(compile_stats_report))) compile_stats_report;
+    sx_assert(r);
+    r->alloc = alloc;
+    r->start_tick = sx_tm_now();
+    sx_mutex_init(&r->lock);
+    return r;
+}
+
+void compile_stats_destroy_report(compile_stats_report* r)
+{
+    sx_assert(r);
+    sx_mutex_release(&r->lock);
+    const sx_alloc* alloc = r->alloc;
+    r->~compile_stats_report();
+    sx_free(alloc, r);
+}
+
+void compile_stats_add_program(compile_stats_report* r, const char* name, const char* const* stage_names,
+                               const compile_stats* stages, int num_stages, const compile_stats& program)
+{
+    compile_stats__program p;
+    p.name = name;
+    for (int i = 0; i < num_stages; i++) {
+        p.stage_names.push_back(stage_names[i]);
+        p.stages.push_back(stages[i]);
+    }
+    p.program = program;
+
+    sx_mutex_lock(&r->lock);
+    r->programs.push_back(std::move(p));
+    sx_mutex_unlock(&r->lock);
+}
+
+// Columns of the aggregate: stages by name in the order they first appear, then the program phases
+static void compile_stats__aggregate(const compile_stats_report* r, std::vector<std::string>* names,
+                                     std::vector<compile_stats>* columns)
+{
+    compile_stats program = {};
+    for (const compile_stats__program& p : r->programs) {
+        for (size_t i = 0; i < p.stages.size(); i++) {
+            size_t c = 0;
+            while (c < names->size() && (*names)[c] != p.stage_names[i])
+                c++;
+            if (c == names->size()) {
+                names->push_back(p.stage_names[i]);
+                columns->push_back(compile_stats());
+            }
+            compile_stats_add(&(*columns)[c], p.stages[i]);
+        }
+        compile_stats_add(&program, p.program);
+    }
+    names->push_back("program");
+    columns->push_back(program);
+}
+
+static void compile_stats__append_table(std::string* text, const std::string* names, const compile_stats* columns,
+                                        int num_columns)
+{
+    char line[128];
+    compile_stats total = {};
+    for (int c = 0; c < num_columns; c++)
+        compile_stats_add(&total, columns[c]);
+
+    sx_snprintf(line, sizeof(line), "  %-14s", "phase");
+    *text += line;
+    for (int c = 0; c <= num_columns; c++) {
+        sx_snprintf(line, sizeof(line), "%28s", c < num_columns ? names[c].c_str() : "total");
+        *text += line;
+    }
+    *text += "\n";
+
+    std::vector<compile_stats_counter> sums(num_columns + 1, compile_stats_counter());
+    for (int i = 0; i <= COMPILE_STATS_COUNT; i++) {
+        sx_snprintf(line, sizeof(line), "  %-14s", i < COMPILE_STATS_COUNT ? k_compile_stats_phase_names[i] : "total");
+        *text += line;
+        for (int c = 0; c <= num_columns; c++) {
+            const compile_stats& st = c < num_columns ? columns[c] : total;
+            compile_stats_counter counter;
+            if (i < COMPILE_STATS_COUNT) {
+                counter = st.phases[i];
+                sums[c].ticks += counter.ticks;
+                sums[c].allocs += counter.allocs;
+            } else {
+                counter = sums[c];
+            }
+            sx_snprintf(line, sizeof(line), "%9.2f ms %8llu allocs", sx_tm_ms(counter.ticks),
+                        (unsigned long long)counter.allocs);
+            *text += line;
+        }
+        *text += "\n";
+    }
+
+    // more passes than compiles means that SPIRV-Cross had to emit the code again (force_recompile)
+    for (int i = 0; i < 2; i++) {
+        sx_snprintf(line, sizeof(line), "  %-14s", i == 0 ? "cross_compiles" : "cross_passes");
+        *text += line;
+        for (int c = 0; c <= num_columns; c++) {
+            const compile_stats& st = c < num_columns ? columns[c] : total;
+            sx_snprintf(line, sizeof(line), "%28d", i == 0 ? st.cross_compiles : st.cross_passes);
+            *text += line;
+        }
+        *text += "\n";
+    }
+}
+
+std::string compile_stats_report_text(compile_stats_report* r)
+{
+    std::string text;
+    sx_mutex_lock(&r->lock);
+    for (const compile_stats__program& p : r->programs) {
+        std::vector<std::string> names = p.stage_names;
+        std::vector<compile_stats> columns = p.stages;
+        names.push_back("program");
+        columns.push_back(p.program);
+
+        text += "stats: " + p.name + "\n";
+        compile_stats__append_table(&text, names.data(), columns.data(), (int)columns.size());
+    }
+
+    std::vector<std::string> names;
+    std::vector<compile_stats> columns;
+    compile_stats__aggregate(r, &names, &columns);
+
+    char line[128];
+    sx_snprintf(line, sizeof(line), "stats: %d programs, %.2f ms wall time\n", (int)r->programs.size(),
+                sx_tm_ms(sx_tm_since(r->start_tick)));
+    text += line;
+    if (r->programs.size() > 1)
+        compile_stats__append_table(&text, names.data(), columns.data(), (int)columns.size());
+    text += k_compile_stats_allocs_note;
+    text += "\n";
+    sx_mutex_unlock(&r->lock);
+    return text;
+}
+
+static sjson_node* compile_stats__json_stats(sjson_context* jctx, const char* name, const compile_stats& st)
+{
+    sjson_node* jstats = sjson_mkobject(jctx);
+    sjson_put_string(jctx, jstats, "name", name);
+    sjson_node* jphases = sjson_put_obj(jctx, jstats, "phases");
+    double total_ms = 0;
+    uint64_t total_allocs = 0;
+    for (int i = 0; i < COMPILE_STATS_COUNT; i++) {
+        const compile_stats_counter& c = st.phases[i];
+        sjson_node* jphase = sjson_put_obj(jctx, jphases, k_compile_stats_phase_names[i]);
+        sjson_put_double(jctx, jphase, "ms", sx_tm_ms(c.ticks));
+        sjson_put_int(jctx, jphase, "allocs", (int)c.allocs);
+        sjson_put_double(jctx, jphase, "alloc_bytes", (double)c.alloc_bytes);
+        total_ms += sx_tm_ms(c.ticks);
+        total_allocs += c.allocs;
+    }
+    sjson_put_double(jctx, jstats, "ms", total_ms);
+    sjson_put_int(jctx, jstats, "allocs", (int)total_allocs);
+    sjson_put_int(jctx, jstats, "cross_compiles", st.cross_compiles);
+    sjson_put_int(jctx, jstats, "cross_passes", st.cross_passes);
+    return jstats;
+}
+
+static sjson_node* compile_stats__json_columns(sjson_context* jctx, const std::string* names,
+                                               const compile_stats* columns, int num_columns)
+{
+    sjson_node* jstages = sjson_mkarray(jctx);
+    for (int c = 0; c < num_columns; c++)
+        sjson_append_element(jstages, compile_stats__json_stats(jctx, names[c].c_str(), columns[c]));
+    return jstages;
+}
+
+std::string compile_stats_report_json(compile_stats_report* r)
+{
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)r->alloc);
+    sx_assert(jctx);
+
+    sx_mutex_lock(&r->lock);
+    sjson_node* jroot = sjson_mkobject(jctx);
+    sjson_put_double(jctx, jroot, "wall_ms", sx_tm_ms(sx_tm_since(r->start_tick)));
+    sjson_put_string(jctx, jroot, "allocs_note", k_compile_stats_allocs_note);
+
+    sjson_node* jprogs = sjson_put_array(jctx, jroot, "programs");
+    for (const compile_stats__program& p : r->programs) {
+        std::vector<std::string> names = p.stage_names;
+        std::vector<compile_stats> columns = p.stages;
+        names.push_back("program");
+        columns.push_back(p.program);
+
+        sjson_node* jprog = sjson_mkobject(jctx);
+        sjson_put_string(jctx, jprog, "name", p.name.c_str());
+        sjson_append_member(jctx, jprog, "stages",
+                            compile_stats__json_columns(jctx, names.data(), columns.data(), (int)columns.size()));
+        sjson_append_element(jprogs, jprog);
+    }
+
+    std::vector<std::string> names;
+    std::vector<compile_stats> columns;
+    compile_stats__aggregate(r, &names, &columns);
+    sjson_append_member(jctx, jroot, "total",
+                        compile_stats__json_columns(jctx, names.data(), columns.data(), (int)columns.size()));
+    sx_mutex_unlock(&r->lock);
+
+    char* json_str = sjson_stringify(jctx, jroot, "  ");
+    std::string json(json_str);
+    sjson_free_string(jctx, json_str);
+    sjson_destroy_context(jctx);
+    return json;
+}
@@ -0,0 +1,87 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Per-phase compile statistics (--stats): wall time and heap allocations of every phase of every stage
+//      - Phases are measured on the thread that runs them, and they nest: time and allocations of an inner phase
+//        (include resolution inside preprocessing, preprocessing inside parsing) are not counted in the outer one
+//      - The parser pulls tokens from glslang's preprocessor one at a time, preprocessing inside parse is measured
+//        around every token request (glslang::TPreprocessorObserver), so it adds some overhead to parsing
+//      - Allocations are counted by replacing the global operator new of the executable, which is what glslang
+//        (except its memory pools) and SPIRV-Cross use. Without --stats, they are not counted. The library doesn't
+//        count allocations. Aligned operator new is not replaced, and reports say so
+//      - Programs are added to a report, which is printed as text or written as JSON with the aggregate of all
+//        programs (batch, variants, watch mode)
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+#include <string>
+
+enum compile_stats_phase
+{
+    COMPILE_STATS_LOAD = 0,         // loading source files of the stages
+    COMPILE_STATS_INCLUDE,          // resolving and loading included files
+    COMPILE_STATS_PREPROCESS,
+    COMPILE_STATS_PARSE,
+    COMPILE_STATS_LINK,             // TProgram::link
+    COMPILE_STATS_SPIRV,            // GlslangToSpv
+    COMPILE_STATS_CROSS_PARSE,      // SPIRV-Cross parsing the SPIR-V (once per stage), and copying it to compilers
+    COMPILE_STATS_CROSS_COMPILE,
+    COMPILE_STATS_REFLECT,          // reflection json
+    COMPILE_STATS_WRITE,            // output files
+    COMPILE_STATS_COUNT
+};
+
+struct compile_stats_counter
+{
+    uint64_t    ticks;
+    uint64_t    allocs;
+    uint64_t    alloc_bytes;
+};
+
+struct compile_stats
+{
+    compile_stats_counter   phases[COMPILE_STATS_COUNT];
+    int                     cross_compiles;
+    int                     cross_passes;       // SPIRV-Cross compile passes, more than one pass per compile means
+                                                // that code was emitted again (force_recompile)
+};
+
+struct compile_stats_report;
+
+// Call it once before compiling anything, measurement functions do nothing when stats are not enabled
+// Disable it when all compilations are done, so later requests of the compile server don't pay for it
+void    compile_stats_enable();
+void    compile_stats_disable();
+bool    compile_stats_enabled();
+
+// Starts measuring the phase on the current thread, until compile_stats_end. If 'st' is NULL, the phase is added
+// to the stats of the outer phase, and it's not measured if there is none
+void    compile_stats_begin(compile_stats* st, compile_stats_phase phase);
+void    compile_stats_end();
+
+void    compile_stats_add(compile_stats* dst, const compile_stats& src);
+
+compile_stats_report*   compile_stats_create_report(const sx_alloc* alloc);
+void                    compile_stats_destroy_report(compile_stats_report* r);
+
+// Adds a compiled program, 'stages' and 'stage_names' are arrays of 'num_stages'. 'program' holds the phases that
+// are not per stage (link, ...). Thread-safe
+void    compile_stats_add_program(compile_stats_report* r, const char* name, const char* const* stage_names,
+                                  const compile_stats* stages, int num_stages, const compile_stats& program);
+
+// Text report: a table of phases for every program, and the aggregate of all programs
+std::string compile_stats_report_text(compile_stats_report* r);
+std::string compile_stats_report_json(compile_stats_report* r);
+
+struct compile_stats_scope
+{
+    compile_stats_scope(compile_stats* st, compile_stats_phase phase) { compile_stats_begin(st, phase); }
+    ~compile_stats_scope() { compile_stats_end(); }
+};
@@ -0,0 +1,196 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "compile-trace.h"
+
+#include "sx/allocator.h"
+#include "sx/string.h"
+#include "sx/threads.h"
+#include "sx/timer.h"
+
+#include <vector>
+
+// sjson (implementation is in glslcc.cpp)
+#include "../3rdparty/sjson/sjson.h"
+
+struct compile_trace__event
+{
+    std::string name;
+    std::string detail;
+    uint32_t    tid;
+    uint64_t    start_tick;
+    uint64_t    end_tick;
+    uint64_t    preprocess_ticks;   // preprocessing inside parse, 0 if there isn't any
+};
+
+// Preprocessing inside parse on the current thread
+struct compile_trace__preprocess
+{
+    uint64_t    start_tick;
+    uint64_t    total_ticks;
+};
+
+struct compile_trace__context
+{
+    sx_mutex                            lock;
+    uint64_t                            start_tick;
+    uint32_t                            main_tid;
+    std::vector<compile_trace__event>   events;
+    std::vector<uint32_t>               tids;       // threads that have events, in order of their first event
+};
+
+static const double k_compile_trace_min_preprocess_us = 20.0;
+
+static compile_trace__context g_compile_trace;
+static bool g_compile_trace_started = false;
+static thread_local compile_trace__preprocess t_compile_trace_preprocess;
+
+static void compile_trace__add_event(compile_trace__event&& e)
+{
+    sx_mutex_lock(&g_compile_trace.lock);
+    bool new_tid = true;
+    for (uint32_t t : g_compile_trace.tids) {
+        if (t == e.tid) {
+            new_tid = false;
+            break;
+        }
+    }
+    if (new_tid)
+        g_compile_trace.tids.push_back(e.tid);
+    g_compile_trace.events.push_back(std::move(e));
+    sx_mutex_unlock(&g_compile_trace.lock);
+}
+
+void compile_trace_start()
+{
+    sx_assert(!g_compile_trace_started);
+    sx_mutex_init(&g_compile_trace.lock);
+    g_compile_trace.start_tick = sx_tm_now();
+    g_compile_trace.main_tid = sx_thread_tid();
+    g_compile_trace_started = true;
+}
+
+bool compile_trace_started()
+{
+    return g_compile_trace_started;
+}
+
+std::string compile_trace_stop()
+{
+    sx_assert(g_compile_trace_started);
+    g_compile_trace_started = false;
+
+    const sx_alloc* alloc = sx_alloc_malloc;
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)alloc);
+    sx_assert(jctx);
+
+    sjson_node* jroot = sjson_mkobject(jctx);
+    sjson_put_string(jctx, jroot, "displayTimeUnit", "ms");
+    sjson_node* jevents = sjson_put_array(jctx, jroot, "traceEvents");
+
+    int worker_index = 0;
+    for (uint32_t tid : g_compile_trace.tids) {
+        char name[32];
+        if (tid == g_compile_trace.main_tid)
+            sx_strcpy(name, sizeof(name), "main");
+        else
+            sx_snprintf(name, sizeof(name), "worker %d", ++worker_index);
+
+        sjson_node* jevent = sjson_mkobject(jctx);
+        sjson_put_string(jctx, jevent, "name", "thread_name");
+        sjson_put_string(jctx, jevent, "ph", "M");
+        sjson_put_int(jctx, jevent, "pid", 1);
+        sjson_put_double(jctx, jevent, "tid", (double)tid);
+        sjson_put_string(jctx, sjson_put_obj(jctx, jevent, "args"), "name", name);
+        sjson_append_element(jevents, jevent);
+    }
+
+    for (const compile_trace__event& e : g_compile_trace.events) {
+        sjson_node* jevent = sjson_mkobject(jctx);
+        sjson_put_string(jctx, jevent, "name", e.name.c_str());
+        sjson_put_string(jctx, jevent, "cat", "glslcc");
+        sjson_put_string(jctx, jevent, "ph", "X");
+        sjson_put_int(jctx, jevent, "pid", 1);
+        sjson_put_double(jctx, jevent, "tid", (double)e.tid);
+        sjson_put_double(jctx, jevent, "ts", sx_tm_us(e.start_tick - g_compile_trace.start_tick));
+        sjson_put_double(jctx, jevent, "dur", sx_tm_us(e.end_tick - e.start_tick));
+        if (!e.detail.empty() || e.preprocess_ticks) {
+            sjson_node* jargs = sjson_put_obj(jctx, jevent, "args");
+            if (!e.detail.empty())
+                sjson_put_string(jctx, jargs, "detail", e.detail.c_str());
+            if (e.preprocess_ticks)
+                sjson_put_double(jctx, jargs, "preprocess_ms", sx_tm_ms(e.preprocess_ticks));
+        }
+        sjson_append_element(jevents, jevent);
+    }
+
+    char* json_str = sjson_stringify(jctx, jroot, nullptr);
+    std::string json(json_str);
+    sjson_free_string(jctx, json_str);
+    sjson_destroy_context(jctx);
+
+    g_compile_trace.events.clear();
+    g_compile_trace.tids.clear();
+    sx_mutex_release(&g_compile_trace.lock);
+    return json;
+}
+
+void compile_trace_begin_preprocess()
+{
+    if (g_compile_trace_started)
+        t_compile_trace_preprocess.start_tick = sx_tm_now();
+}
+
+// Most token requests only take a few hundred nanoseconds, recording all of them would flood the trace
+void compile_trace_end_preprocess()
+{
+    compile_trace__preprocess* p = &t_compile_trace_preprocess;
+    if (!g_compile_trace_started || !p->start_tick)
+        return;
+
+    uint64_t end_tick = sx_tm_now();
+    uint64_t ticks = end_tick - p->start_tick;
+    p->total_ticks += ticks;
+    if (sx_tm_us(ticks) >= k_compile_trace_min_preprocess_us) {
+        compile_trace__event e;
+        e.name = "preprocess";
+        e.tid = sx_thread_tid();
+        e.start_tick = p->start_tick;
+        e.end_tick = end_tick;
+        e.preprocess_ticks = 0;
+        compile_trace__add_event(std::move(e));
+    }
+    p->start_tick = 0;
+}
+
+compile_trace_scope::compile_trace_scope(const char* _name, const char* _detail) : 
+    name(_name), detail(_detail), start_tick(0), preprocess_ticks(0), tid(0)
+{
+    if (g_compile_trace_started) {
+        start_tick = sx_tm_now();
+        preprocess_ticks = t_compile_trace_preprocess.total_ticks;
+        tid = sx_thread_tid();
+    }
+}
+
+// Events are recorded when they end, with the thread that started them. Jobs run on fibers that may continue on
+// another thread after waiting, so the thread is not taken again here, and preprocessing time is only added if
+// the scope ends on the thread that started it
+compile_trace_scope::~compile_trace_scope()
+{
+    if (!g_compile_trace_started || !start_tick)
+        return;
+
+    compile_trace__event e;
+    e.name = name;
+    e.detail = detail ? detail : "";
+    e.tid = tid;
+    e.start_tick = start_tick;
+    e.end_tick = sx_tm_now();
+    e.preprocess_ticks = 0;
+    if (t_compile_trace_preprocess.total_ticks != preprocess_ticks && sx_thread_tid() == tid)
+        e.preprocess_ticks = t_compile_trace_preprocess.total_ticks - preprocess_ticks;
+    compile_trace__add_event(std::move(e));
+}
@@ -0,0 +1,44 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Chrome trace events of the compile pipeline (--trace), can be loaded in chrome://tracing or Perfetto
+//      - Every scope becomes a complete event ("ph": "X") on the thread that started it, so stalls of batch and
+//        parallel builds show up as gaps between the events of the worker threads
+//      - Events are named by phase (parse, link, spirv, ...) and carry the file or program in their args
+//      - Preprocessing inside parse is interleaved with parsing token by token. Token requests that take longer than
+//        k_compile_trace_min_preprocess_us (directives, includes, large macro expansions) become "preprocess"
+//        events, and scopes get the total preprocessing time of their thread in their args (preprocess_ms)
+//      - Scopes only keep pointers to their name and detail, they must stay valid until the scope ends
+//
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Starts capturing events of all threads, scopes do nothing when capture is not started
+void    compile_trace_start();
+bool    compile_trace_started();
+
+// Stops capturing, and returns the captured events as trace event json
+std::string compile_trace_stop();
+
+// Called around every token request of the parser (glslang::TPreprocessorObserver)
+void    compile_trace_begin_preprocess();
+void    compile_trace_end_preprocess();
+
+struct compile_trace_scope
+{
+    compile_trace_scope(const char* name, const char* detail);
+    ~compile_trace_scope();
+
+    const char* name;
+    const char* detail;
+    uint64_t    start_tick;
+    uint64_t    preprocess_ticks;   // preprocessing time of the thread when the scope started
+    uint32_t    tid;
+};
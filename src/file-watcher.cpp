@@ -0,0 +1,200 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "file-watcher.h"
+
+#include "sx/os.h"
+#include "sx/string.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+char* file_watcher_path(char* dst, int size, const char* filepath)
+{
+    std::string path(filepath);
+    size_t slash = path.find_last_of("/\\");
+    std::string dir = slash != std::string::npos ? path.substr(0, slash) : std::string(".");
+    std::string name = slash != std::string::npos ? path.substr(slash + 1) : path;
+    if (dir.empty())
+        dir = "/";
+
+    char abs_dir[512];
+    if (sx_os_path_isdir(dir.c_str()))
+        sx_os_path_abspath(abs_dir, sizeof(abs_dir), dir.c_str());
+    else
+        sx_strcpy(abs_dir, sizeof(abs_dir), dir.c_str());
+    sx_os_path_unixpath(abs_dir, sizeof(abs_dir), abs_dir);
+
+    std::string abs_path(abs_dir);
+    if (abs_path.empty() || abs_path.back() != '/')
+        abs_path += "/";
+    abs_path += name;
+    sx_strcpy(dst, size, abs_path.c_str());
+    return dst;
+}
+
+#if SX_PLATFORM_LINUX
+#   include <unistd.h>
+#   include <signal.h>
+#   include <errno.h>
+#   include <poll.h>
+#   include <sys/inotify.h>
+
+static volatile sig_atomic_t g_quit = 0;
+
+static void file_watcher__signal_handler(int sig)
+{
+    SX_UNUSED(sig);
+    g_quit = 1;
+}
+
+struct file_watcher
+{
+    const sx_alloc*                         alloc   = nullptr;
+    int                                     fd      = -1;
+    std::unordered_map<int, std::string>    dirs;       // watch descriptor -> directory
+    std::unordered_map<std::string, int>    dir_wds;    // directory -> watch descriptor
+    std::unordered_set<std::string>         files;      // absolute paths of watched files
+};
+
+file_watcher* file_watcher_create(const sx_alloc* alloc)
+{
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0)
+        return nullptr;
+
+    file_watcher* w = new(sx_malloc(alloc, sizeof(file_watcher))) file_watcher;
+    sx_assert(w);
+    w->alloc = alloc;
+    w->fd = fd;
+    return w;
+}
+
+void file_watcher_destroy(file_watcher* w)
+{
+    sx_assert(w);
+    close(w->fd);
+    w->~file_watcher();
+    sx_free(w->alloc, w);
+}
+
+bool file_watcher_add(file_watcher* w, const char* filepath)
+{
+    char path[512];
+    file_watcher_path(path, sizeof(path), filepath);
+    if (w->files.find(path) != w->files.end())
+        return true;
+
+    std::string dir(path, sx_strrchar(path, '/') - path);
+    if (dir.empty())
+        dir = "/";
+    if (w->dir_wds.find(dir) == w->dir_wds.end()) {
+        // IN_CLOSE_WRITE: file is written in place, IN_MOVED_TO: new file is renamed over the old one
+        int wd = inotify_add_watch(w->fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0)
+            return false;
+        w->dirs[wd] = dir;
+        w->dir_wds[dir] = wd;
+    }
+
+    w->files.insert(path);
+    return true;
+}
+
+// Reads all pending events, and adds the watched files that are changed
+static void file_watcher__read_events(file_watcher* w, std::vector<std::string>* changed)
+{
+    alignas(inotify_event) char buff[4096];
+    for (;;) {
+        ssize_t size = read(w->fd, buff, sizeof(buff));
+        if (size <= 0)
+            break;
+
+        for (char* p = buff; p < buff + size; ) {
+            const inotify_event* e = (const inotify_event*)p;
+            p += sizeof(inotify_event) + e->len;
+
+            auto it = w->dirs.find(e->wd);
+            if (e->len == 0 || it == w->dirs.end())
+                continue;
+            std::string path = it->second;
+            if (path.back() != '/')
+                path += "/";
+            path += e->name;
+            if (w->files.find(path) != w->files.end() &&
+                std::find(changed->begin(), changed->end(), path) == changed->end())
+            {
+                changed->push_back(path);
+            }
+        }
+    }
+}
+
+bool file_watcher_wait(file_watcher* w, int settle_ms, file_watcher_cb* callback, void* user)
+{
+    // SA_RESTART is not set, so 'poll' is interrupted by the signal
+    struct sigaction sa;
+    sx_memset(&sa, 0x0, sizeof(sa));
+    sa.sa_handler = file_watcher__signal_handler;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    std::vector<std::string> changed;
+    while (!g_quit) {
+        pollfd pfd = {w->fd, POLLIN, 0};
+        // after the first change, wait a little more for the other files that are saved at the same time
+        int r = poll(&pfd, 1, changed.empty() ? -1 : settle_ms);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        if (r == 0)
+            break;
+        file_watcher__read_events(w, &changed);
+    }
+
+    if (g_quit)
+        return false;
+
+    for (const std::string& path : changed)
+        callback(path.c_str(), user);
+    return true;
+}
+
+#else
+
+file_watcher* file_watcher_create(const sx_alloc* alloc)
+{
+    SX_UNUSED(alloc);
+    return nullptr;
+}
+
+void file_watcher_destroy(file_watcher* w)
+{
+    SX_UNUSED(w);
+}
+
+bool file_watcher_add(file_watcher* w, const char* filepath)
+{
+    SX_UNUSED(w);
+    SX_UNUSED(filepath);
+    return false;
+}
+
+bool file_watcher_wait(file_watcher* w, int settle_ms, file_watcher_cb* callback, void* user)
+{
+    SX_UNUSED(w);
+    SX_UNUSED(settle_ms);
+    SX_UNUSED(callback);
+    SX_UNUSED(user);
+    return false;
+}
+
+#endif // SX_PLATFORM_LINUX
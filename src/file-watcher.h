@@ -0,0 +1,36 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Watches files for changes (--watch), only implemented with inotify on Linux
+// Files are watched through their directories, because most editors save files by writing a new file and
+// renaming it over the old one, which drops any watch on the old file itself
+// Files are identified by their absolute paths (file_watcher_path), which are also passed to the callback
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+struct file_watcher;
+
+typedef void (file_watcher_cb)(const char* filepath, void* user);
+
+// Returns NULL if file watching is not supported on the platform
+file_watcher* file_watcher_create(const sx_alloc* alloc);
+void          file_watcher_destroy(file_watcher* w);
+
+// Makes the absolute path of the file, the file itself doesn't need to exist, but it's directory does
+char*         file_watcher_path(char* dst, int size, const char* filepath);
+
+// Adding the same file again does nothing, 'filepath' can be relative to the current directory
+bool          file_watcher_add(file_watcher* w, const char* filepath);
+
+// Blocks until some of the watched files are changed, and calls 'callback' once for every changed file
+// Changes that come within 'settle_ms' of each other are reported together, so saving multiple files at once
+// is handled in one go
+// Returns false if the process gets SIGINT or SIGTERM, or watching fails
+bool          file_watcher_wait(file_watcher* w, int settle_ms, file_watcher_cb* callback, void* user);
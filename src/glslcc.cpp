@@ -8,6 +8,18 @@
 //      1.1.0       SGS file support (native binary format that holds all shaders and reflection data)
 //      1.2.0       Added HLSL vertex semantics
 //      1.2.1       Linux build
+//      1.3.0       Batch mode (--batch): compile multiple programs from a json manifest in one process
+//                  Parallel compilation (--jobs) of programs and stages on worker threads
+//                  Multiple target languages (--lang=gles:300,hlsl:50,metal) from a single SPIR-V compilation
+//                  Compilation cache (--cache-dir)
+//                  Compile server (--serve/--client) that keeps the compiler initialized between commands
+//                  libglslcc: C API (glslcc.h) for compiling shaders in memory
+//                  Shader variants (--variants), all permutations are compiled into a single archive
+//                  Dependency files (--depfile) of included files for incremental builds
+//                  Watch mode (--watch) that recompiles programs when their files are changed, atomic output writes
+//                  Include cache: included files are loaded once and shared by all compilations
+//                  Prefix header (--pch): shared include library is compiled once, stages only parse the functions
+//                  of it that they use
 //
 #define _ALLOW_KEYWORD_MACROS
 
@@ -16,13 +28,20 @@
 #include "sx/array.h"
 #include "sx/os.h"
 #include "sx/io.h"
+#include "sx/jobs.h"
+#include "sx/atomic.h"
+#include "sx/hash.h"
+#include "sx/timer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 
 #include <string>
+#include <thread>
+#include <unordered_set>
 
 #include "ShaderLang.h"
+#include "glslang/Include/PoolAlloc.h"
 #include "SPIRV/SpvTools.h"
 #include "SPIRV/GlslangToSpv.h"
 #include "SPIRV/disassemble.h"
@@ -35,6 +54,16 @@
 
 #include "config.h"
 #include "sgs-file.h"
+#include "shader-cache.h"
+#include "compile-server.h"
+#include "glslcc.h"
+#include "include-cache.h"
+#include "sgv-file.h"
+#include "file-watcher.h"
+#include "prefix-header.h"
+#include "pool-pages.h"
+#include "compile-stats.h"
+#include "compile-trace.h"
 
 // sjson
 #define sjson_malloc(user, size)        sx_malloc((const sx_alloc*)user, size)
@@ -47,11 +76,13 @@
 #include "../3rdparty/sjson/sjson.h"
 
 #define VERSION_MAJOR  1
-#define VERSION_MINOR  2
+#define VERSION_MINOR  3
 #define VERSION_SUB    0
 
 static const sx_alloc* g_alloc = sx_alloc_malloc;
-static sgs_file* g_sgs         = nullptr;
+
+// Stack size of each compile job, glslang's parser and spirv-cross are heavy on recursion
+static const int k_fiber_stack_size = 4*1024*1024;
 
 struct p_define
 {
@@ -73,6 +104,22 @@ static const char* k_shader_types[SHADER_LANG_COUNT] = {
     "metal"
 };
 
+// Trace event names of SPIRV-Cross backends (--trace)
+static const char* k_trace_cross_names[SHADER_LANG_COUNT] = {
+    "cross gles",
+    "cross hlsl",
+    "cross metal"
+};
+
+// Maximum number of target languages that can be generated from a single compilation (--lang=gles:300,hlsl:50,...)
+static const int k_max_targets = 8;
+
+struct shader_target
+{
+    shader_lang lang;
+    int         profile_ver;    // 0: default for the language (or --profile)
+};
+
 enum vertex_attribs
 {
     VERTEX_POSITION = 0,
@@ -117,7 +164,7 @@ static const char* k_attrib_names[VERTEX_ATTRIB_COUNT] = {
     "BLENDWEIGHT"
 };
 
-static int k_attrib_sem_indices[VERTEX_ATTRIB_COUNT] = {
+static const int k_attrib_sem_indices[VERTEX_ATTRIB_COUNT] = {
     0,
     0,
     0,
@@ -148,15 +195,28 @@ public:
                                  const char* includerName, 
                                  size_t inclusionDepth) override
     { 
+        compile_stats_scope stats_scope(nullptr, COMPILE_STATS_INCLUDE);
+        compile_trace_scope trace_scope("include", headerName);
+        IncludeResult* result = includeCallback(headerName, includerName, false);
+        if (result)
+            return result;
+
         for (auto i = m_systemDirs.begin(); i != m_systemDirs.end(); ++i) {
             std::string header_path(*i);    
             if (header_path.back() != '/')
                 header_path += "/";
             header_path += headerName;
 
-            if (sx_os_stat(header_path.c_str()).type == SX_FILE_TYPE_REGULAR) {
+            if (m_pchText && isPrefixHeader(header_path)) {
+                return includePrefixHeader(header_path);
+            } else if (m_cache) {
+                result = includeCached(header_path);
+                if (result)
+                    return result;
+            } else if (sx_os_stat(header_path.c_str()).type == SX_FILE_TYPE_REGULAR) {
                 sx_mem_block* mem = sx_file_load_bin(g_alloc, header_path.c_str());
                 if (mem)  {
+                    m_includes.push_back(header_path);
                     return new(sx_malloc(g_alloc, sizeof(IncludeResult))) 
                         IncludeResult(header_path, (const char*)mem->data, (size_t)mem->size, mem);
                 }
@@ -169,6 +229,12 @@ public:
                                 const char* includerName,
                                 size_t inclusionDepth) override 
     { 
+        compile_stats_scope stats_scope(nullptr, COMPILE_STATS_INCLUDE);
+        compile_trace_scope trace_scope("include", headerName);
+        IncludeResult* result = includeCallback(headerName, includerName, true);
+        if (result)
+            return result;
+
         char cur_dir[256];
         sx_os_path_pwd(cur_dir, sizeof(cur_dir));
         std::string header_path(cur_dir);
@@ -177,8 +243,14 @@ public:
             header_path += "/";
         header_path += headerName;
 
+        if (m_pchText && isPrefixHeader(header_path))
+            return includePrefixHeader(header_path);
+        if (m_cache)
+            return includeCached(header_path);
+
         sx_mem_block* mem = sx_file_load_bin(g_alloc, header_path.c_str());
         if (mem)  {
+            m_includes.push_back(header_path);
             return new(sx_malloc(g_alloc, sizeof(IncludeResult))) 
                 IncludeResult(header_path, (const char*)mem->data, (size_t)mem->size, mem);
         } 
@@ -205,8 +277,105 @@ public:
         m_systemDirs.push_back(std_dir);
     }
 
+    // Callback is tried before searching the directories (libglslcc)
+    void setCallback(glslcc_include_cb* callback, void* user)
+    {
+        m_callback = callback;
+        m_callbackUser = user;
+    }
+
+    // Files are loaded through the cache and shared between compilations (--variants)
+    void setCache(include_cache* cache)
+    {
+        m_cache = cache;
+    }
+
+    include_cache* getCache() const
+    {
+        return m_cache;
+    }
+
+    // Prefix header (--pch), 'filepath' is absolute
+    void setPrefixHeader(prefix_header_cache* cache, const char* filepath)
+    {
+        m_pch = cache;
+        m_pchPath = filepath;
+    }
+
+    prefix_header_cache* getPrefixHeaderCache() const
+    {
+        return m_pch;
+    }
+
+    // Includes of the prefix header return 'text' instead of the file (reduced header), NULL includes the file
+    void setPrefixHeaderText(const std::string* text)
+    {
+        m_pchText = text;
+    }
+
+    bool isPrefixHeader(const std::string& header_path) const
+    {
+        if (m_pchPath.empty() || sx_os_stat(header_path.c_str()).type != SX_FILE_TYPE_REGULAR)
+            return false;
+        char path[512];
+        sx_os_path_abspath(path, sizeof(path), header_path.c_str());
+        return m_pchPath == path;
+    }
+
+    // Resolves the include like the preprocessor does, "local" includes fall back to system directories
+    IncludeResult* resolve(const char* headerName, const char* includerName, bool local)
+    {
+        IncludeResult* result = local ? includeLocal(headerName, includerName, 1) : nullptr;
+        return result ? result : includeSystem(headerName, includerName, 1);
+    }
+
+    // Files that are resolved from disk by this includer (--depfile), in the order they are included
+    // Every stage uses it's own copy of the includer, so it's not shared between threads
+    const std::vector<std::string>& getIncludes() const
+    {
+        return m_includes;
+    }
+
 private:
+    // Memory is owned by the cache, so it's not passed as userData to be released
+    IncludeResult* includeCached(const std::string& header_path)
+    {
+        const sx_mem_block* mem = include_cache_load(m_cache, header_path.c_str());
+        if (mem) {
+            m_includes.push_back(header_path);
+            return new(sx_malloc(g_alloc, sizeof(IncludeResult))) 
+                IncludeResult(header_path, (const char*)mem->data, (size_t)mem->size, nullptr);
+        }
+        return nullptr;
+    }
+
+    IncludeResult* includePrefixHeader(const std::string& header_path)
+    {
+        m_includes.push_back(header_path);
+        return new(sx_malloc(g_alloc, sizeof(IncludeResult))) 
+            IncludeResult(header_path, m_pchText->c_str(), m_pchText->size(), nullptr);
+    }
+
+    IncludeResult* includeCallback(const char* headerName, const char* includerName, bool local)
+    {
+        if (!m_callback)
+            return nullptr;
+        sx_mem_block* mem = m_callback(headerName, includerName, local, m_callbackUser);
+        if (mem) {
+            return new(sx_malloc(g_alloc, sizeof(IncludeResult))) 
+                IncludeResult(headerName, (const char*)mem->data, (size_t)mem->size, mem);
+        }
+        return nullptr;
+    }
+
     std::vector<std::string> m_systemDirs;
+    glslcc_include_cb*       m_callback = nullptr;
+    void*                    m_callbackUser = nullptr;
+    std::vector<std::string> m_includes;
+    include_cache*           m_cache = nullptr;
+    prefix_header_cache*     m_pch = nullptr;
+    std::string              m_pchPath;
+    const std::string*       m_pchText = nullptr;
 };
 
 struct cmd_args 
@@ -215,10 +384,11 @@ struct cmd_args
     const char* fs_filepath;
     const char* cs_filepath;
     const char* out_filepath;
-    shader_lang lang;
+    shader_target targets[k_max_targets];
+    int         num_targets;
     p_define*   defines;
     Includer    includer;
-    int         profile_ver;
+    int         profile_ver;    // default profile version for targets that don't have one
     int         invert_y;
     int         preprocess;
     int         flatten_ubos;
@@ -226,6 +396,25 @@ struct cmd_args
     int         reflect;
     const char* cvar;
     const char* reflect_filepath;
+    shader_cache* cache;        // NULL if --cache-dir is not set
+    const char* variants_filepath;  // permutation spec (--variants), output is a variant archive
+    int         depfile;
+    const char* depfile_filepath;   // NULL: every output gets it's own dependency file (<output>.d)
+    std::vector<std::string>* deps; // if set, input and included files of the program are gathered here (--watch)
+    compile_stats_report* stats;    // NULL if --stats is not set
+};
+
+// Target language of a program and where its outputs are written
+// With multiple targets, every target gets its own output files, see 'setup_targets'
+struct compile_target
+{
+    shader_lang lang;
+    int         profile_ver;
+    std::string out_filepath;
+    std::string reflect_filepath;   // empty if --reflect doesn't have a filepath
+    std::string cvar;               // empty if --cvar is not set
+    sgs_file*   sgs;
+    sgv_file*   sgv;                // variant archive (--variants), stages are added by 'compile_variants'
 };
 
 static void print_version()
@@ -236,7 +425,7 @@ static void print_version()
 
 static void print_help(sx_cmdline_context* ctx)
 {
-    char buffer[4096];
+    char buffer[8192];
     print_version();
     puts("");
     puts(sx_cmdline_create_help_string(ctx, buffer, sizeof(buffer)));
@@ -244,9 +433,9 @@ static void print_help(sx_cmdline_context* ctx)
          "\t- Vertex shader (--vert)\n"
          "\t- Fragment shader (--frag)\n"
          "\t- Compute shader (--comp)\n");
-    exit(0);
 }
 
+// returns SHADER_LANG_COUNT if the language is invalid
 static shader_lang parse_shader_lang(const char* arg) 
 {
     for (int i = 0; i < SHADER_LANG_COUNT; i++) {
@@ -255,8 +444,52 @@ static shader_lang parse_shader_lang(const char* arg)
         }
     }
 
-    puts("Invalid shader type");
-    exit(-1);
+    return SHADER_LANG_COUNT;
+}
+
+// Parses target languages, seperated by comma, each one can have an optional profile version
+// Example: "gles:300,hlsl:50,metal"
+static bool parse_targets(cmd_args* args, const char* langs)
+{
+    args->num_targets = 0;
+    const char* lang = langs;
+    while (lang) {
+        lang = sx_skip_whitespace(lang);
+        const char* next_lang = sx_strchar(lang, ',');
+        int len = next_lang ? (int)(uintptr_t)(next_lang - lang) : sx_strlen(lang);
+
+        if (len > 0) {
+            char name[32];
+            sx_strncpy(name, sizeof(name), lang, len);
+            sx_trim_whitespace(name, sizeof(name), name);
+
+            shader_target target = {SHADER_LANG_COUNT, 0};
+            char* colon = (char*)sx_strchar(name, ':');
+            if (colon) {
+                *colon = 0;
+                target.profile_ver = sx_toint(colon + 1);
+            }
+            target.lang = parse_shader_lang(name);
+
+            if (target.lang == SHADER_LANG_COUNT) {
+                printf("Invalid shader type: %s\n", name);
+                return false;
+            }
+            if (args->num_targets == k_max_targets) {
+                printf("Too many shader languages, maximum is %d\n", k_max_targets);
+                return false;
+            }
+            args->targets[args->num_targets++] = target;
+        }
+
+        lang = next_lang ? next_lang + 1 : nullptr;
+    }
+
+    if (args->num_targets == 0) {
+        puts("Shader language is not specified");
+        return false;
+    }
+    return true;
 }
 
 static void parse_defines(cmd_args* args, const char* defines)
@@ -482,7 +715,7 @@ static void output_resource_info(sjson_context* jctx, sjson_node* jparent,
 	}
 }
 
-static void output_reflection(const cmd_args& args, const spirv_cross::Compiler& compiler, 
+static void output_reflection(const compile_target& target, const spirv_cross::Compiler& compiler, 
                               const spirv_cross::ShaderResources& ress, 
                               const char* filename,
                               EShLanguage stage, std::string* reflect_json, bool pretty = false)
@@ -491,8 +724,8 @@ static void output_reflection(const cmd_args& args, const spirv_cross::Compiler&
     sx_assert(jctx);
 
     sjson_node* jroot = sjson_mkobject(jctx);
-    sjson_put_string(jctx, jroot, "language", k_shader_types[args.lang]);
-    sjson_put_int(jctx, jroot, "profile_version", args.profile_ver);
+    sjson_put_string(jctx, jroot, "language", k_shader_types[target.lang]);
+    sjson_put_int(jctx, jroot, "profile_version", target.profile_ver);
 
     sjson_node* jshader = sjson_put_obj(jctx, jroot, get_stage_name(stage));
     sjson_put_string(jctx, jshader, "file", filename);
@@ -531,6 +764,12 @@ static void output_reflection(const cmd_args& args, const spirv_cross::Compiler&
     sjson_destroy_context(jctx);
 }
 
+static void add_unique_path(std::vector<std::string>* paths, const std::string& path)
+{
+    if (std::find(paths->begin(), paths->end(), path) == paths->end())
+        paths->push_back(path);
+}
+
 // if binary_size > 0, then we assume the data is binary
 static bool write_file(const char* filepath, const char* data, const char* cvar, 
                             bool append = false, int binary_size = -1)
@@ -594,36 +833,106 @@ static bool write_file(const char* filepath, const char* data, const char* cvar,
     return true;
 }
 
-static int cross_compile(const cmd_args& args, std::vector<uint32_t>& spirv, 
-                         const char* filename, EShLanguage stage, int file_index)
+// Output files are written to temp files first, and moved over the outputs after all files of the program are 
+// written, so tools that reload the outputs (--watch, hot-reloading engines) never see partially written files
+static std::string make_temp_filepath(const std::string& filepath)
+{
+    return filepath + ".tmp";
+}
+
+// Writes to the temp file of 'filepath', and adds 'filepath' to 'written_files' for 'commit_output_files'
+static bool write_output_file(const std::string& filepath, const char* data, const char* cvar, bool append, 
+                              std::vector<std::string>* written_files)
+{
+    add_unique_path(written_files, filepath);
+    return write_file(make_temp_filepath(filepath).c_str(), data, cvar, append);
+}
+
+// Moves temp files over the outputs, or deletes them if 'success' is false
+static bool commit_output_files(const std::vector<std::string>& written_files, bool success)
+{
+    bool r = true;
+    for (const std::string& filepath : written_files) {
+        std::string temp_filepath = make_temp_filepath(filepath);
+        if (success && !sx_os_rename(temp_filepath.c_str(), filepath.c_str())) {
+            printf("Writing to '%s' failed\n", filepath.c_str());
+            success = r = false;
+        }
+        if (!success)
+            sx_os_del(temp_filepath.c_str());
+    }
+    return r;
+}
+
+// Output of a single compiled stage for one of the targets
+// Stages are cross-compiled in parallel, but outputs are written in order after all of them are done
+struct compile_stage_output
+{
+    std::string code;
+    std::string reflect_json;
+    std::string filepath;       // code file (empty for SGS)
+    std::string cvar;           // variable name in C header (empty if --cvar is not set)
+    std::string log;
+    int         result          = 0;
+    uint64_t    cache_key       = 0;        // 0 if the stage can't be cached
+    bool        cached          = false;    // loaded from cache, so cross-compiling is skipped
+    compile_stats stats         = {};       // targets are cross-compiled in parallel, added to the stage at the end
+};
+
+// Determines output file and C variable name of the stage
+static void get_stage_output_path(const compile_target& target, EShLanguage stage, compile_stage_output* output)
+{
+    // in-memory compilation (libglslcc) doesn't have output files
+    if (target.out_filepath.empty())
+        return;
+
+    output->cvar = target.cvar;
+    if (!output->cvar.empty()) {
+        output->cvar += "_";
+        output->cvar += get_stage_name(stage);
+        output->filepath = target.out_filepath;
+    } else {
+        char ext[32];
+        char basename[512];
+        sx_os_path_splitext(ext, sizeof(ext), basename, sizeof(basename), target.out_filepath.c_str());
+        output->filepath = std::string(basename) + std::string("_") + std::string(get_stage_name(stage)) + std::string(ext);
+    }
+}
+
+// 'ir' is the SPIR-V of the stage that is parsed once by 'spirv_stage_job', see 'get_cross_ir'
+static int cross_compile(const cmd_args& args, const compile_target& target, spirv_cross::Compiler::ParsedIR ir, 
+                         EShLanguage stage, compile_stage_output* output, std::string* log)
 {
-    sx_assert(!spirv.empty());
     // Using SPIRV-cross
 
     try {
         std::unique_ptr<spirv_cross::CompilerGLSL> compiler;
         // Use spirv-cross to convert to other types of shader
-        if (args.lang == SHADER_LANG_GLES) {
-            compiler = std::unique_ptr<spirv_cross::CompilerGLSL>(new spirv_cross::CompilerGLSL(spirv));
-        } else if (args.lang == SHADER_LANG_METAL) {
-            compiler = std::unique_ptr<spirv_cross::CompilerMSL>(new spirv_cross::CompilerMSL(spirv));
-        } else if (args.lang == SHADER_LANG_HLSL) {
-            compiler = std::unique_ptr<spirv_cross::CompilerHLSL>(new spirv_cross::CompilerHLSL(spirv));
-        } else {
-            sx_assert(0 && "Language not implemented");
+        {
+            compile_stats_scope stats_scope(&output->stats, COMPILE_STATS_CROSS_PARSE);
+            if (target.lang == SHADER_LANG_GLES) {
+                compiler = std::unique_ptr<spirv_cross::CompilerGLSL>(new spirv_cross::CompilerGLSL(std::move(ir)));
+            } else if (target.lang == SHADER_LANG_METAL) {
+                compiler = std::unique_ptr<spirv_cross::CompilerMSL>(new spirv_cross::CompilerMSL(std::move(ir)));
+            } else if (target.lang == SHADER_LANG_HLSL) {
+                compiler = std::unique_ptr<spirv_cross::CompilerHLSL>(new spirv_cross::CompilerHLSL(std::move(ir)));
+            } else {
+                sx_assert(0 && "Language not implemented");
+            }
         }
 
+        compile_stats_scope stats_scope(&output->stats, COMPILE_STATS_CROSS_COMPILE);
         spirv_cross::ShaderResources ress = compiler->get_shader_resources();
 
         spirv_cross::CompilerGLSL::Options opts = compiler->get_common_options();
-        if (args.lang == SHADER_LANG_GLES) {
+        if (target.lang == SHADER_LANG_GLES) {
             opts.es = true;
-            opts.version = args.profile_ver;
-        } else if (args.lang == SHADER_LANG_HLSL) {
+            opts.version = target.profile_ver;
+        } else if (target.lang == SHADER_LANG_HLSL) {
             spirv_cross::CompilerHLSL* hlsl = (spirv_cross::CompilerHLSL*)compiler.get();
             spirv_cross::CompilerHLSL::Options hlsl_opts = hlsl->get_hlsl_options();
 
-            hlsl_opts.shader_model = args.profile_ver;
+            hlsl_opts.shader_model = target.profile_ver;
             hlsl_opts.point_size_compat = true;
             hlsl_opts.point_coord_compat = true;
 
@@ -649,87 +958,129 @@ static int cross_compile(const cmd_args& args, std::vector<uint32_t>& spirv,
 
         compiler->set_common_options(opts);
 
-        std::string code;
         // Prepare vertex attribute remap for HLSL
-        if (args.lang == SHADER_LANG_HLSL) {
+        if (target.lang == SHADER_LANG_HLSL) {
             std::vector<spirv_cross::HLSLVertexAttributeRemap> remaps;
             for (int i = 0; i < VERTEX_ATTRIB_COUNT; i++) {
                 spirv_cross::HLSLVertexAttributeRemap remap = {(uint32_t)i , k_attrib_names[i]};
                 remaps.push_back(std::move(remap));
             }
 
-            code = ((spirv_cross::CompilerHLSL*)compiler.get())->compile(std::move(remaps));
+            output->code = ((spirv_cross::CompilerHLSL*)compiler.get())->compile(std::move(remaps));
         } else {
-            code = compiler->compile();
-        }
-
-        // Output code
-        if (g_sgs) {
-            sgs_shader_stage sstage;
-            switch (stage) {
-            case EShLangVertex:         sstage = SGS_STAGE_VERTEX;      break;
-            case EShLangFragment:       sstage = SGS_STAGE_FRAGMENT;    break;
-            case EShLangCompute:        sstage = SGS_STAGE_COMPUTE;     break;
-            }    
-            sgs_add_stage_code(g_sgs, sstage, code.c_str());
-
-            std::string json_str;
-            output_reflection(args, *compiler, ress, args.out_filepath, stage, &json_str);
-            sgs_add_stage_reflect(g_sgs, sstage, json_str.c_str());
+            output->code = compiler->compile();
+        }
+        ++output->stats.cross_compiles;
+        output->stats.cross_passes += (int)compiler->get_compile_pass_count();
+
+        // Reflection
+        compile_stats_scope reflect_scope(&output->stats, COMPILE_STATS_REFLECT);
+        compile_trace_scope reflect_trace("reflect", target.out_filepath.c_str());
+        if (target.sgs || target.sgv) {
+            output_reflection(target, *compiler, ress, target.out_filepath.c_str(), stage, &output->reflect_json);
         } else {
-            std::string cvar_code = args.cvar ? args.cvar : "";
-            std::string filepath; 
-            if (!cvar_code.empty()) {
-                cvar_code += "_";
-                cvar_code += get_stage_name(stage);
-                filepath = args.out_filepath;
-            } else {
-                char ext[32];
-                char basename[512];
-                sx_os_path_splitext(ext, sizeof(ext), basename, sizeof(basename), args.out_filepath);
-                filepath = std::string(basename) + std::string("_") + std::string(get_stage_name(stage)) + std::string(ext);
+            get_stage_output_path(target, stage, output);
+            if (args.reflect) {
+                output_reflection(target, *compiler, ress, output->filepath.c_str(), stage, &output->reflect_json,
+                                  output->cvar.empty());
             }
-            bool append = !cvar_code.empty() & (file_index > 0);
+        }
+
+        return 0;
+    } catch (const std::exception& e) {
+        *log += "SPIRV-cross: ";
+        *log += e.what();
+        *log += "\n";
+        return -1;
+    }
+}
 
-            // output code file
-            if (!write_file(filepath.c_str(), code.c_str(), cvar_code.c_str(), append)) {
-                printf("Writing to '%s' failed", filepath.c_str());
+// Reflection file of the stage output (--reflect)
+// if --reflect is defined, we just output to that file
+// if --reflect is not defined, check cvar (.C file), and if set, output to the same file (out_filepath)
+// if --reflect is not defined and there is no cvar, output to out_filepath.json
+static std::string get_reflect_filepath(const compile_target& target, const compile_stage_output& output)
+{
+    if (!target.reflect_filepath.empty())
+        return target.reflect_filepath;
+    else if (!output.cvar.empty())
+        return output.filepath;
+    else
+        return output.filepath + ".json";
+}
+
+static int write_stage_output(const cmd_args& args, const compile_target& target, 
+                              const compile_stage_output& output, EShLanguage stage, int file_index,
+                              std::vector<std::string>* written_files)
+{
+    if (target.sgs) {
+        sgs_shader_stage sstage;
+        switch (stage) {
+        case EShLangVertex:         sstage = SGS_STAGE_VERTEX;      break;
+        case EShLangFragment:       sstage = SGS_STAGE_FRAGMENT;    break;
+        case EShLangCompute:        sstage = SGS_STAGE_COMPUTE;     break;
+        default:                    sstage = SGS_STAGE_COUNT;       break;
+        }    
+        sgs_add_stage_code(target.sgs, sstage, output.code.c_str());
+        sgs_add_stage_reflect(target.sgs, sstage, output.reflect_json.c_str());
+    } else {
+        const std::string& filepath = output.filepath;
+        const std::string& cvar_code = output.cvar;
+        bool append = !cvar_code.empty() & (file_index > 0);
+
+        // output code file
+        if (!write_output_file(filepath, output.code.c_str(), cvar_code.c_str(), append, written_files)) {
+            printf("Writing to '%s' failed", filepath.c_str());
+            return -1;
+        }
+
+        if (args.reflect) {
+            // output json reflection file
+            std::string reflect_filepath = get_reflect_filepath(target, output);
+            if (target.reflect_filepath.empty() && !cvar_code.empty())
+                append = true;
+
+            std::string cvar_refl = !cvar_code.empty() ? (cvar_code + "_refl") : "";
+            if (!write_output_file(reflect_filepath, output.reflect_json.c_str(), cvar_refl.c_str(), append, 
+                                   written_files)) 
+            {
+                printf("Writing to '%s' failed", reflect_filepath.c_str());
                 return -1;
             }
+        }
+    }
 
-            if (args.reflect) {
-                // output json reflection file
-                // if --reflect is defined, we just output to that file
-                // if --reflect is not defined, check cvar (.C file), and if set, output to the same file (out_filepath)
-                // if --reflect is not defined and there is no cvar, output to out_filepath.json
-                std::string json_str;
-
-                output_reflection(args, *compiler, ress, filepath.c_str(), stage, &json_str, cvar_code.empty());
-
-                std::string reflect_filepath;
-                if (args.reflect_filepath) {
-                    reflect_filepath = args.reflect_filepath;
-                } else if (!cvar_code.empty()) {
-                    reflect_filepath = filepath;
-                    append = true;
-                } else {
-                    reflect_filepath = filepath;
-                    reflect_filepath += ".json";
-                }
+    return 0;
+}
 
-                std::string cvar_refl = !cvar_code.empty() ? (cvar_code + "_refl") : "";
-                if (!write_file(reflect_filepath.c_str(), json_str.c_str(), cvar_refl.c_str(), append)) {
-                    printf("Writing to '%s' failed", reflect_filepath.c_str());
-                    return -1;
-                }
-            }
+// glslang keeps the current pool allocator in thread-local storage, and TShader/TProgram set it to their own
+// pools which are freed with the program. So before running GlslangToSpv on a worker thread, we switch to 
+// a pool that is owned by the thread itself
+static glslang::TPoolAllocator* get_thread_pool()
+{
+    static thread_local std::unique_ptr<glslang::TPoolAllocator> pool;
+    if (!pool)
+        pool.reset(new glslang::TPoolAllocator());
+    return pool.get();
+}
+
+// Runs the callback for each index in worker threads if the job context is available
+// Otherwise, runs them serially in the current thread
+static void run_jobs(sx_job_context* jobs, sx_job_cb* callback, void* user, int count)
+{
+    if (jobs && count > 1) {
+        sx_job_desc* descs = (sx_job_desc*)sx_malloc(g_alloc, sizeof(sx_job_desc)*count);
+        sx_assert(descs);
+        for (int i = 0; i < count; i++) {
+            descs[i].callback = callback;
+            descs[i].user = user;
+            descs[i].priority = SX_JOB_PRIORITY_NORMAL;
         }
-        
-        puts(filename); // SUCCESS
-        return 0;
-    } catch (const std::exception& e) {
-        printf("SPIRV-cross: %s\n", e.what());
-        return -1;
+        sx_job_wait_del(jobs, sx_job_dispatch(jobs, descs, count));
+        sx_free(g_alloc, descs);
+    } else {
+        for (int i = 0; i < count; i++)
+            callback(i, user);
     }
 }
 
@@ -739,300 +1090,2258 @@ struct compile_file_desc
     const char* filename;
 };
 
-#define compile_files_ret(_code)        \
-        destroy_shaders(shaders);       \
-        sx_array_free(g_alloc, files);  \
-        prog->~TProgram();              \
-        sx_free(g_alloc, prog);         \
-        glslang::FinalizeProcess();     \
-        return _code;                   
+// Per-stage compilation state, shared between the parse and cross-compile jobs of a program
+struct compile_stage
+{
+    const cmd_args*         args            = nullptr;
+    const TBuiltInResource* limits_conf     = nullptr;
+    compile_file_desc       file            = {};
+    glslang::TShader*       shader          = nullptr;
+    glslang::TProgram*      prog            = nullptr;
+    sx_mem_block*           source          = nullptr;
+    const char*             source_str      = nullptr;  // glslang keeps pointers to these until parsed
+    int                     source_len      = 0;
+    uint64_t                source_hash     = 0;        // hash of preprocessed source, 0 if preprocessing failed
+    std::string             preamble;
+    std::string             prep_str;       // preprocess mode output
+    std::vector<std::string> includes;      // included files, for dependency files (--depfile)
+    std::string             log;            // errors/warnings are printed after all stages are done
+    std::vector<uint32_t>   spirv;          // generated once, and cross-compiled to every target
+    std::unique_ptr<spirv_cross::Compiler::ParsedIR> cross_ir;   // spirv parsed once for all targets
+    sx_atomic_int           cross_ir_users  = 0;        // targets that haven't got their copy of cross_ir yet
+    sx_atomic_int           cross_ir_copies = 0;        // targets that are copying cross_ir right now
+    compile_stage_output    outputs[k_max_targets];
+    int                     num_targets     = 0;
+    int                     num_cached      = 0;        // number of outputs that are loaded from cache
+    int                     result          = 0;
+    compile_stats           stats           = {};       // --stats
+};
 
-static int compile_files(cmd_args& args, const TBuiltInResource& limits_conf)
+struct cross_compile_context
 {
-    auto destroy_shaders = [](glslang::TShader**& shaders) {
-        for (int i = 0; i < sx_array_count(shaders); i++) {
-            if (shaders[i]) {
-                shaders[i]->~TShader();
-                sx_free(g_alloc, shaders[i]);
-            }
-        }
-        sx_array_free(g_alloc, shaders);
-    };
+    compile_stage*          stages;
+    const compile_target*   targets;
+    int                     num_targets;
+};
 
-    glslang::InitializeProcess();
+// TODO: add more options for messaging options
+static const EShMessages k_messages = EShMsgDefault;
+static const int k_default_version = 100; // 110 for desktop
 
-    // Gather files for compilation
-    compile_file_desc* files = nullptr;
-    if (args.vs_filepath) {
-        compile_file_desc d = {EShLangVertex, args.vs_filepath};
-        sx_array_push(g_alloc, files, d);
+// Read target file, the source is kept until the stage is destroyed
+// Sources that are passed in memory (libglslcc) are already set
+static bool load_stage_source(compile_stage* s)
+{
+    if (!s->source_str) {
+        compile_stats_scope stats_scope(&s->stats, COMPILE_STATS_LOAD);
+        compile_trace_scope trace_scope("load", s->file.filename);
+        s->source = sx_file_load_bin(g_alloc, s->file.filename);
+        if (!s->source) {
+            char msg[512];
+            sx_snprintf(msg, sizeof(msg), "opening file '%s' failed\n", s->file.filename);
+            s->log += msg;
+            return false;
+        }
+        s->source_str = (const char*)s->source->data;
+        s->source_len = s->source->size;
     }
+    return true;
+}
 
-    if (args.fs_filepath) {
-        compile_file_desc d = {EShLangFragment, args.fs_filepath};
-        sx_array_push(g_alloc, files, d);
-    }
+// 'preamble' must stay valid until the shader is parsed
+static void setup_shader(glslang::TShader* shader, const compile_stage& s, std::string* preamble)
+{
+    shader->setStringsWithLengthsAndNames(&s.source_str, &s.source_len, &s.file.filename, 1);
+    shader->setInvertY(s.args->invert_y ? true : false);
+    shader->setEnvInput(glslang::EShSourceGlsl, s.file.stage, glslang::EShClientOpenGL, k_default_version);
+    shader->setEnvClient(glslang::EShClientOpenGL, glslang::EShTargetOpenGL_450);
+    shader->setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+    add_defines(shader, *s.args, *preamble);
+}
 
-    if (args.cs_filepath) {
-        compile_file_desc d = {EShLangCompute, args.cs_filepath};
-        sx_array_push(g_alloc, files, d);
+// Preprocesses the stage and hashes the result, which is the base of cache keys for the stage
+// Errors are ignored here, the stage will be compiled normally and report them
+static void hash_stage_job(int index, void* user)
+{
+    compile_stage* s = &((compile_stage*)user)[index];
+    s->source_hash = 0;
+    if (!load_stage_source(s)) {
+        s->log.clear();
+        return;
     }
 
-    glslang::TProgram* prog = new(sx_malloc(g_alloc, sizeof(glslang::TProgram))) glslang::TProgram();
-    glslang::TShader** shaders = nullptr;
-
-    // TODO: add more options for messaging options
-    EShMessages messages = EShMsgDefault;
-    int default_version = 100; // 110 for desktop
-
-    // construct semantics mapping defines
-    // to be used in layout(location = SEMANTIC) inside GLSL
-    std::string semantics_def;
-    for (int i = 0; i < VERTEX_ATTRIB_COUNT; i++) {
-        char sem_line[128];
-        sx_snprintf(sem_line, sizeof(sem_line), "#define %s %d\n", k_attrib_names[i], i);
-        semantics_def += std::string(sem_line);
-    }
+    glslang::SetThreadPoolAllocator(get_thread_pool());
+    glslang::TShader shader(s->file.stage);
+    std::string preamble = s->preamble;
+    std::string prep_str;
+    setup_shader(&shader, *s, &preamble);
+
+    Includer includer(s->args->includer);
+    compile_trace_scope trace_scope("preprocess", s->file.filename);
+    compile_stats_begin(&s->stats, COMPILE_STATS_PREPROCESS);
+    bool r = shader.preprocess(s->limits_conf, k_default_version, ENoProfile, false, false, k_messages, 
+                               &prep_str, includer);
+    compile_stats_end();
+    if (r)
+        s->source_hash = sx_hash_xxh64(prep_str.c_str(), prep_str.size(), s->file.stage);
+    s->includes = includer.getIncludes();
+}
 
-    // Add SV_Target semantics for more HLSL compatibility
-    for (int i = 0; i < 8; i++) {
-        char sv_target_line[128];
-        sx_snprintf(sv_target_line, sizeof(sv_target_line), "#define SV_Target%d %d\n", i, i);
-        semantics_def += std::string(sv_target_line);
+// Adds the references of the included files to the prefix header, recursively
+// Files that are included by the header itself are also added to the key of the header
+static void add_prefix_header_refs(Includer* includer, const prefix_header* h, const char* text, int len,
+                                   const char* filename, bool in_header, std::unordered_set<std::string>* visited,
+                                   std::vector<uint8_t>* used, uint64_t* key)
+{
+    std::vector<prefix_header_include> includes;
+    prefix_header_scan_includes(text, len, &includes);
+    for (const prefix_header_include& inc : includes) {
+        glslang::TShader::Includer::IncludeResult* r = includer->resolve(inc.name.c_str(), filename, inc.local);
+        if (r && visited->insert(r->headerName).second) {
+            if (in_header)
+                *key = sx_hash_xxh64(r->headerData, r->headerLength, *key);
+            prefix_header_add_refs(h, r->headerData, (int)r->headerLength, used);
+            add_prefix_header_refs(includer, h, r->headerData, (int)r->headerLength, r->headerName.c_str(), 
+                                   in_header, visited, used, key);
+        }
+        if (r)
+            includer->releaseInclude(r);
     }
+}
 
-    for (int i = 0; i < sx_array_count(files); i++) {
-        // Always set include_directive in the preamble, because we may need to include shaders
-        std::string def("#extension GL_GOOGLE_include_directive : require\n");
-        def += semantics_def;
+// Prefix header (--pch): if the first include of the stage is the prefix header, the header is compiled once with
+// the prefix of the stage (everything before the include) and the defines. After that, stages with the same prefix
+// and defines get the header without the functions that they don't reach, see prefix-header.h
+// If the header has warnings, stages are compiled with the full header, so their messages don't change
+// Validated headers are also kept in the cache directory (--cache-dir), so they are reused by later runs
+// Returns false if the stage must be compiled with the full header
+static bool reduce_prefix_header(const compile_stage& s, std::string* pch_text)
+{
+    std::vector<prefix_header_include> includes;
+    prefix_header_scan_includes(s.source_str, s.source_len, &includes);
+    if (includes.empty())
+        return false;
 
-        // Read target file
-        sx_mem_block* mem = sx_file_load_bin(g_alloc, files[i].filename);
-        if (!mem) {
-            printf("opening file '%s' failed\n", files[i].filename);
-            compile_files_ret(-1);
-        }
+    // Files are resolved by a separate includer, so they are not added to the dependencies of the stage
+    Includer includer(s.args->includer);
+    const prefix_header_include& first = includes[0];
+    glslang::TShader::Includer::IncludeResult* header = includer.resolve(first.name.c_str(), s.file.filename,
+                                                                         first.local);
+    if (!header)
+        return false;
+    const prefix_header* h = includer.isPrefixHeader(header->headerName) ? 
+        prefix_header_analyze(includer.getPrefixHeaderCache(), header->headerData, (int)header->headerLength) : 
+        nullptr;
+    if (!h) {
+        includer.releaseInclude(header);
+        return false;
+    }
 
-        glslang::TShader* shader = new(sx_malloc(g_alloc, sizeof(glslang::TShader))) glslang::TShader(files[i].stage);
-        sx_assert(shader);
-        sx_array_push(g_alloc, shaders, shader);
-        
-        char* shader_str = (char*)mem->data;
-        int shader_len = (int)mem->size;
-        shader->setStringsWithLengthsAndNames(&shader_str, &shader_len, &files[i].filename, 1);
-        shader->setInvertY(args.invert_y ? true : false);
-        shader->setEnvInput(glslang::EShSourceGlsl, files[i].stage, glslang::EShClientOpenGL, default_version);
-        shader->setEnvClient(glslang::EShClientOpenGL, glslang::EShTargetOpenGL_450);
-        shader->setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
-        add_defines(shader, args, def);
-
-        if (args.preprocess) {
-            std::string prep_str;
-            if (shader->preprocess(&limits_conf, default_version, ENoProfile, false, false, messages, &prep_str,
-                                args.includer)) {
-                puts("-------------------");
-                printf("%s:\n", files[i].filename);
-                puts("-------------------");
-                puts(prep_str.c_str());
-                puts("");
-                sx_mem_destroy_block(mem);
-            } else {
-                const char* info_log = shader->getInfoLog();
-                const char* info_log_dbg = shader->getInfoDebugLog();
-                if (info_log && info_log[0])
-                    fprintf(stderr, "%s\n", info_log);
-                if (info_log_dbg && info_log_dbg[0])
-                    fprintf(stderr, "%s\n", info_log_dbg);
-                sx_mem_destroy_block(mem);
-                compile_files_ret(-1);
-            }
-        } else {
-            if (!shader->parse(&limits_conf, default_version, false, messages, args.includer)) {
-                const char* info_log = shader->getInfoLog();
-                const char* info_log_dbg = shader->getInfoDebugLog();
-                if (info_log && info_log[0])
-                    fprintf(stderr, "%s\n", info_log);
-                if (info_log_dbg && info_log_dbg[0])
-                    fprintf(stderr, "%s\n", info_log_dbg);
-                sx_mem_destroy_block(mem);
-                compile_files_ret(-1);
-            }
+    glslang::TShader shader(s.file.stage);
+    std::string preamble = s.preamble;
+    setup_shader(&shader, s, &preamble);
+
+    uint64_t key = sx_hash_xxh64(header->headerData, header->headerLength, s.file.stage);
+    key = prefix_header_hash_source(s.source_str, first.end, key);
+    key = sx_hash_xxh64(preamble.c_str(), preamble.size(), key);
+
+    std::vector<uint8_t> used;
+    std::unordered_set<std::string> visited = {header->headerName};
+    add_prefix_header_refs(&includer, h, header->headerData, (int)header->headerLength, 
+                           header->headerName.c_str(), true, &visited, &used, &key);
+    prefix_header_add_refs(h, s.source_str, s.source_len, &used);
+    add_prefix_header_refs(&includer, h, s.source_str, s.source_len, s.file.filename, false, &visited, &used,
+                           &key);
+    includer.releaseInclude(header);
+
+    prefix_header_cache* pch = includer.getPrefixHeaderCache();
+    prefix_header_state state = prefix_header_get_state(pch, key);
+    if (state == PREFIX_HEADER_STATE_UNKNOWN && s.args->cache) {
+        std::string code, reflect;
+        if (shader_cache_load(s.args->cache, key, &code, &reflect))
+            state = code == "valid" ? PREFIX_HEADER_STATE_VALID : PREFIX_HEADER_STATE_WARNINGS;
+    }
 
-            prog->addShader(shader);
+    if (state == PREFIX_HEADER_STATE_UNKNOWN) {
+        const char* prefix_str = s.source_str;
+        int prefix_len = first.end;
+        shader.setStringsWithLengthsAndNames(&prefix_str, &prefix_len, &s.file.filename, 1);
+        Includer full_includer(s.args->includer);
+        bool r = shader.parse(s.limits_conf, k_default_version, false, k_messages, full_includer);
+
+        // Warnings of the blanked functions would be lost with the reduced header, so the stages keep the full one
+        const char* info_log = shader.getInfoLog();
+        if (!r)
+            state = PREFIX_HEADER_STATE_INVALID;
+        else if (info_log && info_log[0])
+            state = PREFIX_HEADER_STATE_WARNINGS;
+        else
+            state = PREFIX_HEADER_STATE_VALID;
+        if (r && s.args->cache) {
+            shader_cache_store(s.args->cache, key, state == PREFIX_HEADER_STATE_VALID ? "valid" : "warnings", 
+                               std::string());
         }
+    }
+    prefix_header_set_state(pch, key, state);
 
-        sx_mem_destroy_block(mem);
-    }   // foreach (file)
+    return state == PREFIX_HEADER_STATE_VALID && prefix_header_reduce(h, used, pch_text) > 0;
+}
 
-    // In preprocess mode, do not link, just exit
+static void parse_stage_job(int index, void* user)
+{
+    compile_stage* s = &((compile_stage*)user)[index];
+    const cmd_args& args = *s->args;
+    s->result = -1;
+
+    if (!load_stage_source(s))
+        return;
+
+    glslang::SetThreadPoolAllocator(get_thread_pool());
+    std::string pch_text;
+    compile_stats_begin(&s->stats, COMPILE_STATS_PARSE);
+    bool pch = !args.preprocess && args.includer.getPrefixHeaderCache() && reduce_prefix_header(*s, &pch_text);
+    compile_stats_end();
+    std::string preamble = s->preamble;
+
+    glslang::TShader* shader = new(sx_malloc(g_alloc, sizeof(glslang::TShader))) glslang::TShader(s->file.stage);
+    sx_assert(shader);
+    s->shader = shader;
+    setup_shader(shader, *s, &s->preamble);
+
+    bool r;
+    Includer includer(args.includer);
     if (args.preprocess) {
-        compile_files_ret(0);
+        compile_stats_scope stats_scope(&s->stats, COMPILE_STATS_PREPROCESS);
+        compile_trace_scope trace_scope("preprocess", s->file.filename);
+        r = shader->preprocess(s->limits_conf, k_default_version, ENoProfile, false, false, k_messages, 
+                               &s->prep_str, includer);
+    } else {
+        compile_stats_scope stats_scope(&s->stats, COMPILE_STATS_PARSE);
+        compile_trace_scope trace_scope("parse", s->file.filename);
+        includer.setPrefixHeaderText(pch ? &pch_text : nullptr);
+        r = shader->parse(s->limits_conf, k_default_version, false, k_messages, includer);
+
+        // Reduced prefix header may miss functions that are only referenced through macros, the stage is compiled
+        // again with the full header, which also reports the errors of the stage itself
+        if (!r && pch) {
+            shader->~TShader();
+            shader = new(shader) glslang::TShader(s->file.stage);
+            s->preamble = preamble;
+            setup_shader(shader, *s, &s->preamble);
+            includer = Includer(args.includer);
+            r = shader->parse(s->limits_conf, k_default_version, false, k_messages, includer);
+        }
     }
-
-    if (!prog->link(messages)) {
-        puts("Link failed: ");
-        fprintf(stderr, "%s\n", prog->getInfoLog());
-        fprintf(stderr, "%s\n", prog->getInfoDebugLog());
-        compile_files_ret(-1);
+    s->includes = includer.getIncludes();
+
+    if (!r) {
+        const char* info_log = shader->getInfoLog();
+        const char* info_log_dbg = shader->getInfoDebugLog();
+        if (info_log && info_log[0]) {
+            s->log += info_log;
+            s->log += "\n";
+        }
+        if (info_log_dbg && info_log_dbg[0]) {
+            s->log += info_log_dbg;
+            s->log += "\n";
+        }
     }
 
-    // Output and save SPIR-V for each shader
-    for (int i = 0; i < sx_array_count(files); i++) {
-        std::vector<uint32_t> spirv;
+    s->result = r ? 0 : -1;
+}
 
-        glslang::SpvOptions spv_opts;
-        spv_opts.validate = true;
-        spv::SpvBuildLogger logger;
-        sx_assert(prog->getIntermediate(files[i].stage));
+static void spirv_stage_job(int index, void* user)
+{
+    compile_stage* s = &((compile_stage*)user)[index];
+    s->result = 0;
+    if (s->num_cached == s->num_targets)
+        return;
 
-        glslang::GlslangToSpv(*prog->getIntermediate(files[i].stage), spirv, &logger, &spv_opts);
-        if (!logger.getAllMessages().empty())
-            puts(logger.getAllMessages().c_str());
+    glslang::SpvOptions spv_opts;
+    spv_opts.validate = true;
+    spv::SpvBuildLogger logger;
+    sx_assert(s->prog->getIntermediate(s->file.stage));
 
-        if (cross_compile(args, spirv, files[i].filename, files[i].stage, i) != 0) {
-            compile_files_ret(-1);
-        }
+    glslang::SetThreadPoolAllocator(get_thread_pool());
+    {
+        compile_stats_scope stats_scope(&s->stats, COMPILE_STATS_SPIRV);
+        compile_trace_scope trace_scope("spirv", s->file.filename);
+        glslang::GlslangToSpv(*s->prog->getIntermediate(s->file.stage), s->spirv, &logger, &spv_opts);
+    }
+    if (!logger.getAllMessages().empty()) {
+        s->log += logger.getAllMessages();
+        s->log += "\n";
     }
 
-    destroy_shaders(shaders);
-    prog->~TProgram();
-    sx_free(g_alloc, prog);
+    if (s->spirv.empty()) {
+        s->result = -1;
+        return;
+    }
 
-    glslang::FinalizeProcess();
-    sx_array_free(g_alloc, files);
+    // Parsed only once, the compiler of every target is constructed from it
+    compile_stats_scope stats_scope(&s->stats, COMPILE_STATS_CROSS_PARSE);
+    compile_trace_scope trace_scope("cross parse", s->file.filename);
+    try {
+        s->cross_ir = std::unique_ptr<spirv_cross::Compiler::ParsedIR>(
+            new spirv_cross::Compiler::ParsedIR(spirv_cross::Compiler::parse_ir(s->spirv)));
+        s->cross_ir_users = s->num_targets - s->num_cached;
+    } catch (const std::exception& e) {
+        s->log += "SPIRV-cross: ";
+        s->log += e.what();
+        s->log += "\n";
+        s->result = -1;
+    }
+}
 
-    return 0;
+// Every target of the stage gets a copy of the parsed SPIR-V, except the last one which takes it over.
+// Targets are compiled in parallel, so it can only be taken if none of the others are still copying it
+static spirv_cross::Compiler::ParsedIR get_cross_ir(compile_stage* s, compile_stage_output* output)
+{
+    compile_stats_scope stats_scope(&output->stats, COMPILE_STATS_CROSS_PARSE);
+    spirv_cross::Compiler::ParsedIR ir;
+    sx_atomic_incr(&s->cross_ir_copies);
+    if (sx_atomic_decr(&s->cross_ir_users) == 0 && sx_atomic_fetch_add(&s->cross_ir_copies, 0) == 1)
+        ir = std::move(*s->cross_ir);
+    else
+        ir = *s->cross_ir;
+    sx_atomic_decr(&s->cross_ir_copies);
+    return ir;
 }
 
-int main(int argc, char* argv[])
+// One job for each stage/target pair, all targets are generated from the same SPIR-V of the stage
+static void cross_compile_stage_job(int index, void* user)
 {
-    cmd_args args = {};
-    args.lang = SHADER_LANG_COUNT;
+    const cross_compile_context* ctx = (const cross_compile_context*)user;
+    compile_stage* s = &ctx->stages[index / ctx->num_targets];
+    int target_index = index % ctx->num_targets;
+    compile_stage_output* output = &s->outputs[target_index];
+    if (output->cached) {
+        output->result = 0;
+        return;
+    }
 
-    int version = 0;
-    int dump_conf = 0;
+    compile_trace_scope trace_scope(k_trace_cross_names[ctx->targets[target_index].lang], s->file.filename);
+    output->result = cross_compile(*s->args, ctx->targets[target_index], get_cross_ir(s, output), s->file.stage, 
+                                   output, &output->log);
+    if (output->result == 0 && output->cache_key)
+        shader_cache_store(s->args->cache, output->cache_key, output->code, output->reflect_json);
+}
 
-    const sx_cmdline_opt opts[] = {
-        {"help", 'h', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'h', "Print this help text", 0x0},
-        {"version", 'V', SX_CMDLINE_OPTYPE_FLAG_SET, &version, 1, "Print version", 0x0},
-        {"vert", 'v', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'v', "Vertex shader source file", "Filepath"},
-        {"frag", 'f', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'f', "Fragment shader source file", "Filepath"},
-        {"compute", 'c', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'c', "Compute shader source file", "Filepath"},
-        {"output", 'o', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'o', "Output file", "Filepath"},
-        {"lang", 'l', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'l', "Convert to shader language", "es/metal/hlsl"},
-        {"defines", 'D', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'D', "Preprocessor definitions, seperated by comma", "Defines"},
-        {"invert-y", 'Y', SX_CMDLINE_OPTYPE_FLAG_SET, &args.invert_y, 1, "Invert position.y in vertex shader", 0x0},
-        {"profile", 'p', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, '0', "Shader profile version (HLSL: 30, 40, 50, 60), (ES: 200, 300)", "ProfileVersion"},
-        {"dumpc", 'C', SX_CMDLINE_OPTYPE_FLAG_SET, &dump_conf, 1, "Dump shader limits configuration", 0x0},
-        {"include-dirs", 'I', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'I', "Set include directory for <system> files, seperated by ';'", "Directory(s)"},
-        {"preprocess", 'P', SX_CMDLINE_OPTYPE_FLAG_SET, &args.preprocess, 1, "Dump preprocessed result to terminal"},
-        {"cvar", 'N', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'N', "Outputs Hex binary to a C include file with a variable name", "VariableName"},
-        {"flatten-ubos", 'F', SX_CMDLINE_OPTYPE_FLAG_SET, &args.flatten_ubos, 1, "Flatten UBOs, useful for ES2 shaders", 0x0},
-        {"reflect", 'r', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'r', "Output shader reflection information to a json file", "Filepath"},
-        {"sgs", 'G', SX_CMDLINE_OPTYPE_FLAG_SET, &args.sgs_file, 1, "Output file should be packed SGS format", "Filepath"},
-        SX_CMDLINE_OPT_END
-    };
-    sx_cmdline_context* cmdline = sx_cmdline_create_context(g_alloc, argc, (const char**)argv, opts);
-    
-    int opt;
-    const char* arg;
-    while ((opt = sx_cmdline_next(cmdline, NULL, &arg)) != -1) {
-        switch (opt) {
-            case '+': printf("Got argument without flag: %s\n", arg);           break;
-            case '?': printf("Unknown argument: %s\n", arg);         exit(-1);  break;
-            case '!': printf("Invalid use of argument: %s\n", arg);  exit(-1);  break;
-            case 'v': args.vs_filepath = arg;                                   break;
-            case 'f': args.fs_filepath = arg;                                   break;
-            case 'c': args.cs_filepath = arg;                                   break;
-            case 'o': args.out_filepath = arg;                                  break;
-            case 'D': parse_defines(&args, arg);                                break;
-            case 'l': args.lang = parse_shader_lang(arg);                       break;
-            case 'h': print_help(cmdline);                                      break;
-            case 'p': args.profile_ver = sx_toint(arg);                         break;
-            case 'I': parse_includes(&args, arg);                               break;
-            case 'N': args.cvar = arg;                                          break;
-            case 'r': args.reflect_filepath = arg;  args.reflect = 1;           break;
-            default:                                                            break;
-        }
+// Cache key of every stage/target is the hash of preprocessed source of the stage, and everything else that 
+// affects the output: glslcc version, defines, language, profile, options and the output file path that is 
+// written in reflection data
+static uint64_t get_cache_key(const compile_stage& s, const compile_target& target, 
+                              const compile_stage_output& output)
+{
+    const cmd_args& args = *s.args;
+    char opts[256];
+    sx_snprintf(opts, sizeof(opts), "%d.%d.%d|%s|%s|%d|flatten_ubos=%d|invert_y=%d|reflect=%d|sgs=%d|cvar=%d|", 
+                VERSION_MAJOR, VERSION_MINOR, VERSION_SUB, get_stage_name(s.file.stage), 
+                k_shader_types[target.lang], target.profile_ver, args.flatten_ubos, args.invert_y, args.reflect, 
+                target.sgs ? 1 : 0, target.cvar.empty() ? 0 : 1);
+
+    std::string key_str(opts);
+    for (int i = 0; i < sx_array_count(args.defines); i++) {
+        key_str += args.defines[i].def;
+        key_str += "=";
+        key_str += args.defines[i].val ? args.defines[i].val : "";
+        key_str += ";";
     }
+    key_str += target.sgs ? target.out_filepath : output.filepath;
 
-    if (version) {
-        print_version();
-        exit(0);
-    }
+    uint64_t key = sx_hash_xxh64(key_str.c_str(), key_str.size(), s.source_hash);
+    return key != 0 ? key : 1;
+}
 
-    if (dump_conf) {
-        puts(get_default_conf_str().c_str());
-        exit(0);
-    }
+// Tries to load all outputs of the stages from cache, returns true if everything is cached
+static bool load_cached_outputs(compile_stage* stages, int num_files, const compile_target* targets, 
+                                int num_targets)
+{
+    bool all_cached = true;
+    for (int i = 0; i < num_files; i++) {
+        compile_stage* s = &stages[i];
+        if (s->source_hash == 0) {
+            all_cached = false;
+            continue;
+        }
 
-    if ((args.vs_filepath && !sx_os_path_isfile(args.vs_filepath)) || 
-        (args.fs_filepath && !sx_os_path_isfile(args.fs_filepath)) ||
-        (args.cs_filepath && !sx_os_path_isfile(args.cs_filepath))) 
-    {
-        puts("input files are invalid");
-        exit(-1);
+        for (int t = 0; t < num_targets; t++) {
+            compile_stage_output* output = &s->outputs[t];
+            if (!targets[t].sgs)
+                get_stage_output_path(targets[t], s->file.stage, output);
+            output->cache_key = get_cache_key(*s, targets[t], *output);
+            output->cached = shader_cache_load(s->args->cache, output->cache_key, &output->code, 
+                                               &output->reflect_json);
+            if (output->cached)
+                ++s->num_cached;
+            else
+                all_cached = false;
+        }
     }
+    return all_cached;
+}
 
-    if (!args.vs_filepath && !args.fs_filepath && !args.cs_filepath) {
-        puts("you must at least define one input shader file");
-        exit(-1);
+// Input files and included files of the stages
+static void add_stage_deps(const compile_stage* stages, int num_files, std::vector<std::string>* deps)
+{
+    for (int i = 0; i < num_files; i++) {
+        add_unique_path(deps, stages[i].file.filename);
+        for (const std::string& include : stages[i].includes)
+            add_unique_path(deps, include);
     }
+}
 
-    if (args.cs_filepath && (args.vs_filepath || args.fs_filepath)) {
-        puts("Cannot link compute-shader with either fragment shader or vertex shader");
-        exit(-1);
+// Escapes the characters that have special meaning in Makefile rules
+static std::string make_depfile_path(const std::string& path)
+{
+    std::string escaped;
+    for (char c : path) {
+        if (c == ' ' || c == '#')
+            escaped += '\\';
+        else if (c == '$')
+            escaped += '$';
+        escaped += c;
     }
+    return escaped;
+}
 
-    if (args.out_filepath == nullptr && !args.preprocess) {
-        puts("Output file is not specified");
-        exit(-1);
+// Writes Makefile rules (--depfile) that make outputs depend on the inputs and every included file
+// Without a depfile path, each output gets it's own file with a single rule (<output>.d), which is what Ninja 
+// expects. Otherwise, all outputs are listed as targets of one rule in the depfile
+static bool write_depfiles(const cmd_args& args, const std::vector<std::string>& outputs, 
+                           const std::vector<std::string>& deps, std::vector<std::string>* written_files)
+{
+    std::string deps_str;
+    for (const std::string& dep : deps) {
+        deps_str += " \\\n  ";
+        deps_str += make_depfile_path(dep);
+    }
+    deps_str += "\n";
+
+    if (args.depfile_filepath) {
+        std::string rule;
+        for (const std::string& output : outputs) {
+            if (!rule.empty())
+                rule += " ";
+            rule += make_depfile_path(output);
+        }
+        rule += ":" + deps_str;
+        if (!write_output_file(args.depfile_filepath, rule.c_str(), nullptr, false, written_files)) {
+            printf("Writing to '%s' failed\n", args.depfile_filepath);
+            return false;
+        }
+    } else {
+        for (const std::string& output : outputs) {
+            std::string rule = make_depfile_path(output) + ":" + deps_str;
+            std::string depfile = output + ".d";
+            if (!write_output_file(depfile, rule.c_str(), nullptr, false, written_files)) {
+                printf("Writing to '%s' failed\n", depfile.c_str());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Outputs are written target by target, so C header files get all the stages of a target together
+static int write_outputs(const cmd_args& args, compile_stage* stages, int num_files, 
+                         const compile_target* targets, int num_targets, const char* prog_name)
+{
+    compile_trace_scope trace_scope("write", prog_name);
+    std::vector<std::string> written_files;
+    for (int t = 0; t < num_targets; t++) {
+        for (int i = 0; i < num_files; i++) {
+            compile_stage& s = stages[i];
+            const compile_stage_output& output = s.outputs[t];
+            if (!output.log.empty())
+                printf("%s", output.log.c_str());
+            compile_stats_scope stats_scope(&s.stats, COMPILE_STATS_WRITE);
+            if (output.result != 0 || 
+                write_stage_output(args, targets[t], output, s.file.stage, t*num_files + i, &written_files) != 0) 
+            {
+                commit_output_files(written_files, false);
+                return -1;
+            }
+        }
+    }
+
+    if (args.depfile) {
+        std::vector<std::string> outputs;
+        std::vector<std::string> deps;
+        for (int t = 0; t < num_targets; t++) {
+            for (int i = 0; i < num_files; i++) {
+                const compile_stage_output& output = stages[i].outputs[t];
+                add_unique_path(&outputs, targets[t].sgs ? targets[t].out_filepath : output.filepath);
+                if (args.reflect && !targets[t].sgs)
+                    add_unique_path(&outputs, get_reflect_filepath(targets[t], output));
+            }
+        }
+        add_stage_deps(stages, num_files, &deps);
+        if (!write_depfiles(args, outputs, deps, &written_files)) {
+            commit_output_files(written_files, false);
+            return -1;
+        }
+    }
+
+    if (!commit_output_files(written_files, true))
+        return -1;
+
+    for (int i = 0; i < num_files; i++)
+        puts(stages[i].file.filename);  // SUCCESS
+    return 0;
+}
+
+static void destroy_stages(compile_stage* stages)
+{
+    for (int i = 0; i < EShLangCount; i++) {
+        if (stages[i].shader) {
+            stages[i].shader->~TShader();
+            sx_free(g_alloc, stages[i].shader);
+            stages[i].shader = nullptr;
+        }
+        if (stages[i].source) {
+            sx_mem_destroy_block(stages[i].source);
+            stages[i].source = nullptr;
+        }
+    }
+}
+
+// Preamble of every stage, defines are added to it in 'setup_shader'
+static std::string make_stage_preamble()
+{
+    // Always set include_directive in the preamble, because we may need to include shaders
+    std::string preamble = "#extension GL_GOOGLE_include_directive : require\n";
+
+    // construct semantics mapping defines
+    // to be used in layout(location = SEMANTIC) inside GLSL
+    for (int i = 0; i < VERTEX_ATTRIB_COUNT; i++) {
+        char sem_line[128];
+        sx_snprintf(sem_line, sizeof(sem_line), "#define %s %d\n", k_attrib_names[i], i);
+        preamble += std::string(sem_line);
+    }
+
+    // Add SV_Target semantics for more HLSL compatibility
+    for (int i = 0; i < 8; i++) {
+        char sv_target_line[128];
+        sx_snprintf(sv_target_line, sizeof(sv_target_line), "#define SV_Target%d %d\n", i, i);
+        preamble += std::string(sv_target_line);
+    }
+    return preamble;
+}
+
+// Name of the program in stats and trace: output file (or first input file) and defines
+static std::string get_program_name(const cmd_args& args, const char* filename)
+{
+    std::string name = args.out_filepath ? args.out_filepath : filename;
+    for (int i = 0; i < sx_array_count(args.defines); i++) {
+        name += i == 0 ? " [" : ",";
+        name += args.defines[i].def;
+        if (args.defines[i].val) {
+            name += "=";
+            name += args.defines[i].val;
+        }
+        if (i == sx_array_count(args.defines) - 1)
+            name += "]";
+    }
+    return name;
+}
+
+// Adds the program to the report (--stats), stats of the targets are added to their stages
+static void add_program_stats(const cmd_args& args, const compile_stage* stages, const std::string& name,
+                              const compile_stats& prog_stats)
+{
+    if (!args.stats)
+        return;
+
+    const char* names[EShLangCount];
+    compile_stats stats[EShLangCount];
+    int num_stages = 0;
+    for (int i = 0; i < EShLangCount && stages[i].args; i++) {
+        const compile_stage& s = stages[i];
+        stats[num_stages] = s.stats;
+        for (int t = 0; t < s.num_targets; t++)
+            compile_stats_add(&stats[num_stages], s.outputs[t].stats);
+        names[num_stages++] = get_stage_name(s.file.stage);
+    }
+
+    compile_stats_add_program(args.stats, name.c_str(), names, stats, num_stages, prog_stats);
+}
+
+#define compile_files_ret(_code)        \
+        add_program_stats(args, stages, prog_name, prog_stats); \
+        destroy_stages(stages);         \
+        prog->~TProgram();              \
+        sx_free(g_alloc, prog);         \
+        glslang::SetThreadPoolAllocator(get_thread_pool()); \
+        return _code;                   
+
+// glslang::InitializeProcess must be called before this function, and it's only finalized
+// once at the end of main, so builtin symbol tables are shared between all compiled programs
+// If 'jobs' is not NULL, stages are parsed and cross-compiled in parallel
+// Every stage is parsed and compiled to SPIR-V only once, no matter how many targets are generated 
+static int compile_files(cmd_args& args, const compile_target* targets, int num_targets,
+                         const TBuiltInResource& limits_conf, sx_job_context* jobs)
+{
+    // Gather files for compilation
+    compile_file_desc files[EShLangCount];
+    int num_files = 0;
+    if (args.vs_filepath)
+        files[num_files++] = {EShLangVertex, args.vs_filepath};
+    if (args.fs_filepath)
+        files[num_files++] = {EShLangFragment, args.fs_filepath};
+    if (args.cs_filepath)
+        files[num_files++] = {EShLangCompute, args.cs_filepath};
+
+    glslang::TProgram* prog = new(sx_malloc(g_alloc, sizeof(glslang::TProgram))) glslang::TProgram();
+    compile_stage stages[EShLangCount];
+    compile_stats prog_stats = {};      // phases that are not per stage (link, ...)
+    std::string prog_name = get_program_name(args, num_files > 0 ? files[0].filename : "");
+    compile_trace_scope trace_scope("program", prog_name.c_str());
+    std::string preamble = make_stage_preamble();
+
+    for (int i = 0; i < num_files; i++) {
+        compile_stage* s = &stages[i];
+        s->args = &args;
+        s->limits_conf = &limits_conf;
+        s->file = files[i];
+        s->prog = prog;
+        s->num_targets = num_targets;
+        s->preamble = preamble;
+    }
+
+    // With cache, preprocess and hash the stages first, if all outputs are in the cache, glslang and spirv-cross 
+    // are skipped entirely. Otherwise, only the outputs that are not cached are cross-compiled
+    if (args.cache && !args.preprocess) {
+        run_jobs(jobs, hash_stage_job, stages, num_files);
+        if (args.deps)
+            add_stage_deps(stages, num_files, args.deps);
+        if (load_cached_outputs(stages, num_files, targets, num_targets)) {
+            for (int t = 0; t < num_targets; t++) {
+                for (int i = 0; i < num_files; i++)
+                    stages[i].outputs[t].result = 0;
+            }
+            compile_stats_begin(&prog_stats, COMPILE_STATS_WRITE);
+            int r = write_outputs(args, stages, num_files, targets, num_targets, prog_name.c_str());
+            compile_stats_end();
+            compile_files_ret(r);
+        }
+    }
+
+    run_jobs(jobs, parse_stage_job, stages, num_files);
+    if (args.deps)
+        add_stage_deps(stages, num_files, args.deps);
+
+    bool parse_failed = false;
+    for (int i = 0; i < num_files; i++) {
+        if (!stages[i].log.empty())
+            fprintf(stderr, "%s", stages[i].log.c_str());
+        if (stages[i].result != 0) {
+            parse_failed = true;
+        } else if (args.preprocess) {
+            puts("-------------------");
+            printf("%s:\n", files[i].filename);
+            puts("-------------------");
+            puts(stages[i].prep_str.c_str());
+            puts("");
+        } 
+        stages[i].log.clear();
+    }
+
+    if (parse_failed) {
+        compile_files_ret(-1);
+    }
+
+    // In preprocess mode, do not link, just exit
+    if (args.preprocess) {
+        compile_files_ret(0);
+    }
+
+    for (int i = 0; i < num_files; i++)
+        prog->addShader(stages[i].shader);
+
+    compile_stats_begin(&prog_stats, COMPILE_STATS_LINK);
+    bool linked;
+    {
+        compile_trace_scope link_trace("link", prog_name.c_str());
+        linked = prog->link(k_messages);
+    }
+    compile_stats_end();
+    if (!linked) {
+        puts("Link failed: ");
+        fprintf(stderr, "%s\n", prog->getInfoLog());
+        fprintf(stderr, "%s\n", prog->getInfoDebugLog());
+        compile_files_ret(-1);
+    }
+
+    // Generate SPIR-V for each shader, then cross-compile them to every target
+    run_jobs(jobs, spirv_stage_job, stages, num_files);
+
+    for (int i = 0; i < num_files; i++) {
+        if (!stages[i].log.empty())
+            printf("%s", stages[i].log.c_str());
+        if (stages[i].result != 0) {
+            compile_files_ret(-1);
+        }
+    }
+
+    cross_compile_context ctx = {stages, targets, num_targets};
+    run_jobs(jobs, cross_compile_stage_job, &ctx, num_files*num_targets);
+
+    compile_stats_begin(&prog_stats, COMPILE_STATS_WRITE);
+    int r = write_outputs(args, stages, num_files, targets, num_targets, prog_name.c_str());
+    compile_stats_end();
+    compile_files_ret(r);
+}
+
+// Checks the arguments of a single program and fills the defaults
+// Prints the error and returns false if arguments are invalid
+static bool validate_args(cmd_args* args)
+{
+    if ((args->vs_filepath && !sx_os_path_isfile(args->vs_filepath)) || 
+        (args->fs_filepath && !sx_os_path_isfile(args->fs_filepath)) ||
+        (args->cs_filepath && !sx_os_path_isfile(args->cs_filepath))) 
+    {
+        puts("input files are invalid");
+        return false;
+    }
+
+    if (!args->vs_filepath && !args->fs_filepath && !args->cs_filepath) {
+        puts("you must at least define one input shader file");
+        return false;
+    }
+
+    if (args->cs_filepath && (args->vs_filepath || args->fs_filepath)) {
+        puts("Cannot link compute-shader with either fragment shader or vertex shader");
+        return false;
+    }
+
+    if (args->out_filepath == nullptr && !args->preprocess) {
+        puts("Output file is not specified");
+        return false;
     }
 
-    if (args.lang == SHADER_LANG_COUNT && !args.preprocess) {
+    if (args->num_targets == 0 && !args->preprocess) {
         puts("Shader language is not specified");
-        exit(-1);
+        return false;
     }
 
-    if (args.out_filepath) {
+    if (args->out_filepath) {
         // determine if we output SGS format automatically
         char ext[32];
-        sx_os_path_ext(ext, sizeof(ext), args.out_filepath);
+        sx_os_path_ext(ext, sizeof(ext), args->out_filepath);
         if (sx_strequalnocase(ext, ".sgs"))
-            args.sgs_file = 1;
+            args->sgs_file = 1;
     }
 
     // Set default shader profile version
     // HLSL: 50 (5.0)
     // GLSL: 200 (2.00)
-    if (args.profile_ver == 0) {
-        if (args.lang == SHADER_LANG_GLES)
-            args.profile_ver = 200;
-        else if (args.lang == SHADER_LANG_HLSL)
-            args.profile_ver = 50;
+    for (int i = 0; i < args->num_targets; i++) {
+        shader_target* target = &args->targets[i];
+        if (target->profile_ver == 0)
+            target->profile_ver = args->profile_ver;
+        if (target->profile_ver == 0) {
+            if (target->lang == SHADER_LANG_GLES)
+                target->profile_ver = 200;
+            else if (target->lang == SHADER_LANG_HLSL)
+                target->profile_ver = 50;
+        }
+    }
+
+    return true;
+}
+
+// Inserts '_tag' before the extension of the filepath, or replaces the extension with '.tag'
+static std::string make_target_filepath(const char* filepath, const char* tag, bool replace_ext)
+{
+    char ext[32];
+    char basename[512];
+    sx_os_path_splitext(ext, sizeof(ext), basename, sizeof(basename), filepath);
+    if (replace_ext)
+        return std::string(basename) + "." + tag;
+    else
+        return std::string(basename) + "_" + tag + ext;
+}
+
+// Fills output paths of the targets
+// With a single target, outputs are exactly what's passed in the arguments
+// With multiple targets, each target gets a tag, which is the language name, followed by the profile version 
+// if there are multiple targets with the same language (gles200, gles300, hlsl, ...):
+//      - Code files: extension of the output file is replaced by the tag (shader_vs.gles300, shader_vs.hlsl)
+//      - SGS files and variant archives: tag is appended to the output filename (shader_hlsl.sgs)
+//      - C header files: all targets are written to the same file, with tag added to the variable names 
+//                        (g_shader_hlsl_vs)
+//      - Reflection file: tag is appended to the filename (shader_hlsl.json)
+static void setup_targets(const cmd_args& args, compile_target* targets)
+{
+    for (int i = 0; i < args.num_targets; i++) {
+        compile_target* t = &targets[i];
+        t->lang = args.targets[i].lang;
+        t->profile_ver = args.targets[i].profile_ver;
+        t->out_filepath = args.out_filepath ? args.out_filepath : "";
+        t->reflect_filepath = args.reflect_filepath ? args.reflect_filepath : "";
+        t->cvar = args.cvar ? args.cvar : "";
+        t->sgs = nullptr;
+        t->sgv = nullptr;
+
+        if (args.num_targets == 1 || !args.out_filepath)
+            continue;
+
+        char tag[32];
+        sx_strcpy(tag, sizeof(tag), k_shader_types[t->lang]);
+        for (int k = 0; k < args.num_targets; k++) {
+            if (k != i && args.targets[k].lang == t->lang) {
+                char profile[16];
+                sx_snprintf(profile, sizeof(profile), "%d", t->profile_ver);
+                sx_strcat(tag, sizeof(tag), profile);
+                break;
+            }
+        }
+
+        if (!t->cvar.empty()) 
+            t->cvar = t->cvar + "_" + tag;
+        else
+            t->out_filepath = make_target_filepath(args.out_filepath, tag, !args.sgs_file && !args.variants_filepath);
+        if (args.reflect_filepath)
+            t->reflect_filepath = make_target_filepath(args.reflect_filepath, tag, false);
     }
+}
+
+// Compiles a single vs/fs or cs program, args must be validated by 'validate_args'
+// This function is thread-safe, so programs can be compiled in worker threads
+static int compile_program(cmd_args& args, sx_job_context* jobs)
+{
+    compile_target targets[k_max_targets];
+    setup_targets(args, targets);
 
-    if (args.sgs_file && !args.preprocess) {
+    for (int i = 0; i < args.num_targets && args.sgs_file && !args.preprocess; i++) {
         sgs_shader_lang slang;
-        switch (args.lang) {
+        switch (targets[i].lang) {
             case SHADER_LANG_GLES:  slang = SGS_SHADER_GLES;    break;
             case SHADER_LANG_HLSL:  slang = SGS_SHADER_HLSL;    break;
             case SHADER_LANG_METAL: slang = SGS_SHADER_MSL;     break;
+            default:                slang = SGS_SHADER_GLES;    break;
         }
-        g_sgs = sgs_create_file(g_alloc, args.out_filepath, slang, args.profile_ver);
-        sx_assert(g_sgs);
+        targets[i].sgs = sgs_create_file(g_alloc, targets[i].out_filepath.c_str(), slang, targets[i].profile_ver);
+        sx_assert(targets[i].sgs);
     }
 
-    int r = compile_files(args, k_default_conf);
+    int r = compile_files(args, targets, args.num_targets, k_default_conf, jobs);
 
-    if (g_sgs) {
-        if (r == 0 && !sgs_commit(g_sgs)) {
-            printf("Writing SGS file '%s' failed", args.out_filepath);
+    for (int i = 0; i < args.num_targets; i++) {
+        sgs_file* sgs = targets[i].sgs;
+        if (sgs) {
+            compile_trace_scope trace_scope("sgs commit", targets[i].out_filepath.c_str());
+            if (r == 0 && !sgs_commit(sgs)) {
+                printf("Writing SGS file '%s' failed", targets[i].out_filepath.c_str());
+                r = -1;
+            }
+            sgs_destroy_file(sgs);
         }
-        sgs_destroy_file(g_sgs);
     }
 
-    sx_cmdline_destroy_context(cmdline, g_alloc);
-    cleanup_args(&args);
     return r;
 }
+
+// Sets up a stage that is compiled by 'compile_stages_in_memory', 'source' must stay valid until it's compiled
+static void init_memory_stage(compile_stage* s, const cmd_args& args, const compile_file_desc& file, 
+                              const char* source, int source_len, const std::string& preamble, int num_targets)
+{
+    s->args = &args;
+    s->limits_conf = &k_default_conf;
+    s->file = file;
+    s->source_str = source;
+    s->source_len = source_len;
+    s->preamble = preamble;
+    s->num_targets = num_targets;
+}
+
+static void append_log(std::string* log, const char* text)
+{
+    if (text && text[0]) {
+        *log += text;
+        if (log->back() != '\n')
+            *log += "\n";
+    }
+}
+
+// Same pipeline as 'compile_files', but outputs are kept in the stages instead of being written, and errors are
+// appended to 'log' instead of being printed. Stages must be set up with 'init_memory_stage', and the array must
+// have EShLangCount elements
+// Everything runs serially in the calling thread, so it can also be called inside jobs
+static int compile_stages_in_memory(const cmd_args& args, const compile_target* targets, int num_targets, 
+                                    compile_stage* stages, int num_stages, std::string* log)
+{
+    glslang::TProgram* prog = new(sx_malloc(g_alloc, sizeof(glslang::TProgram))) glslang::TProgram();
+    compile_stats prog_stats = {};
+    std::string prog_name = get_program_name(args, num_stages > 0 ? stages[0].file.filename : "");
+    for (int i = 0; i < num_stages; i++) {
+        stages[i].prog = prog;
+        parse_stage_job(i, stages);
+    }
+
+    bool parse_failed = false;
+    for (int i = 0; i < num_stages; i++) {
+        append_log(log, stages[i].log.c_str());
+        stages[i].log.clear();
+        if (stages[i].result != 0)
+            parse_failed = true;
+    }
+
+    if (parse_failed) {
+        compile_files_ret(-1);
+    }
+
+    for (int i = 0; i < num_stages; i++)
+        prog->addShader(stages[i].shader);
+
+    compile_stats_begin(&prog_stats, COMPILE_STATS_LINK);
+    bool linked;
+    {
+        compile_trace_scope link_trace("link", prog_name.c_str());
+        linked = prog->link(k_messages);
+    }
+    compile_stats_end();
+    if (!linked) {
+        append_log(log, "Link failed: ");
+        append_log(log, prog->getInfoLog());
+        append_log(log, prog->getInfoDebugLog());
+        compile_files_ret(-1);
+    }
+
+    for (int i = 0; i < num_stages; i++) {
+        spirv_stage_job(i, stages);
+        append_log(log, stages[i].log.c_str());
+        if (stages[i].result != 0) {
+            compile_files_ret(-1);
+        }
+    }
+
+    for (int i = 0; i < num_stages; i++) {
+        for (int t = 0; t < num_targets; t++) {
+            compile_trace_scope trace_scope(k_trace_cross_names[targets[t].lang], stages[i].file.filename);
+            if (cross_compile(args, targets[t], get_cross_ir(&stages[i], &stages[i].outputs[t]), stages[i].file.stage, 
+                              &stages[i].outputs[t], log) != 0) 
+            {
+                compile_files_ret(-1);
+            }
+        }
+    }
+
+    compile_files_ret(0);
+}
+
+// libglslcc (glslcc.h)
+// Sources are passed in memory, and outputs and logs are returned to the caller
+static const EShLanguage k_lib_stages[GLSLCC_STAGE_COUNT] = {
+    EShLangVertex,
+    EShLangFragment,
+    EShLangCompute
+};
+
+static const char* k_lib_stage_names[GLSLCC_STAGE_COUNT] = {
+    "vert",
+    "frag",
+    "comp"
+};
+
+static sx_mem_block* lib_create_text_block(const sx_alloc* alloc, const std::string& text)
+{
+    sx_mem_block* mem = sx_mem_create_block(alloc, (int)text.size() + 1, nullptr, 0);
+    sx_assert(mem);
+    sx_memcpy(mem->data, text.c_str(), text.size() + 1);
+    return mem;
+}
+
+// Included files are shared between all compilations of the library, and validated again in every compilation
+static include_cache* g_lib_include_cache = nullptr;
+
+bool glslcc_init(void)
+{
+    g_lib_include_cache = include_cache_create(g_alloc);
+    return glslang::InitializeProcess();
+}
+
+void glslcc_shutdown(void)
+{
+    glslang::FinalizeProcess();
+    if (g_lib_include_cache) {
+        include_cache_destroy(g_lib_include_cache);
+        g_lib_include_cache = nullptr;
+    }
+}
+
+glslcc_result* glslcc_compile(const sx_alloc* alloc, const glslcc_compile_desc* desc)
+{
+    sx_assert(alloc);
+    sx_assert(desc);
+
+    glslcc_result* result = (glslcc_result*)sx_malloc(alloc, sizeof(glslcc_result));
+    sx_assert(result);
+    sx_memset(result, 0x0, sizeof(glslcc_result));
+    result->alloc = alloc;
+
+    int stage_indices[GLSLCC_STAGE_COUNT];      // index of every compiled stage in glslcc_result::stages
+    int num_stages = 0;
+    for (int i = 0; i < GLSLCC_STAGE_COUNT; i++) {
+        if (desc->sources[i].code)
+            stage_indices[num_stages++] = i;
+    }
+
+    std::string log;
+    if (num_stages == 0) {
+        log = "you must at least define one input shader\n";
+    } else if (desc->sources[GLSLCC_STAGE_COMPUTE].code && num_stages > 1) {
+        log = "Cannot link compute-shader with either fragment shader or vertex shader\n";
+    } else if ((int)desc->lang < 0 || desc->lang >= GLSLCC_LANG_COUNT) {
+        log = "Invalid shader language\n";
+    } else {
+        cmd_args args = {};
+        args.invert_y = desc->invert_y ? 1 : 0;
+        args.flatten_ubos = desc->flatten_ubos ? 1 : 0;
+        args.reflect = desc->reflect ? 1 : 0;
+        for (int i = 0; i < desc->num_defines; i++) {
+            p_define d = {(char*)desc->defines[i].name, (char*)desc->defines[i].value};
+            sx_array_push(g_alloc, args.defines, d);
+        }
+        for (int i = 0; i < desc->num_include_dirs; i++)
+            args.includer.addSystemDir(desc->include_dirs[i]);
+        args.includer.setCallback(desc->include_cb, desc->include_user);
+        if (g_lib_include_cache) {
+            include_cache_acquire(g_lib_include_cache);
+            include_cache_invalidate(g_lib_include_cache);
+            args.includer.setCache(g_lib_include_cache);
+        }
+
+        compile_target target;
+        target.lang = (shader_lang)desc->lang;
+        target.profile_ver = desc->profile_ver;
+        if (target.profile_ver == 0) {
+            if (target.lang == SHADER_LANG_GLES)
+                target.profile_ver = 200;
+            else if (target.lang == SHADER_LANG_HLSL)
+                target.profile_ver = 50;
+        }
+        target.sgs = nullptr;
+        target.sgv = nullptr;
+
+        std::string preamble = make_stage_preamble();
+        compile_stage stages[EShLangCount];
+        for (int i = 0; i < num_stages; i++) {
+            const glslcc_source& src = desc->sources[stage_indices[i]];
+            compile_file_desc file = {k_lib_stages[stage_indices[i]], 
+                                      (src.name && src.name[0]) ? src.name : k_lib_stage_names[stage_indices[i]]};
+            init_memory_stage(&stages[i], args, file, src.code, src.len >= 0 ? src.len : sx_strlen(src.code), 
+                              preamble, 1);
+            stages[i].outputs[0].filepath = file.filename;     // 'file' of reflection data
+        }
+
+        result->ok = compile_stages_in_memory(args, &target, 1, stages, num_stages, &log) == 0;
+        if (result->ok) {
+            for (int i = 0; i < num_stages; i++) {
+                const compile_stage_output& output = stages[i].outputs[0];
+                const std::vector<uint32_t>& spirv = stages[i].spirv;
+                glslcc_stage_output* sout = &result->stages[stage_indices[i]];
+                sout->code = lib_create_text_block(alloc, output.code);
+                sout->spirv = sx_mem_create_block(alloc, (int)(spirv.size()*sizeof(uint32_t)), spirv.data(), 0);
+                sx_assert(sout->spirv);
+                if (args.reflect)
+                    sout->reflect = lib_create_text_block(alloc, output.reflect_json);
+            }
+        }
+
+        // define strings are owned by the caller, so 'cleanup_args' is not used
+        sx_array_free(g_alloc, args.defines);
+
+        // frees the old versions of changed files, when no other compilation is using them
+        if (g_lib_include_cache)
+            include_cache_release(g_lib_include_cache);
+    }
+
+    if (!log.empty())
+        result->log = lib_create_text_block(alloc, log);
+    return result;
+}
+
+void glslcc_destroy_result(glslcc_result* result)
+{
+    if (!result)
+        return;
+
+    for (int i = 0; i < GLSLCC_STAGE_COUNT; i++) {
+        glslcc_stage_output* sout = &result->stages[i];
+        if (sout->code)
+            sx_mem_destroy_block(sout->code);
+        if (sout->spirv)
+            sx_mem_destroy_block(sout->spirv);
+        if (sout->reflect)
+            sx_mem_destroy_block(sout->reflect);
+    }
+    if (result->log)
+        sx_mem_destroy_block(result->log);
+    sx_free(result->alloc, result);
+}
+
+// Command line tool (batch, variants, watch and compile server), libglslcc is built from the same source without it
+#ifndef GLSLCC_LIB
+
+// Copies the arguments, with their own defines that are freed by 'cleanup_args'
+static void copy_args(const cmd_args& src, cmd_args* dst)
+{
+    *dst = src;
+    dst->defines = nullptr;
+    for (int i = 0; i < sx_array_count(src.defines); i++) {
+        p_define d = src.defines[i];
+        int len = sx_strlen(d.def) + 1;
+        d.def = (char*)sx_malloc(g_alloc, len);
+        sx_memcpy(d.def, src.defines[i].def, len);
+        if (src.defines[i].val) {
+            // value is allocated with the define string, move the pointer to the copied string
+            d.val = d.def + (src.defines[i].val - src.defines[i].def);
+        }
+        sx_array_push(g_alloc, dst->defines, d);
+    }
+}
+
+// Batch manifest (json):
+//  {
+//      "programs": [
+//          {
+//              "name": "sprite",                   (optional, used for reporting errors)
+//              "vert": "sprite.vert",
+//              "frag": "sprite.frag",
+//              "compute": "",                      (can't be mixed with vert/frag)
+//              "output": "shaders/sprite.sgs",
+//              "lang": "hlsl" or "gles:300,hlsl:50,metal",
+//              "profile": 50,                      (default profile for languages that don't have one)
+//              "defines": ["USE_COLOR", "NUM_LIGHTS=4"] or "USE_COLOR,NUM_LIGHTS=4",
+//              "include_dirs": ["include"],
+//              "reflect": true or "shaders/sprite.json",
+//              "cvar": "g_sprite",
+//              "flatten_ubos": false,
+//              "invert_y": false,
+//              "sgs": false
+//          }
+//      ]
+//  }
+// Every property that is not defined in the program, takes the value from the command line arguments
+// Paths are relative to current working directory
+static bool parse_batch_program(sjson_node* jprog, const cmd_args& base_args, cmd_args* args)
+{
+    copy_args(base_args, args);
+
+    args->vs_filepath = sjson_get_string(jprog, "vert", base_args.vs_filepath);
+    args->fs_filepath = sjson_get_string(jprog, "frag", base_args.fs_filepath);
+    args->cs_filepath = sjson_get_string(jprog, "compute", base_args.cs_filepath);
+    args->out_filepath = sjson_get_string(jprog, "output", base_args.out_filepath);
+    args->cvar = sjson_get_string(jprog, "cvar", base_args.cvar);
+    args->profile_ver = sjson_get_int(jprog, "profile", base_args.profile_ver);
+    args->flatten_ubos = sjson_get_bool(jprog, "flatten_ubos", base_args.flatten_ubos != 0) ? 1 : 0;
+    args->invert_y = sjson_get_bool(jprog, "invert_y", base_args.invert_y != 0) ? 1 : 0;
+    args->sgs_file = sjson_get_bool(jprog, "sgs", base_args.sgs_file != 0) ? 1 : 0;
+
+    const char* lang = sjson_get_string(jprog, "lang", nullptr);
+    if (lang && !parse_targets(args, lang))
+        return false;
+
+    sjson_node* jreflect = sjson_find_member(jprog, "reflect");
+    if (jreflect) {
+        if (jreflect->tag == SJSON_STRING) {
+            args->reflect = 1;
+            args->reflect_filepath = jreflect->string_;
+        } else if (jreflect->tag == SJSON_BOOL) {
+            args->reflect = jreflect->bool_ ? 1 : 0;
+        }
+    }
+
+    sjson_node* jdefines = sjson_find_member(jprog, "defines");
+    if (jdefines) {
+        if (jdefines->tag == SJSON_STRING) {
+            parse_defines(args, jdefines->string_);
+        } else if (jdefines->tag == SJSON_ARRAY) {
+            sjson_node* jdef;
+            sjson_foreach(jdef, jdefines) {
+                if (jdef->tag == SJSON_STRING)
+                    parse_defines(args, jdef->string_);
+            }
+        }
+    }
+
+    sjson_node* jincludes = sjson_find_member(jprog, "include_dirs");
+    if (jincludes) {
+        if (jincludes->tag == SJSON_STRING) {
+            parse_includes(args, jincludes->string_);
+        } else if (jincludes->tag == SJSON_ARRAY) {
+            sjson_node* jinc;
+            sjson_foreach(jinc, jincludes) {
+                if (jinc->tag == SJSON_STRING)
+                    args->includer.addSystemDir(jinc->string_);
+            }
+        }
+    }
+
+    return true;
+}
+
+struct batch_program
+{
+    cmd_args                    args;
+    char                        name[256];      // empty for the program of the command line (--watch)
+    bool                        valid;
+    int                         result;
+    std::vector<std::string>    deps;           // input and included files (--watch)
+};
+
+struct batch_context
+{
+    batch_program*  progs;
+    const int*      indices;        // programs to compile
+    int             num_indices;
+    sx_atomic_int   next_prog;
+};
+
+static void compile_batch_program(batch_program* p, sx_job_context* jobs)
+{
+    p->deps.clear();
+    if (p->valid)
+        p->result = compile_program(p->args, jobs);
+    if (p->result != 0 && p->name[0])
+        printf("batch: program '%s' failed\n", p->name);
+}
+
+// Each worker picks the next program in the batch until all programs are compiled
+// This way, the number of fibers stays bounded to the number of workers, instead of the number of programs
+static void batch_worker_job(int index, void* user)
+{
+    batch_context* ctx = (batch_context*)user;
+    int i;
+    while ((i = sx_atomic_fetch_add(&ctx->next_prog, 1)) < ctx->num_indices) {
+        // Stages are compiled serially here, waiting on nested jobs inside a job is not supported by sx
+        compile_batch_program(&ctx->progs[ctx->indices[i]], nullptr);
+    }
+}
+
+// Compiles the programs of 'indices' in parallel, a single program is compiled with it's stages in parallel instead
+static void compile_batch_programs(batch_program* progs, const int* indices, int num_indices, 
+                                   sx_job_context* jobs, int num_workers)
+{
+    if (num_indices == 1) {
+        compile_batch_program(&progs[indices[0]], jobs);
+    } else {
+        batch_context ctx;
+        ctx.progs = progs;
+        ctx.indices = indices;
+        ctx.num_indices = num_indices;
+        ctx.next_prog = 0;
+        run_jobs(jobs, batch_worker_job, &ctx, sx_min(num_workers, num_indices));
+    }
+}
+
+struct watch_context
+{
+    std::unordered_map<std::string, std::vector<int>>   file_progs;     // absolute path -> programs that use it
+    std::vector<int>                                    dirty_progs;
+};
+
+static void watch_file_changed_cb(const char* filepath, void* user)
+{
+    watch_context* ctx = (watch_context*)user;
+    auto it = ctx->file_progs.find(filepath);
+    if (it != ctx->file_progs.end()) {
+        for (int i : it->second) {
+            if (std::find(ctx->dirty_progs.begin(), ctx->dirty_progs.end(), i) == ctx->dirty_progs.end())
+                ctx->dirty_progs.push_back(i);
+        }
+    }
+}
+
+// Compiles the programs, then keeps them in memory and watches their inputs and included files (--watch)
+// When files are changed, only the programs that depend on them are recompiled, until SIGINT or SIGTERM
+static int watch_programs(batch_program* progs, int num_progs, sx_job_context* jobs, int num_workers)
+{
+    file_watcher* watcher = file_watcher_create(g_alloc);
+    if (!watcher) {
+        puts("--watch is not supported on this platform");
+        return -1;
+    }
+
+    watch_context ctx;
+    for (int i = 0; i < num_progs; i++) {
+        progs[i].args.deps = &progs[i].deps;
+        ctx.dirty_progs.push_back(i);
+    }
+
+    // Nothing is compiled while waiting for changes, so the old versions of changed includes can be freed
+    include_cache* incache = progs[0].args.includer.getCache();
+    int r = 0;
+    do {
+        if (incache) {
+            include_cache_invalidate(incache);
+            include_cache_purge(incache);
+        }
+        std::sort(ctx.dirty_progs.begin(), ctx.dirty_progs.end());
+        uint64_t start_tm = sx_tm_now();
+        compile_batch_programs(progs, ctx.dirty_progs.data(), (int)ctx.dirty_progs.size(), jobs, num_workers);
+
+        int num_failed = 0;
+        for (int i : ctx.dirty_progs) {
+            if (progs[i].result != 0)
+                ++num_failed;
+        }
+        printf("watch: %d programs compiled, %d failed (%.1f ms)\n", (int)ctx.dirty_progs.size(), num_failed, 
+               sx_tm_ms(sx_tm_since(start_tm)));
+        fflush(stdout);
+
+        // Includes may be changed by the new sources, so the graph is rebuilt from the last compilation
+        ctx.file_progs.clear();
+        for (int i = 0; i < num_progs && r == 0; i++) {
+            for (const std::string& dep : progs[i].deps) {
+                char filepath[512];
+                file_watcher_path(filepath, sizeof(filepath), dep.c_str());
+                if (!file_watcher_add(watcher, filepath)) {
+                    printf("watching file '%s' failed\n", filepath);
+                    r = -1;
+                    break;
+                }
+                ctx.file_progs[filepath].push_back(i);
+            }
+        }
+
+        ctx.dirty_progs.clear();
+        while (r == 0 && ctx.dirty_progs.empty()) {
+            // wait a few milliseconds for the other files that are saved together
+            if (!file_watcher_wait(watcher, 5, watch_file_changed_cb, &ctx))
+                break;
+        }
+    } while (r == 0 && !ctx.dirty_progs.empty());
+
+    file_watcher_destroy(watcher);
+    return r;
+}
+
+// Compiles all programs in the batch manifest within the current process
+// Programs that fail are reported and skipped, the rest of the batch continues
+// If 'jobs' is not NULL, programs are compiled in parallel by 'num_workers' jobs
+// With 'watch', programs are recompiled when their files are changed, see 'watch_programs'
+static int compile_batch(const cmd_args& base_args, const char* manifest_filepath, sx_job_context* jobs, 
+                         int num_workers, bool watch)
+{
+    sx_mem_block* mem = sx_file_load_text(g_alloc, manifest_filepath);
+    if (!mem) {
+        printf("opening batch file '%s' failed\n", manifest_filepath);
+        return -1;
+    }
+
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)g_alloc);
+    sx_assert(jctx);
+
+    sjson_node* jroot = sjson_decode(jctx, (const char*)mem->data);
+    sjson_node* jprogs = jroot ? sjson_find_member(jroot, "programs") : nullptr;
+    if (!jprogs || jprogs->tag != SJSON_ARRAY) {
+        printf("batch file '%s' is invalid: 'programs' array is not found\n", manifest_filepath);
+        sjson_destroy_context(jctx);
+        sx_mem_destroy_block(mem);
+        return -1;
+    }
+
+    // Gather and validate all programs before compiling them
+    int num_progs = 0;
+    sjson_node* jprog;
+    sjson_foreach(jprog, jprogs) {
+        ++num_progs;
+    }
+
+    batch_program* progs = (batch_program*)sx_malloc(g_alloc, sizeof(batch_program)*sx_max(num_progs, 1));
+    sx_assert(progs);
+    int index = 0;
+    sjson_foreach(jprog, jprogs) {
+        batch_program* p = new(&progs[index]) batch_program();
+        p->result = -1;
+
+        const char* prog_name = sjson_get_string(jprog, "name", nullptr);
+        if (!prog_name)
+            prog_name = sjson_get_string(jprog, "output", nullptr);
+        if (prog_name)
+            sx_strcpy(p->name, sizeof(p->name), prog_name);
+        else
+            sx_snprintf(p->name, sizeof(p->name), "#%d", index);
+
+        p->valid = parse_batch_program(jprog, base_args, &p->args) && validate_args(&p->args);
+        ++index;
+    }
+
+    int r;
+    if (!watch) {
+        std::vector<int> indices(num_progs);
+        for (int i = 0; i < num_progs; i++)
+            indices[i] = i;
+        compile_batch_programs(progs, indices.data(), num_progs, jobs, num_workers);
+
+        int num_failed = 0;
+        for (int i = 0; i < num_progs; i++) {
+            if (progs[i].result != 0)
+                ++num_failed;
+        }
+        if (num_failed > 0)
+            printf("batch: %d of %d programs failed\n", num_failed, num_progs);
+        r = num_failed == 0 ? 0 : -1;
+    } else {
+        // program arguments point to the strings of the manifest, so it's kept until watching is stopped
+        r = watch_programs(progs, num_progs, jobs, num_workers);
+    }
+
+    for (int i = 0; i < num_progs; i++) {
+        cleanup_args(&progs[i].args);
+        progs[i].~batch_program();
+    }
+
+    sx_free(g_alloc, progs);
+    sjson_destroy_context(jctx);
+    sx_mem_destroy_block(mem);
+    return r;
+}
+
+// Watch mode (--watch) for the program of the command line, args must be validated by 'validate_args'
+static int watch_program(const cmd_args& args, sx_job_context* jobs, int num_workers)
+{
+    batch_program prog;
+    copy_args(args, &prog.args);
+    prog.name[0] = '\0';
+    prog.valid = true;
+    prog.result = -1;
+
+    int r = watch_programs(&prog, 1, jobs, num_workers);
+    cleanup_args(&prog.args);
+    return r;
+}
+
+// Permutation spec of shader variants (--variants), json:
+//  {
+//      "axes": [
+//          "USE_FOG",                                      boolean: not defined or defined
+//          {"name": "NUM_LIGHTS", "values": [1, 2, 4]}     defined to one of the values: NUM_LIGHTS=1, ...
+//      ],
+//      "exclude": [
+//          ["USE_FOG", "USE_SHADOW"],                      variants that match all terms of a rule are skipped
+//          ["NUM_LIGHTS=4", "!USE_SHADOW"]                 '!' matches a boolean axis that is not defined
+//      ]
+//  }
+// Key of every variant is the index of its values with the first axis as the lowest digit, so with boolean axes
+// only, it's the bitmask of defines: USE_FOG = 0x1, USE_SHADOW = 0x2, ...
+struct variant_axis
+{
+    std::string              name;
+    std::vector<std::string> values;    // empty for boolean axes
+};
+
+struct variant_term
+{
+    int axis;
+    int value;      // index of the value, boolean axes: 0 = not defined, 1 = defined
+};
+
+struct variant_spec
+{
+    std::vector<variant_axis>              axes;
+    std::vector<std::vector<variant_term>> excludes;
+};
+
+struct compile_variant
+{
+    uint32_t                            key;
+    std::string                         defines;            // "USE_FOG,NUM_LIGHTS=4"
+    cmd_args                            args;               // command line arguments + variant defines
+    uint64_t                            hash;               // hash of preprocessed stages, 0 if preprocessing failed
+    int                                 source_index;       // variant with the same preprocessed stages
+    std::vector<compile_stage_output>   outputs;            // (target, stage) pairs of compiled variants
+    std::vector<std::string>            includes;           // included files of all stages (--depfile)
+    std::string                         log;
+    int                                 result;
+};
+
+struct variant_context
+{
+    const compile_target*   targets;
+    int                     num_targets;
+    compile_file_desc       files[EShLangCount];
+    const sx_mem_block*     sources[EShLangCount];
+    int                     num_files;
+    std::string             preamble;
+    compile_variant*        variants;
+    int                     num_variants;
+    const int*              compile_indices;    // variants that are actually compiled
+    int                     num_compiles;
+    sx_atomic_int           next;
+};
+
+static const int k_max_variants = 65536;
+
+static bool parse_variant_term(const variant_spec& spec, const char* str, variant_term* term)
+{
+    bool negate = str[0] == '!';
+    if (negate)
+        ++str;
+    const char* equal = sx_strchar(str, '=');
+    std::string name = equal ? std::string(str, equal - str) : std::string(str);
+
+    for (int i = 0; i < (int)spec.axes.size(); i++) {
+        const variant_axis& axis = spec.axes[i];
+        if (axis.name != name)
+            continue;
+
+        term->axis = i;
+        if (axis.values.empty()) {
+            term->value = negate ? 0 : 1;
+            return !equal;
+        }
+        for (int k = 0; k < (int)axis.values.size() && equal && !negate; k++) {
+            if (axis.values[k] == equal + 1) {
+                term->value = k;
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+static bool parse_variant_spec(const char* filepath, variant_spec* spec)
+{
+    sx_mem_block* mem = sx_file_load_text(g_alloc, filepath);
+    if (!mem) {
+        printf("opening variants file '%s' failed\n", filepath);
+        return false;
+    }
+
+    sjson_context* jctx = sjson_create_context(0, 0, (void*)g_alloc);
+    sx_assert(jctx);
+
+    const char* err = nullptr;
+    sjson_node* jroot = sjson_decode(jctx, (const char*)mem->data);
+    sjson_node* jaxes = jroot ? sjson_find_member(jroot, "axes") : nullptr;
+    if (!jaxes || jaxes->tag != SJSON_ARRAY)
+        err = "'axes' array is not found";
+
+    sjson_node* jaxis;
+    if (!err) {
+        sjson_foreach(jaxis, jaxes) {
+            variant_axis axis;
+            if (jaxis->tag == SJSON_STRING) {
+                axis.name = jaxis->string_;
+            } else if (jaxis->tag == SJSON_OBJECT) {
+                axis.name = sjson_get_string(jaxis, "name", "");
+                sjson_node* jvalues = sjson_find_member(jaxis, "values");
+                sjson_node* jval;
+                if (jvalues && jvalues->tag == SJSON_ARRAY) {
+                    sjson_foreach(jval, jvalues) {
+                        char num[32];
+                        if (jval->tag == SJSON_STRING) {
+                            axis.values.push_back(jval->string_);
+                        } else if (jval->tag == SJSON_NUMBER) {
+                            sx_snprintf(num, sizeof(num), "%g", jval->number_);
+                            axis.values.push_back(num);
+                        }
+                    }
+                }
+                if (axis.values.empty()) {
+                    err = "axis doesn't have any values";
+                    break;
+                }
+            }
+
+            if (axis.name.empty()) {
+                err = "axis doesn't have a name";
+                break;
+            }
+            spec->axes.push_back(std::move(axis));
+        }
+    }
+
+    sjson_node* jexcludes = jroot && !err ? sjson_find_member(jroot, "exclude") : nullptr;
+    if (jexcludes && jexcludes->tag == SJSON_ARRAY) {
+        sjson_node* jrule;
+        sjson_foreach(jrule, jexcludes) {
+            std::vector<variant_term> rule;
+            sjson_node* jterm;
+            if (jrule->tag == SJSON_ARRAY) {
+                sjson_foreach(jterm, jrule) {
+                    variant_term term;
+                    if (jterm->tag != SJSON_STRING || !parse_variant_term(*spec, jterm->string_, &term)) {
+                        err = "exclude rule has an invalid term, it must be an axis name or 'name=value'";
+                        break;
+                    }
+                    rule.push_back(term);
+                }
+            }
+            if (err)
+                break;
+            if (!rule.empty())
+                spec->excludes.push_back(std::move(rule));
+        }
+    }
+
+    if (err)
+        printf("variants file '%s' is invalid: %s\n", filepath, err);
+
+    sjson_destroy_context(jctx);
+    sx_mem_destroy_block(mem);
+    return err == nullptr;
+}
+
+// Fills variants for every combination of the axes, except the excluded ones
+static bool enumerate_variants(const variant_spec& spec, const cmd_args& args, std::vector<compile_variant>* variants)
+{
+    int num_combinations = 1;
+    for (const variant_axis& axis : spec.axes) {
+        num_combinations *= axis.values.empty() ? 2 : (int)axis.values.size();
+        if (num_combinations > k_max_variants) {
+            printf("too many variants, maximum is %d\n", k_max_variants);
+            return false;
+        }
+    }
+
+    std::vector<int> values(spec.axes.size());
+    for (int key = 0; key < num_combinations; key++) {
+        int k = key;
+        for (int i = 0; i < (int)spec.axes.size(); i++) {
+            int num_values = spec.axes[i].values.empty() ? 2 : (int)spec.axes[i].values.size();
+            values[i] = k % num_values;
+            k /= num_values;
+        }
+
+        bool excluded = false;
+        for (const std::vector<variant_term>& rule : spec.excludes) {
+            bool match = true;
+            for (const variant_term& term : rule)
+                match &= values[term.axis] == term.value;
+            if (match) {
+                excluded = true;
+                break;
+            }
+        }
+        if (excluded)
+            continue;
+
+        std::string defines;
+        for (int i = 0; i < (int)spec.axes.size(); i++) {
+            const variant_axis& axis = spec.axes[i];
+            if (axis.values.empty() && values[i] == 0)
+                continue;
+            if (!defines.empty())
+                defines += ",";
+            defines += axis.name;
+            if (!axis.values.empty())
+                defines += "=" + axis.values[values[i]];
+        }
+
+        variants->emplace_back();
+        compile_variant* v = &variants->back();
+        v->key = (uint32_t)key;
+        v->defines = defines;
+        v->hash = 0;
+        v->source_index = (int)variants->size() - 1;
+        v->result = -1;
+        copy_args(args, &v->args);
+        if (!defines.empty())
+            parse_defines(&v->args, defines.c_str());
+    }
+
+    return true;
+}
+
+static void init_variant_stages(const variant_context* ctx, const compile_variant& v, compile_stage* stages)
+{
+    for (int i = 0; i < ctx->num_files; i++) {
+        init_memory_stage(&stages[i], v.args, ctx->files[i], (const char*)ctx->sources[i]->data, 
+                          ctx->sources[i]->size, ctx->preamble, ctx->num_targets);
+    }
+}
+
+// Preprocesses the stages of every variant and hashes them, variants with the same hash are only compiled once
+// Workers pick the next variant until all are done, like 'batch_worker_job'
+static void variant_hash_job(int index, void* user)
+{
+    variant_context* ctx = (variant_context*)user;
+    int i;
+    while ((i = sx_atomic_fetch_add(&ctx->next, 1)) < ctx->num_variants) {
+        compile_variant* v = &ctx->variants[i];
+        compile_stage stages[EShLangCount];
+        init_variant_stages(ctx, *v, stages);
+
+        uint64_t hashes[EShLangCount];
+        v->hash = 0;
+        bool valid = true;
+        for (int f = 0; f < ctx->num_files && valid; f++) {
+            hash_stage_job(f, stages);
+            hashes[f] = stages[f].source_hash;
+            valid = hashes[f] != 0;
+            for (const std::string& include : stages[f].includes)
+                add_unique_path(&v->includes, include);
+        }
+
+        if (valid) {
+            uint64_t hash = sx_hash_xxh64(hashes, sizeof(uint64_t)*ctx->num_files, 0);
+            v->hash = hash != 0 ? hash : 1;
+        }
+    }
+}
+
+static void variant_compile_job(int index, void* user)
+{
+    variant_context* ctx = (variant_context*)user;
+    int i;
+    while ((i = sx_atomic_fetch_add(&ctx->next, 1)) < ctx->num_compiles) {
+        compile_variant* v = &ctx->variants[ctx->compile_indices[i]];
+        compile_trace_scope trace_scope("variant", v->defines.c_str());
+        compile_stage stages[EShLangCount];
+        init_variant_stages(ctx, *v, stages);
+
+        v->result = compile_stages_in_memory(v->args, ctx->targets, ctx->num_targets, stages, ctx->num_files, 
+                                             &v->log);
+        if (v->result == 0) {
+            v->outputs.resize(ctx->num_files*ctx->num_targets);
+            for (int t = 0; t < ctx->num_targets; t++) {
+                for (int f = 0; f < ctx->num_files; f++)
+                    v->outputs[t*ctx->num_files + f] = std::move(stages[f].outputs[t]);
+            }
+        }
+    }
+}
+
+static sgs_shader_stage get_sgs_stage(EShLanguage stage)
+{
+    switch (stage) {
+        case EShLangVertex:         return SGS_STAGE_VERTEX;
+        case EShLangFragment:       return SGS_STAGE_FRAGMENT;
+        case EShLangCompute:        return SGS_STAGE_COMPUTE;
+        default:                    return SGS_STAGE_COUNT;
+    }
+}
+
+static sgs_shader_lang get_sgs_lang(shader_lang lang)
+{
+    switch (lang) {
+        case SHADER_LANG_GLES:      return SGS_SHADER_GLES;
+        case SHADER_LANG_HLSL:      return SGS_SHADER_HLSL;
+        case SHADER_LANG_METAL:     return SGS_SHADER_MSL;
+        default:                    return SGS_SHADER_GLES;
+    }
+}
+
+static bool validate_variant_args(cmd_args& args)
+{
+    if (!validate_args(&args))
+        return false;
+
+    if (args.sgs_file || args.cvar || args.preprocess || args.reflect_filepath) {
+        puts("--variants can't be used with --sgs, --cvar, --preprocess or reflection files, every variant is"
+             " written to the archive with it's reflection data");
+        return false;
+    }
+    args.reflect = 1;
+    return true;
+}
+
+// Compiles every variant of the permutation spec in the current process, and writes a variant archive for each 
+// target. Shader sources and includes are loaded once, and variants that preprocess to the same source are only 
+// compiled once. If 'jobs' is not NULL, variants are preprocessed and compiled in parallel by 'num_workers' jobs
+static int compile_variants(const cmd_args& args, sx_job_context* jobs, int num_workers)
+{
+    variant_spec spec;
+    if (!parse_variant_spec(args.variants_filepath, &spec))
+        return -1;
+
+    // sources are loaded through the include cache too, so they are only loaded once
+    include_cache* incache = args.includer.getCache();
+    sx_assert(incache);
+
+    std::vector<compile_variant> variants;
+    if (!enumerate_variants(spec, args, &variants))
+        return -1;
+
+    compile_target targets[k_max_targets];
+    setup_targets(args, targets);
+
+    variant_context ctx;
+    ctx.targets = targets;
+    ctx.num_targets = args.num_targets;
+    ctx.num_files = 0;
+    if (args.vs_filepath)
+        ctx.files[ctx.num_files++] = {EShLangVertex, args.vs_filepath};
+    if (args.fs_filepath)
+        ctx.files[ctx.num_files++] = {EShLangFragment, args.fs_filepath};
+    if (args.cs_filepath)
+        ctx.files[ctx.num_files++] = {EShLangCompute, args.cs_filepath};
+    ctx.preamble = make_stage_preamble();
+    ctx.variants = variants.data();
+    ctx.num_variants = (int)variants.size();
+
+    int r = 0;
+    for (int i = 0; i < ctx.num_files; i++) {
+        ctx.sources[i] = include_cache_load(incache, ctx.files[i].filename);
+        if (!ctx.sources[i]) {
+            printf("opening file '%s' failed\n", ctx.files[i].filename);
+            r = -1;
+        }
+    }
+
+    std::vector<int> compile_indices;
+    if (r == 0) {
+        ctx.next = 0;
+        run_jobs(jobs, variant_hash_job, &ctx, sx_min(num_workers, ctx.num_variants));
+
+        std::unordered_map<uint64_t, int> hash_indices;
+        for (int i = 0; i < ctx.num_variants; i++) {
+            compile_variant* v = &variants[i];
+            auto it = v->hash ? hash_indices.find(v->hash) : hash_indices.end();
+            if (it != hash_indices.end()) {
+                v->source_index = it->second;
+            } else {
+                if (v->hash)
+                    hash_indices[v->hash] = i;
+                compile_indices.push_back(i);
+            }
+        }
+
+        ctx.compile_indices = compile_indices.data();
+        ctx.num_compiles = (int)compile_indices.size();
+        ctx.next = 0;
+        run_jobs(jobs, variant_compile_job, &ctx, sx_min(num_workers, ctx.num_compiles));
+
+        for (int i : compile_indices) {
+            const compile_variant& v = variants[i];
+            if (v.result != 0) {
+                printf("variant %u (%s) failed:\n%s", v.key, v.defines.c_str(), v.log.c_str());
+                r = -1;
+            } else if (!v.log.empty()) {
+                printf("%s", v.log.c_str());
+            }
+        }
+    }
+
+    // Variants can include different files, archives depend on all of them
+    if (r == 0 && args.depfile) {
+        std::vector<std::string> outputs;
+        std::vector<std::string> deps;
+        for (int t = 0; t < args.num_targets; t++)
+            add_unique_path(&outputs, targets[t].out_filepath);
+        for (int i = 0; i < ctx.num_files; i++)
+            add_unique_path(&deps, ctx.files[i].filename);
+        add_unique_path(&deps, args.variants_filepath);
+        for (const compile_variant& v : variants) {
+            for (const std::string& include : v.includes)
+                add_unique_path(&deps, include);
+        }
+        std::vector<std::string> written_files;
+        bool written = write_depfiles(args, outputs, deps, &written_files);
+        if (!commit_output_files(written_files, written) || !written)
+            r = -1;
+    }
+
+    for (int t = 0; t < args.num_targets && r == 0; t++) {
+        sgv_file* sgv = sgv_create_file(g_alloc, targets[t].out_filepath.c_str(), get_sgs_lang(targets[t].lang), 
+                                        targets[t].profile_ver);
+        sx_assert(sgv);
+        for (const compile_variant& v : variants) {
+            const compile_variant& src = variants[v.source_index];
+            sgv_add_variant(sgv, v.key, v.defines.c_str());
+            for (int f = 0; f < ctx.num_files; f++) {
+                const compile_stage_output& output = src.outputs[t*ctx.num_files + f];
+                sgv_add_variant_stage(sgv, v.key, get_sgs_stage(ctx.files[f].stage), output.code.c_str(), 
+                                      output.reflect_json.c_str());
+            }
+        }
+
+        compile_trace_scope trace_scope("sgv commit", targets[t].out_filepath.c_str());
+        if (!sgv_commit(sgv)) {
+            printf("Writing variants file '%s' failed\n", targets[t].out_filepath.c_str());
+            r = -1;
+        }
+        sgv_destroy_file(sgv);
+    }
+
+    if (r == 0) {
+        printf("variants: %d variants, %d compiled\n", ctx.num_variants, (int)compile_indices.size());
+        for (int i = 0; i < ctx.num_files; i++)
+            puts(ctx.files[i].filename);  // SUCCESS
+    }
+
+    for (compile_variant& v : variants)
+        cleanup_args(&v.args);
+    return r;
+}
+
+// State that is shared between all requests of the compile server (--serve)
+struct server_context
+{
+    sx_job_context* jobs;
+    int             num_jobs;
+    include_cache*  incache;    // included files are validated again in every request
+    prefix_header_cache* pch;   // prefix headers stay validated between requests, until they are changed
+};
+
+static int run_glslcc(int argc, const char* argv[], const server_context* server);
+
+// Command line options, shared by run_glslcc and the client check in main
+static const sx_cmdline_opt k_cmdline_opts[] = {
+    {"help", 'h', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'h', "Print this help text", 0x0},
+    {"version", 'V', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'V', "Print version", 0x0},
+    {"vert", 'v', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'v', "Vertex shader source file", "Filepath"},
+    {"frag", 'f', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'f', "Fragment shader source file", "Filepath"},
+    {"compute", 'c', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'c', "Compute shader source file", "Filepath"},
+    {"output", 'o', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'o', "Output file", "Filepath"},
+    {"lang", 'l', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'l', "Convert to shader language(s), seperated by comma, with optional profile version (gles:300,hlsl:50,metal)", "gles/metal/hlsl"},
+    {"defines", 'D', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'D', "Preprocessor definitions, seperated by comma", "Defines"},
+    {"invert-y", 'Y', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'Y', "Invert position.y in vertex shader", 0x0},
+    {"profile", 'p', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'p', "Shader profile version (HLSL: 30, 40, 50, 60), (ES: 200, 300)", "ProfileVersion"},
+    {"dumpc", 'C', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'C', "Dump shader limits configuration", 0x0},
+    {"include-dirs", 'I', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'I', "Set include directory for <system> files, seperated by ';'", "Directory(s)"},
+    {"preprocess", 'P', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'P', "Dump preprocessed result to terminal"},
+    {"cvar", 'N', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'N', "Outputs Hex binary to a C include file with a variable name", "VariableName"},
+    {"flatten-ubos", 'F', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'F', "Flatten UBOs, useful for ES2 shaders", 0x0},
+    {"reflect", 'r', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'r', "Output shader reflection information to a json file", "Filepath"},
+    {"sgs", 'G', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'G', "Output file should be packed SGS format", "Filepath"},
+    {"batch", 'B', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'B', "Compile all programs in the json manifest file within one process", "Filepath"},
+    {"variants", 'W', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'W', "Compile all permutations of the json spec file into a variant archive per target", "Filepath"},
+    {"watch", 'w', SX_CMDLINE_OPTYPE_NO_ARG, 0x0, 'w', "Keep running and recompile the programs when their files or includes are changed", 0x0},
+    {"depfile", 'M', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'M', "Write Makefile dependencies of the outputs on included files to <output>.d, or to the filepath", "Filepath"},
+    {"jobs", 'j', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'j', "Number of worker threads to compile programs and stages in parallel (0 = all cores)", "NumThreads"},
+    {"cache-dir", 'k', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'k', "Cache compiled shaders in the directory and reuse them if sources and options are not changed", "Directory"},
+    {"cache-size", 'K', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'K', "Maximum size of the cache directory in megabytes (default: 256)", "Megabytes"},
+    {"serve", 'S', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'S', "Run as a compile server on the local socket, compiler stays initialized between requests", "SocketPath"},
+    {"pch", 'H', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'H', "Prefix header that shaders include first, it's compiled once and stages only parse the functions of it that they use", "Filepath"},
+    {"pool", 'm', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'm', "Memory of the compiler's pools: heap, virtual or huge (pages), with optional page size in KB (virtual:64). Prints peak memory usage", "Mode[:PageKB]"},
+    {"stats", 'T', SX_CMDLINE_OPTYPE_OPTIONAL, 0x0, 'T', "Print time and heap allocations of every compile phase per stage, or write them to a json file", "Filepath"},
+    {"trace", 'X', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'X', "Write chrome trace events of every compile phase per program and thread to a json file (chrome://tracing, Perfetto)", "Filepath"},
+    {"client", 'L', SX_CMDLINE_OPTYPE_REQUIRED, 0x0, 'L', "Forward the command to the compile server on the local socket (also set by GLSLCC_SERVER environment variable)", "SocketPath"},
+    SX_CMDLINE_OPT_END
+};
+
+static int server_request_cb(int argc, const char* argv[], void* user)
+{
+    return run_glslcc(argc, argv, (const server_context*)user);
+}
+
+// Preprocessing inside TShader::parse, glslang requests the tokens one at a time (--stats, --trace)
+class preprocess_observer : public glslang::TPreprocessorObserver
+{
+public:
+    void beginTokenize() override 
+    { 
+        compile_stats_begin(nullptr, COMPILE_STATS_PREPROCESS);
+        compile_trace_begin_preprocess();
+    }
+
+    void endTokenize() override 
+    { 
+        compile_trace_end_preprocess();
+        compile_stats_end();
+    }
+};
+
+static preprocess_observer g_preprocess_observer;
+
+#define run_glslcc_ret(_code)                           \
+        sx_cmdline_destroy_context(cmdline, g_alloc);   \
+        cleanup_args(&args);                            \
+        return _code;
+
+// Runs the compiler with the command line arguments
+// In compile server, this is called for every request and 'server' holds the shared state of the process
+static int run_glslcc(int argc, const char* argv[], const server_context* server)
+{
+    cmd_args args = {};
+
+    int version = 0;
+    int dump_conf = 0;
+    int help = 0;
+    int watch = 0;
+    const char* batch_filepath = nullptr;
+    int num_jobs = 1;
+    const char* cache_dir = nullptr;
+    int cache_size = 256;
+    const char* serve_socket = nullptr;
+    const char* pch_filepath = nullptr;
+    const char* pool = nullptr;
+    int show_stats = 0;
+    const char* stats_filepath = nullptr;
+    const char* trace_filepath = nullptr;
+
+    sx_cmdline_context* cmdline = sx_cmdline_create_context(g_alloc, argc, argv, k_cmdline_opts);
+    
+    int opt;
+    const char* arg;
+    while ((opt = sx_cmdline_next(cmdline, NULL, &arg)) != -1) {
+        switch (opt) {
+            case '+': printf("Got argument without flag: %s\n", arg);                       break;
+            case '?': printf("Unknown argument: %s\n", arg);         run_glslcc_ret(-1);    break;
+            case '!': printf("Invalid use of argument: %s\n", arg);  run_glslcc_ret(-1);    break;
+            case 'v': args.vs_filepath = arg;                                               break;
+            case 'f': args.fs_filepath = arg;                                               break;
+            case 'c': args.cs_filepath = arg;                                               break;
+            case 'o': args.out_filepath = arg;                                              break;
+            case 'D': parse_defines(&args, arg);                                            break;
+            case 'l': 
+                if (!parse_targets(&args, arg)) {
+                    run_glslcc_ret(-1);
+                }
+                break;
+            case 'h': help = 1;                                                             break;
+            case 'V': version = 1;                                                          break;
+            case 'C': dump_conf = 1;                                                        break;
+            case 'w': watch = 1;                                                            break;
+            case 'Y': args.invert_y = 1;                                                    break;
+            case 'P': args.preprocess = 1;                                                  break;
+            case 'F': args.flatten_ubos = 1;                                                break;
+            case 'G': args.sgs_file = 1;                                                    break;
+            case 'p': args.profile_ver = sx_toint(arg);                                     break;
+            case 'I': parse_includes(&args, arg);                                           break;
+            case 'N': args.cvar = arg;                                                      break;
+            case 'r': args.reflect_filepath = arg;  args.reflect = 1;                       break;
+            case 'B': batch_filepath = arg;                                                 break;
+            case 'W': args.variants_filepath = arg;                                         break;
+            case 'M': args.depfile = 1;  args.depfile_filepath = arg;                       break;
+            case 'j': num_jobs = sx_toint(arg);                                             break;
+            case 'k': cache_dir = arg;                                                      break;
+            case 'K': cache_size = sx_toint(arg);                                           break;
+            case 'S': serve_socket = arg;                                                   break;
+            case 'H': pch_filepath = arg;                                                   break;
+            case 'm': pool = arg;                                                           break;
+            case 'T': show_stats = 1;  stats_filepath = arg;                                break;
+            case 'X': trace_filepath = arg;                                                 break;
+            case 'L':                                                   /* see main */      break;
+            default:                                                                        break;
+        }
+    }
+
+    if (help) {
+        print_help(cmdline);
+        run_glslcc_ret(0);
+    }
+
+    if (version) {
+        print_version();
+        run_glslcc_ret(0);
+    }
+
+    if (dump_conf) {
+        puts(get_default_conf_str().c_str());
+        run_glslcc_ret(0);
+    }
+
+    if (pch_filepath && !sx_os_path_isfile(pch_filepath)) {
+        printf("prefix header '%s' doesn't exist\n", pch_filepath);
+        run_glslcc_ret(-1);
+    }
+
+    // Pools can only be set up before glslang is initialized, so requests of the compile server use the pools of
+    // the server, and only report the memory usage
+    if (pool) {
+        pool_pages_mode pool_mode;
+        int pool_page_size;
+        if (!pool_pages_parse(pool, &pool_mode, &pool_page_size)) {
+            printf("Invalid pool mode: %s\n", pool);
+            run_glslcc_ret(-1);
+        }
+        if (!server)
+            pool_pages_init(g_alloc, pool_mode, pool_page_size);
+    }
+
+    if (server && serve_socket) {
+        puts("compile server is already running");
+        run_glslcc_ret(-1);
+    }
+
+    // Worker threads, the main thread also picks up jobs while it's waiting for them
+    // In batch mode, each job compiles whole programs, otherwise the stages of the program are compiled in parallel
+    // and each stage/target pair is cross-compiled in a separate job. Fiber stacks are only allocated when used
+    // Requests of the compile server use the worker threads of the server
+    sx_job_context* jobs = nullptr;
+    if (!server) {
+        if (num_jobs <= 0)
+            num_jobs = sx_max((int)std::thread::hardware_concurrency(), 1);
+
+        if (num_jobs > 1) {
+            const int max_fibers = sx_max(num_jobs, (int)EShLangCount*k_max_targets);
+            jobs = sx_job_create_context(g_alloc, num_jobs - 1, max_fibers, max_fibers, k_fiber_stack_size);
+            if (!jobs) {
+                puts("Creating worker threads failed");
+                run_glslcc_ret(-1);
+            }
+        }
+    } else {
+        jobs = server->jobs;
+        num_jobs = server->num_jobs;
+    }
+
+    // Compile server doesn't compile anything by itself, it only keeps glslang initialized for the requests
+    if (serve_socket) {
+        server_context ctx = {jobs, num_jobs, include_cache_create(g_alloc), prefix_header_create_cache(g_alloc)};
+        glslang::InitializeProcess();
+        bool r = compile_server_run(g_alloc, serve_socket, server_request_cb, &ctx);
+        glslang::FinalizeProcess();
+        include_cache_destroy(ctx.incache);
+        prefix_header_destroy_cache(ctx.pch);
+        if (jobs)
+            sx_job_destroy_context(jobs, g_alloc);
+        run_glslcc_ret(r ? 0 : -1);
+    }
+
+    if (cache_dir) {
+        args.cache = shader_cache_create(g_alloc, cache_dir, (uint64_t)sx_max(cache_size, 0)*1024*1024);
+        if (!args.cache) {
+            printf("Creating cache directory '%s' failed\n", cache_dir);
+            if (jobs && !server)
+                sx_job_destroy_context(jobs, g_alloc);
+            run_glslcc_ret(-1);
+        }
+    }
+
+    // Included files are shared between all stages and programs, and loaded only once
+    include_cache* incache;
+    if (!server) {
+        incache = include_cache_create(g_alloc);
+    } else {
+        incache = server->incache;
+        include_cache_invalidate(incache);
+        include_cache_purge(incache);   // requests are processed one at a time
+    }
+    args.includer.setCache(incache);
+
+    // Prefix header is validated once for every define set, and shared by all stages and programs
+    prefix_header_cache* pch = nullptr;
+    if (pch_filepath) {
+        char pch_path[512];
+        sx_os_path_abspath(pch_path, sizeof(pch_path), pch_filepath);
+        pch = server ? server->pch : prefix_header_create_cache(g_alloc);
+        args.includer.setPrefixHeader(pch, pch_path);
+    }
+
+    // Stats of all programs are gathered in a report, which is printed or written at the end
+    if (show_stats) {
+        compile_stats_enable();
+        args.stats = compile_stats_create_report(g_alloc);
+    }
+    if (trace_filepath)
+        compile_trace_start();
+    if (show_stats || trace_filepath)
+        glslang::SetPreprocessorObserver(&g_preprocess_observer);
+
+    int r;
+    if (!server)
+        glslang::InitializeProcess();
+    if (batch_filepath && args.variants_filepath) {
+        puts("--variants can't be used in batch mode");
+        r = -1;
+    } else if (batch_filepath && args.depfile_filepath) {
+        puts("--depfile can't have a filepath in batch mode, every output gets it's own dependency file");
+        r = -1;
+    } else if (watch && (server || args.variants_filepath || args.preprocess)) {
+        puts("--watch can't be used with --variants, --preprocess or in the compile server");
+        r = -1;
+    } else if (batch_filepath) {
+        r = compile_batch(args, batch_filepath, jobs, num_jobs, watch != 0);
+    } else if (args.variants_filepath) {
+        r = validate_variant_args(args) ? compile_variants(args, jobs, num_jobs) : -1;
+    } else if (watch) {
+        r = validate_args(&args) ? watch_program(args, jobs, num_jobs) : -1;
+    } else {
+        r = validate_args(&args) ? compile_program(args, jobs) : -1;
+    }
+    if (!server)
+        glslang::FinalizeProcess();
+
+    if (args.cache) {
+        // cache only grows when new entries are written
+        if (shader_cache_get_stats(args.cache).writes > 0)
+            shader_cache_evict(args.cache);
+        shader_cache_stats stats = shader_cache_get_stats(args.cache);
+        printf("cache: %d hits, %d misses, %d evicted\n", stats.hits, stats.misses, stats.evicted);
+        shader_cache_destroy(args.cache);
+    }
+
+    pool_pages_memory mem;
+    if (pool && pool_pages_get_memory(&mem)) {
+        printf("memory: %.1f MB peak rss, %llu page faults (%llu major), %.1f MB pool pages committed\n",
+               (double)mem.peak_rss/(1024.0*1024.0), (unsigned long long)(mem.minor_faults + mem.major_faults),
+               (unsigned long long)mem.major_faults, (double)mem.committed/(1024.0*1024.0));
+    }
+
+    if (args.stats) {
+        if (stats_filepath) {
+            std::string json = compile_stats_report_json(args.stats);
+            if (!write_file(stats_filepath, json.c_str(), nullptr))
+                printf("Writing to '%s' failed\n", stats_filepath);
+        } else {
+            fputs(compile_stats_report_text(args.stats).c_str(), stdout);
+        }
+        compile_stats_destroy_report(args.stats);
+        compile_stats_disable();
+    }
+
+    if (trace_filepath) {
+        std::string json = compile_trace_stop();
+        if (!write_file(trace_filepath, json.c_str(), nullptr))
+            printf("Writing to '%s' failed\n", trace_filepath);
+    }
+    if (show_stats || trace_filepath)
+        glslang::SetPreprocessorObserver(nullptr);
+
+    if (!server)
+        include_cache_destroy(incache);
+    if (pch && !server)
+        prefix_header_destroy_cache(pch);
+    if (jobs && !server)
+        sx_job_destroy_context(jobs, g_alloc);
+
+    run_glslcc_ret(r);
+}
+
+// Returns the socket of the compile server, if the command should be forwarded to it
+static const char* get_client_socket(int argc, const char* argv[])
+{
+    sx_cmdline_context* cmdline = sx_cmdline_create_context(g_alloc, argc, argv, k_cmdline_opts);
+    if (!cmdline)
+        return nullptr;
+
+    const char* socket_path = nullptr;
+    bool local = false;
+    int opt;
+    const char* arg;
+    while ((opt = sx_cmdline_next(cmdline, NULL, &arg)) != -1) {
+        switch (opt) {
+            // server and watch mode always run in this process
+            case 'S':
+            case 'w': local = true;                                                         break;
+            case 'L': socket_path = arg;                                                    break;
+            default:                                                                        break;
+        }
+    }
+    sx_cmdline_destroy_context(cmdline, g_alloc);
+
+    if (local)
+        return nullptr;
+    if (!socket_path) {
+        socket_path = getenv("GLSLCC_SERVER");
+        if (socket_path && !socket_path[0])
+            socket_path = nullptr;
+    }
+    return socket_path;
+}
+
+int main(int argc, char* argv[])
+{
+    sx_tm_init();
+
+    // Forward the command to the compile server if it's available, otherwise compile in this process
+    const char* client_socket = get_client_socket(argc, (const char**)argv);
+    if (client_socket) {
+        int r;
+        if (compile_server_forward(client_socket, argc, (const char**)argv, &r))
+            return r;
+    }
+
+    return run_glslcc(argc, (const char**)argv, nullptr);
+}
+
+#endif // GLSLCC_LIB
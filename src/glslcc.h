@@ -0,0 +1,118 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// libglslcc: C API for compiling shaders in memory, without the command line tool
+//      glslcc_init             must be called once before compiling anything, initializes glslang
+//      glslcc_shutdown         releases glslang resources and the include cache, call it when the library is not needed anymore
+//      glslcc_compile          compiles source buffers of a vs/fs or cs program to a target language
+//                              returns code, SPIR-V and reflection data of each stage in memory blocks
+//                              can be called from multiple threads at the same time
+//      glslcc_destroy_result   frees the result and all of it's memory blocks
+//
+// The allocator that is passed to glslcc_compile only owns the result and it's memory blocks
+// Memory that is used while compiling (glslang pools, SPIR-V, SPIRV-Cross, include cache) comes from the
+// process heap and is released before glslcc_compile returns, except for the include cache (see glslcc_shutdown)
+// Nothing is written to disk, files are only read if 'include_dirs' is set or the include callback returns NULL
+//
+#pragma once
+
+#ifndef GLSLCC_H_
+#define GLSLCC_H_
+
+#include "sx/io.h"
+
+#if defined(GLSLCC_SHARED_LIB) && defined(_MSC_VER)
+#   ifdef GLSLCC_LIB_EXPORTS
+#       define GLSLCC_API __declspec(dllexport)
+#   else
+#       define GLSLCC_API __declspec(dllimport)
+#   endif
+#else
+#   define GLSLCC_API
+#endif
+
+typedef enum glslcc_stage
+{
+    GLSLCC_STAGE_VERTEX = 0,
+    GLSLCC_STAGE_FRAGMENT,
+    GLSLCC_STAGE_COMPUTE,
+    GLSLCC_STAGE_COUNT
+} glslcc_stage;
+
+typedef enum glslcc_lang
+{
+    GLSLCC_LANG_GLES = 0,
+    GLSLCC_LANG_HLSL,
+    GLSLCC_LANG_METAL,
+    GLSLCC_LANG_COUNT
+} glslcc_lang;
+
+// Returns contents of the included file, or NULL to search 'include_dirs' (and current directory for local includes)
+// 'local' is true for #include "file" and false for #include <file>
+// Returned memory block can be created with any allocator, it's destroyed by sx_mem_destroy_block after use
+typedef sx_mem_block* (glslcc_include_cb)(const char* header_name, const char* includer_name, bool local,
+                                          void* user);
+
+typedef struct glslcc_source
+{
+    const char* code;       // NULL if the program doesn't have this stage
+    int         len;        // -1: null-terminated
+    const char* name;       // used in error messages and reflection data (optional)
+} glslcc_source;
+
+typedef struct glslcc_define
+{
+    const char* name;
+    const char* value;      // optional
+} glslcc_define;
+
+typedef struct glslcc_compile_desc
+{
+    glslcc_source           sources[GLSLCC_STAGE_COUNT];
+    glslcc_lang             lang;
+    int                     profile_ver;        // 0: default (GLES: 200, HLSL: 50)
+    const glslcc_define*    defines;
+    int                     num_defines;
+    const char**            include_dirs;       // directories for <system> includes
+    int                     num_include_dirs;
+    glslcc_include_cb*      include_cb;         // optional
+    void*                   include_user;
+    bool                    invert_y;
+    bool                    flatten_ubos;
+    bool                    reflect;            // generate json reflection data
+} glslcc_compile_desc;
+
+typedef struct glslcc_stage_output
+{
+    sx_mem_block*   code;       // target language code, null-terminated
+    sx_mem_block*   spirv;      // SPIR-V words that the code is generated from
+    sx_mem_block*   reflect;    // json, null-terminated, NULL if 'reflect' is not set
+} glslcc_stage_output;
+
+typedef struct glslcc_result
+{
+    const sx_alloc*     alloc;
+    bool                ok;
+    glslcc_stage_output stages[GLSLCC_STAGE_COUNT];     // outputs are NULL for stages that are not compiled
+    sx_mem_block*       log;                            // errors and warnings, null-terminated, NULL if empty
+} glslcc_result;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+GLSLCC_API bool           glslcc_init(void);
+GLSLCC_API void           glslcc_shutdown(void);
+GLSLCC_API glslcc_result* glslcc_compile(const sx_alloc* alloc, const glslcc_compile_desc* desc);
+GLSLCC_API void           glslcc_destroy_result(glslcc_result* result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GLSLCC_H_
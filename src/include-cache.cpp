@@ -0,0 +1,317 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "include-cache.h"
+
+#include "sx/os.h"
+#include "sx/threads.h"
+#include "sx/atomic.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#if SX_PLATFORM_POSIX
+#   include <sys/stat.h>
+#endif
+
+struct include_cache__stat
+{
+    bool        valid;
+    bool        is_dir;
+    uint64_t    size;
+    uint64_t    mtime;      // nanoseconds where supported, edits within the same second must be detected
+};
+
+struct include_cache__file
+{
+    sx_mem_block    mem;            // points to loaded data
+    sx_mem_block*   loaded;         // NULL if the file is empty
+    uint64_t        size;
+    uint64_t        mtime;
+    int             generation;     // last generation that the file is validated in
+};
+
+struct include_cache__dir
+{
+    std::unordered_set<std::string> names;  // regular files in the directory
+    bool                            exists;
+    uint64_t                        mtime;
+    int                             generation;
+};
+
+struct include_cache
+{
+    const sx_alloc*                                         alloc   = nullptr;
+    sx_mutex                                                lock;
+    sx_atomic_int                                           generation;
+    std::unordered_map<std::string, include_cache__file*>   files;
+    std::unordered_map<std::string, include_cache__dir*>    dirs;
+    std::vector<include_cache__file*>                       retired;    // replaced by newer versions
+    int                                                     users   = 0;    // include_cache_acquire
+};
+
+static include_cache__stat include_cache__stat_path(const char* path)
+{
+    include_cache__stat s = {};
+#if SX_PLATFORM_POSIX
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return s;
+    s.valid = true;
+    s.is_dir = S_ISDIR(st.st_mode);
+    s.size = (uint64_t)st.st_size;
+#   if SX_PLATFORM_APPLE
+    s.mtime = (uint64_t)st.st_mtimespec.tv_sec*1000000000ull + (uint64_t)st.st_mtimespec.tv_nsec;
+#   else
+    s.mtime = (uint64_t)st.st_mtim.tv_sec*1000000000ull + (uint64_t)st.st_mtim.tv_nsec;
+#   endif
+#else
+    sx_file_info info = sx_os_stat(path);
+    s.valid = info.type != SX_FILE_TYPE_INVALID;
+    s.is_dir = info.type == SX_FILE_TYPE_DIRECTORY;
+    s.size = info.size;
+    s.mtime = info.last_modified*1000000000ull;
+#endif
+    return s;
+}
+
+// Files are read into memory rather than mapped, because long-lived processes (compile server, watch mode, library)
+// keep them across compilations, and an editor that truncates and rewrites a mapped file would crash them (SIGBUS)
+// The file is only taken if it's unchanged after it's read, so a file that is being written isn't cached half-written
+static include_cache__file* include_cache__load_file(include_cache* c, const char* filepath,
+                                                     include_cache__stat st)
+{
+    static char empty[1] = {0};
+    const int max_tries = 3;
+    for (int i = 0; i < max_tries; i++) {
+        sx_mem_block* loaded = nullptr;
+        if (st.size > 0) {
+            loaded = sx_file_load_bin(c->alloc, filepath);
+            if (!loaded)
+                return nullptr;
+        }
+
+        include_cache__stat nst = include_cache__stat_path(filepath);
+        if (nst.valid && nst.size == st.size && nst.mtime == st.mtime &&
+            (!loaded || (uint64_t)loaded->size == st.size))
+        {
+            include_cache__file* f = new(sx_malloc(c->alloc, sizeof(include_cache__file))) include_cache__file();
+            sx_assert(f);
+            f->loaded = loaded;
+            f->size = st.size;
+            f->mtime = st.mtime;
+            if (loaded)
+                sx_mem_init_block_ptr(&f->mem, loaded->data, loaded->size);
+            else
+                sx_mem_init_block_ptr(&f->mem, empty, 0);
+            return f;
+        }
+
+        if (loaded)
+            sx_mem_destroy_block(loaded);
+        if (!nst.valid || nst.is_dir)
+            return nullptr;
+        st = nst;
+    }
+    return nullptr;
+}
+
+static void include_cache__destroy_file(include_cache* c, include_cache__file* f)
+{
+    if (f->loaded)
+        sx_mem_destroy_block(f->loaded);
+    f->~include_cache__file();
+    sx_free(c->alloc, f);
+}
+
+static void include_cache__listdir_cb(const char* filename, const sx_file_info* info, void* user)
+{
+    if (info->type == SX_FILE_TYPE_REGULAR)
+        ((include_cache__dir*)user)->names.insert(filename);
+}
+
+// Returns false if the directory doesn't have the file, so the file itself doesn't need to be checked
+static bool include_cache__dir_has_file(include_cache* c, const std::string& dirpath, const std::string& name,
+                                        int generation)
+{
+    bool r = false;
+    sx_mutex_lock(&c->lock);
+    auto it = c->dirs.find(dirpath);
+    include_cache__dir* d = it != c->dirs.end() ? it->second : nullptr;
+    if (d && d->generation == generation) {
+        r = d->names.find(name) != d->names.end();
+        sx_mutex_unlock(&c->lock);
+        return r;
+    }
+    sx_mutex_unlock(&c->lock);
+
+    // Adding or removing files changes modification time of the directory
+    include_cache__stat st = include_cache__stat_path(dirpath.c_str());
+    bool exists = st.valid && st.is_dir;
+
+    sx_mutex_lock(&c->lock);
+    it = c->dirs.find(dirpath);
+    d = it != c->dirs.end() ? it->second : nullptr;
+    if (d && d->exists == exists && d->mtime == st.mtime) {
+        d->generation = generation;
+        r = d->names.find(name) != d->names.end();
+        sx_mutex_unlock(&c->lock);
+        return r;
+    }
+    sx_mutex_unlock(&c->lock);
+
+    include_cache__dir* nd = new(sx_malloc(c->alloc, sizeof(include_cache__dir))) include_cache__dir();
+    sx_assert(nd);
+    nd->exists = exists;
+    nd->mtime = st.mtime;
+    nd->generation = generation;
+    if (exists)
+        sx_os_listdir(dirpath.c_str(), include_cache__listdir_cb, nd);
+    r = nd->names.find(name) != nd->names.end();
+
+    // directories are only accessed inside the lock, so the old one can be freed right away
+    sx_mutex_lock(&c->lock);
+    include_cache__dir*& entry = c->dirs[dirpath];
+    if (entry) {
+        entry->~include_cache__dir();
+        sx_free(c->alloc, entry);
+    }
+    entry = nd;
+    sx_mutex_unlock(&c->lock);
+    return r;
+}
+
+include_cache* include_cache_create(const sx_alloc* alloc)
+{
+    include_cache* c = new(sx_malloc(alloc, sizeof(include_cache))) include_cache;
+    sx_assert(c);
+    c->alloc = alloc;
+    c->generation = 1;
+    sx_mutex_init(&c->lock);
+    return c;
+}
+
+void include_cache_destroy(include_cache* c)
+{
+    sx_assert(c);
+    include_cache_purge(c);
+    for (auto& it : c->files)
+        include_cache__destroy_file(c, it.second);
+    for (auto& it : c->dirs) {
+        it.second->~include_cache__dir();
+        sx_free(c->alloc, it.second);
+    }
+    sx_mutex_release(&c->lock);
+    c->~include_cache();
+    sx_free(c->alloc, c);
+}
+
+const sx_mem_block* include_cache_load(include_cache* c, const char* filepath)
+{
+    int generation = c->generation;
+
+    // Keys are absolute, because the working directory can change between compilations (compile server)
+    std::string path(filepath);
+    bool absolute = path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':');
+    if (!absolute) {
+        char cwd[512];
+        sx_os_path_pwd(cwd, sizeof(cwd));
+        path = std::string(cwd) + "/" + path;
+    }
+
+    size_t slash = path.find_last_of("/\\");
+    std::string dirpath = slash != std::string::npos ? path.substr(0, slash) : std::string(".");
+    if (dirpath.empty())
+        dirpath = "/";
+    if (!include_cache__dir_has_file(c, dirpath, path.substr(slash != std::string::npos ? slash + 1 : 0),
+                                     generation))
+    {
+        return nullptr;
+    }
+
+    sx_mutex_lock(&c->lock);
+    auto it = c->files.find(path);
+    include_cache__file* f = it != c->files.end() ? it->second : nullptr;
+    if (f && f->generation == generation) {
+        sx_mutex_unlock(&c->lock);
+        return &f->mem;
+    }
+    sx_mutex_unlock(&c->lock);
+
+    include_cache__stat st = include_cache__stat_path(path.c_str());
+    if (!st.valid || st.is_dir)
+        return nullptr;
+
+    sx_mutex_lock(&c->lock);
+    it = c->files.find(path);
+    f = it != c->files.end() ? it->second : nullptr;
+    if (f && f->mtime == st.mtime && f->size == st.size) {
+        f->generation = generation;
+        sx_mutex_unlock(&c->lock);
+        return &f->mem;
+    }
+    sx_mutex_unlock(&c->lock);
+
+    // Load outside of the lock, if another thread loads the same version at the same time, the first one is kept
+    include_cache__file* nf = include_cache__load_file(c, path.c_str(), st);
+    if (!nf)
+        return nullptr;
+    nf->generation = generation;
+
+    sx_mutex_lock(&c->lock);
+    include_cache__file*& entry = c->files[path];
+    if (entry && entry->mtime == nf->mtime && entry->size == nf->size) {
+        entry->generation = generation;
+        f = entry;
+    } else {
+        if (entry)
+            c->retired.push_back(entry);
+        entry = nf;
+        f = nf;
+        nf = nullptr;
+    }
+    sx_mutex_unlock(&c->lock);
+
+    if (nf)
+        include_cache__destroy_file(c, nf);
+    return &f->mem;
+}
+
+void include_cache_invalidate(include_cache* c)
+{
+    sx_atomic_incr(&c->generation);
+}
+
+static void include_cache__purge_locked(include_cache* c)
+{
+    for (include_cache__file* f : c->retired)
+        include_cache__destroy_file(c, f);
+    c->retired.clear();
+}
+
+void include_cache_purge(include_cache* c)
+{
+    sx_mutex_lock(&c->lock);
+    include_cache__purge_locked(c);
+    sx_mutex_unlock(&c->lock);
+}
+
+void include_cache_acquire(include_cache* c)
+{
+    sx_mutex_lock(&c->lock);
+    c->users++;
+    sx_mutex_unlock(&c->lock);
+}
+
+void include_cache_release(include_cache* c)
+{
+    sx_mutex_lock(&c->lock);
+    sx_assert(c->users > 0);
+    if (--c->users == 0)
+        include_cache__purge_locked(c);
+    sx_mutex_unlock(&c->lock);
+}
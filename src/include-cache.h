@@ -0,0 +1,44 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// In-memory cache of included files, shared by all compilations of the process (stages, programs, variants)
+//  - Files are read into memory, and kept until the cache is destroyed. They are not memory-mapped, so changing a
+//    file while it's cached can't crash the process
+//  - Files are identified by their resolved path, and validated by their modification time and size once in
+//    every generation (include_cache_invalidate). Within a generation, loads don't touch the disk at all
+//  - Negative lookups are cached per directory: the file names of every searched directory are listed once,
+//    and validated by the modification time of the directory, so searching a long list of include directories
+//    doesn't stat the same missing files again and again
+//  - When a file is changed, the new version replaces it, but the old one stays in memory because compilations
+//    may still use it, until include_cache_purge is called or the last compilation releases the cache
+// All functions are thread-safe
+//
+#pragma once
+
+#include "sx/io.h"
+
+struct include_cache;
+
+include_cache*      include_cache_create(const sx_alloc* alloc);
+void                include_cache_destroy(include_cache* c);
+
+// Returns NULL if the file doesn't exist or can't be loaded, returned memory is owned by the cache and stays valid
+// until include_cache_purge, include_cache_destroy or the last include_cache_release
+const sx_mem_block* include_cache_load(include_cache* c, const char* filepath);
+
+// Starts a new generation, so files are validated again the next time they are loaded
+// Call it whenever files may have changed on disk (new request, file change notification, ...)
+void                include_cache_invalidate(include_cache* c);
+
+// Frees the old versions of the changed files, only call it when no compilation is using the cache
+void                include_cache_purge(include_cache* c);
+
+// For compilations that can run at the same time (libglslcc): every compilation holds the cache while it uses
+// it's files, and the old versions are purged when the last one releases it
+void                include_cache_acquire(include_cache* c);
+void                include_cache_release(include_cache* c);
@@ -0,0 +1,270 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "pool-pages.h"
+
+#include "sx/os.h"
+#include "sx/string.h"
+#include "sx/threads.h"
+#include "sx/virtual-alloc.h"
+
+#include "glslang/Include/PoolAlloc.h"
+
+#include <vector>
+
+#if SX_PLATFORM_POSIX
+#   include <sys/mman.h>
+#   include <sys/resource.h>
+#endif
+
+static const size_t k_pool_pages_default_size = 64*1024;
+static const size_t k_pool_pages_huge_size = 2*1024*1024;   // transparent huge page size (x86-64, arm64)
+static const size_t k_pool_pages_commit_size = 1024*1024;
+// Ranges are aligned to their size, so the range of a page is found by its address in g_pool_pages_ranges
+#if SX_ARCH_64BIT
+static const int k_pool_pages_range_shift = 30;     // 1 GB
+static const int k_pool_pages_address_bits = 47;    // user space of x86-64 and arm64
+#else
+static const int k_pool_pages_range_shift = 26;     // 64 MB
+static const int k_pool_pages_address_bits = 32;
+#endif
+static const size_t k_pool_pages_reserve_size = (size_t)1 << k_pool_pages_range_shift;
+static const size_t k_pool_pages_max_ranges = (size_t)1 << (k_pool_pages_address_bits - k_pool_pages_range_shift);
+// Freed allocations are kept in free lists by page count, bigger allocations come from the heap
+static const int k_pool_pages_max_count = 64;
+
+// Virtual memory range of a thread, only other threads that free its pages share the lock
+struct pool_pages__range
+{
+    sx_mutex    lock;
+    uint8_t*    base;
+    size_t      offset;         // next allocation
+    size_t      committed;
+    int         num_allocs;     // allocations that are not freed yet, range is reset when it gets to zero
+    void*       free_lists[k_pool_pages_max_count + 1];     // by page count, linked through the first pointer
+};
+
+class pool_pages__allocator : public glslang::TPoolPageAllocator
+{
+public:
+    size_t getPageSize() const override { return page_size; }
+    void* allocate(size_t num_bytes) override;
+    void deallocate(void* memory, size_t num_bytes) override;
+
+    const sx_alloc*                 alloc;
+    pool_pages_mode                 mode;
+    size_t                          page_size;
+    sx_mutex                        lock;       // only for creating ranges and reading memory stats
+    std::vector<pool_pages__range*> ranges;
+};
+
+static pool_pages__allocator* g_pool_pages = nullptr;
+static thread_local pool_pages__range* t_pool_pages_range = nullptr;
+
+// Indexed by address >> k_pool_pages_range_shift. Every entry is written once when its range is created, before
+// any page of the range is handed out, so it's read without locking
+static pool_pages__range* g_pool_pages_ranges[k_pool_pages_max_ranges];
+
+static pool_pages__range* pool_pages__find_range(void* ptr)
+{
+    size_t index = (size_t)((uintptr_t)ptr >> k_pool_pages_range_shift);
+    return index < k_pool_pages_max_ranges ? g_pool_pages_ranges[index] : nullptr;
+}
+
+static pool_pages__range* pool_pages__create_range(pool_pages__allocator* pa)
+{
+    // twice the size is reserved, so an aligned range fits in it. Aligned ranges can also be backed by huge pages
+    uint8_t* ptr = (uint8_t*)sx_virtual_reserve(k_pool_pages_reserve_size*2);
+#if SX_PLATFORM_POSIX
+    if (ptr == (uint8_t*)MAP_FAILED)
+        ptr = nullptr;
+#endif
+    if (!ptr)
+        return nullptr;
+
+    uint8_t* base = (uint8_t*)sx_align_mask((uintptr_t)ptr, (uintptr_t)k_pool_pages_reserve_size - 1);
+#if SX_PLATFORM_POSIX
+    // unused parts of the reservation are given back, Windows can only release all of it
+    if (base > ptr)
+        munmap(ptr, (size_t)(base - ptr));
+    if (ptr + k_pool_pages_reserve_size > base)
+        munmap(base + k_pool_pages_reserve_size, (size_t)(ptr + k_pool_pages_reserve_size - base));
+#endif
+    size_t index = (size_t)((uintptr_t)base >> k_pool_pages_range_shift);
+    if (index >= k_pool_pages_max_ranges) {
+#if SX_PLATFORM_POSIX
+        munmap(base, k_pool_pages_reserve_size);
+#else
+        sx_virtual_release(ptr);
+#endif
+        return nullptr;
+    }
+
+    pool_pages__range* r = (pool_pages__range*)sx_malloc(pa->alloc, sizeof(pool_pages__range));
+    sx_assert(r);
+    sx_memset(r, 0x0, sizeof(pool_pages__range));
+    sx_mutex_init(&r->lock);
+    r->base = base;
+
+    sx_mutex_lock(&pa->lock);
+    pa->ranges.push_back(r);
+    sx_mutex_unlock(&pa->lock);
+    g_pool_pages_ranges[index] = r;
+    return r;
+}
+
+static bool pool_pages__commit(pool_pages__allocator* pa, pool_pages__range* r, size_t end)
+{
+    size_t commit_size = pa->mode == POOL_PAGES_HUGE ? k_pool_pages_huge_size : k_pool_pages_commit_size;
+    size_t size = sx_align_mask(end - r->committed, commit_size - 1);
+    if (r->committed + size > k_pool_pages_reserve_size)
+        return false;
+
+    uint8_t* ptr = (uint8_t*)sx_virtual_commit(r->base + r->committed, size);
+#if SX_PLATFORM_POSIX
+    if (ptr == (uint8_t*)MAP_FAILED)
+        ptr = nullptr;
+#endif
+    if (!ptr)
+        return false;
+
+    // commit maps a new region, so the advice is given to every committed part
+#if SX_PLATFORM_LINUX && defined(MADV_HUGEPAGE)
+    if (pa->mode == POOL_PAGES_HUGE)
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    r->committed += size;
+    return true;
+}
+
+void* pool_pages__allocator::allocate(size_t num_bytes)
+{
+    int count = (int)(num_bytes / page_size);
+    if (mode == POOL_PAGES_HEAP || count > k_pool_pages_max_count)
+        return sx_malloc(alloc, num_bytes);
+
+    pool_pages__range* r = t_pool_pages_range;
+    if (!r) {
+        r = pool_pages__create_range(this);
+        t_pool_pages_range = r;
+    }
+
+    void* ptr = nullptr;
+    if (r) {
+        sx_mutex_lock(&r->lock);
+        if (r->free_lists[count]) {
+            ptr = r->free_lists[count];
+            r->free_lists[count] = *(void**)ptr;
+        } else if (r->offset + num_bytes <= r->committed ||
+                   pool_pages__commit(this, r, r->offset + num_bytes))
+        {
+            ptr = r->base + r->offset;
+            r->offset += num_bytes;
+        }
+        if (ptr)
+            ++r->num_allocs;
+        sx_mutex_unlock(&r->lock);
+    }
+
+    // range is full or can't be reserved
+    return ptr ? ptr : sx_malloc(alloc, num_bytes);
+}
+
+void pool_pages__allocator::deallocate(void* memory, size_t num_bytes)
+{
+    int count = (int)(num_bytes / page_size);
+    pool_pages__range* r = mode != POOL_PAGES_HEAP && count <= k_pool_pages_max_count ?
+        pool_pages__find_range(memory) : nullptr;
+    if (!r) {
+        sx_free(alloc, memory);
+        return;
+    }
+
+    sx_mutex_lock(&r->lock);
+    if (--r->num_allocs == 0) {
+        r->offset = 0;
+        sx_memset(r->free_lists, 0x0, sizeof(r->free_lists));
+    } else {
+        *(void**)memory = r->free_lists[count];
+        r->free_lists[count] = memory;
+    }
+    sx_mutex_unlock(&r->lock);
+}
+
+bool pool_pages_init(const sx_alloc* alloc, pool_pages_mode mode, int page_size)
+{
+    sx_assert(!g_pool_pages && "pool pages are already initialized");
+
+    if (mode == POOL_PAGES_HEAP && page_size <= 0)
+        return true;
+
+    size_t os_page_size = (size_t)sx_os_pagesz();
+    size_t size = page_size > 0 ? (size_t)page_size : k_pool_pages_default_size;
+    size = sx_max(sx_align_mask(size, os_page_size - 1), os_page_size);
+
+    pool_pages__allocator* pa = new(sx_malloc(alloc, sizeof(pool_pages__allocator))) pool_pages__allocator;
+    sx_assert(pa);
+    pa->alloc = alloc;
+    pa->mode = mode;
+    pa->page_size = size;
+    sx_mutex_init(&pa->lock);
+
+    g_pool_pages = pa;
+    glslang::SetPoolPageAllocator(pa);
+    return true;
+}
+
+bool pool_pages_parse(const char* str, pool_pages_mode* mode, int* page_size)
+{
+    const char* colon = sx_strchar(str, ':');
+    int len = colon ? (int)(colon - str) : sx_strlen(str);
+    if (len == 4 && sx_strnequal(str, "heap", 4))
+        *mode = POOL_PAGES_HEAP;
+    else if (len == 7 && sx_strnequal(str, "virtual", 7))
+        *mode = POOL_PAGES_VIRTUAL;
+    else if (len == 4 && sx_strnequal(str, "huge", 4))
+        *mode = POOL_PAGES_HUGE;
+    else
+        return false;
+
+    *page_size = 0;
+    if (colon) {
+        int kb = sx_toint(colon + 1);
+        if (kb <= 0)
+            return false;
+        *page_size = kb*1024;
+    }
+    return true;
+}
+
+bool pool_pages_get_memory(pool_pages_memory* mem)
+{
+    sx_memset(mem, 0x0, sizeof(pool_pages_memory));
+    if (g_pool_pages) {
+        sx_mutex_lock(&g_pool_pages->lock);
+        for (pool_pages__range* r : g_pool_pages->ranges) {
+            sx_mutex_lock(&r->lock);
+            mem->committed += r->committed;
+            sx_mutex_unlock(&r->lock);
+        }
+        sx_mutex_unlock(&g_pool_pages->lock);
+    }
+
+#if SX_PLATFORM_POSIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return false;
+#   if SX_PLATFORM_APPLE
+    mem->peak_rss = (uint64_t)usage.ru_maxrss;
+#   else
+    mem->peak_rss = (uint64_t)usage.ru_maxrss*1024;
+#   endif
+    mem->minor_faults = (uint64_t)usage.ru_minflt;
+    mem->major_faults = (uint64_t)usage.ru_majflt;
+    return true;
+#else
+    return false;
+#endif
+}
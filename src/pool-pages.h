@@ -0,0 +1,50 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Pages of glslang pool allocators (--pool)
+// glslang allocates all of the intermediate tree, symbol tables and SPIR-V builder data of a compilation from
+// pools, which get their pages from the heap in small fixed-size chunks, and free them all again when the shader
+// or program is destroyed. In virtual mode, each thread gets one large reserved range of virtual memory instead:
+//      - Pages are carved from the range of the thread that allocates them, and the range is committed
+//        incrementally as it grows. Huge mode also asks the OS to back the range with transparent huge pages
+//      - Freed pages stay committed, and are reused by the next pools of any compilation. When all pages of a
+//        range are freed (end of a compilation), the range is reset and allocated sequentially again
+//      - Pages can be freed by any thread, shaders are often destroyed on a different thread than they are parsed.
+//        Ranges are aligned to their size, so the range of a page is found from its address, and every range has
+//        its own lock, which other threads only take to free its pages
+//      - Ranges are kept until the process exits, because thread pools are freed after main returns
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+enum pool_pages_mode
+{
+    POOL_PAGES_HEAP = 0,        // glslang's own heap pages (default)
+    POOL_PAGES_VIRTUAL,
+    POOL_PAGES_HUGE
+};
+
+struct pool_pages_memory
+{
+    uint64_t    peak_rss;           // bytes
+    uint64_t    minor_faults;
+    uint64_t    major_faults;
+    uint64_t    committed;          // bytes committed by the ranges of all threads (virtual and huge modes)
+};
+
+// Sets the source of the pages for all glslang pools that are created after this, call it once before
+// initializing glslang. 'page_size' is the pool granularity in bytes, 0 for the default of the mode
+// In heap mode, the pages are still allocated from the heap, but with the page size (if not 0)
+bool    pool_pages_init(const sx_alloc* alloc, pool_pages_mode mode, int page_size);
+
+// Parses "mode[:page KB]" of the command line, returns false if it's invalid
+bool    pool_pages_parse(const char* str, pool_pages_mode* mode, int* page_size);
+
+// Returns false if the process memory counters are not available on the platform
+bool    pool_pages_get_memory(pool_pages_memory* mem);
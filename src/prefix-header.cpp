@@ -0,0 +1,525 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "prefix-header.h"
+
+#include "sx/threads.h"
+#include "sx/hash.h"
+#include "sx/string.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+
+enum prefix_header__token_type
+{
+    TOKEN_END = 0,
+    TOKEN_IDENT,
+    TOKEN_PUNCT,
+    TOKEN_DIRECTIVE     // whole preprocessor line, with continued lines
+};
+
+struct prefix_header__token
+{
+    prefix_header__token_type   type;
+    int                         start;
+    int                         end;
+};
+
+struct prefix_header__scanner
+{
+    const char* text;
+    int         len;
+    int         pos;
+    bool        line_start;
+};
+
+struct prefix_header__func
+{
+    int                 start;      // end of the previous declaration, so comments before the function go with it
+    int                 end;        // after the closing brace
+    std::string         name;
+    std::vector<int>    refs;       // functions that are referenced by the definition
+    bool                keep;
+};
+
+struct prefix_header
+{
+    std::string                                         text;
+    bool                                                valid;
+    std::vector<prefix_header__func>                    funcs;
+    std::unordered_map<std::string, std::vector<int>>   names;  // function name -> overloads
+    std::vector<int>                                    roots;  // functions that are referenced by the rest
+};
+
+struct prefix_header_cache
+{
+    const sx_alloc*                                     alloc = nullptr;
+    sx_mutex                                            lock;
+    std::unordered_map<uint64_t, prefix_header*>        headers;    // hash of the content -> header
+    std::unordered_map<uint64_t, prefix_header_state>   states;
+};
+
+static inline bool prefix_header__is_ident_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool prefix_header__is_ident(char c)
+{
+    return prefix_header__is_ident_start(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool prefix_header__is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// 'pos' is after the opening "/*", returns the position after "*/"
+static int prefix_header__skip_block_comment(const char* text, int len, int pos)
+{
+    for (; pos + 1 < len; pos++) {
+        if (text[pos] == '*' && text[pos + 1] == '/')
+            return pos + 2;
+    }
+    return len;
+}
+
+static int prefix_header__skip_line(const char* text, int len, int pos)
+{
+    while (pos < len && text[pos] != '\n')
+        pos++;
+    return pos;
+}
+
+// Returns the end of the number, exponent signs are included
+static int prefix_header__skip_number(const char* text, int len, int pos)
+{
+    while (pos < len) {
+        char c = text[pos];
+        if (prefix_header__is_ident(c) || c == '.') {
+            pos++;
+        } else if ((c == '+' || c == '-') && (text[pos - 1] == 'e' || text[pos - 1] == 'E')) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+// Directive ends at the first newline that is not continued by a backslash, comments may span lines
+static int prefix_header__skip_directive(const char* text, int len, int pos)
+{
+    while (pos < len) {
+        char c = text[pos];
+        if (c == '\n') {
+            int p = pos - 1;
+            if (p >= 0 && text[p] == '\r')
+                p--;
+            if (p < 0 || text[p] != '\\')
+                break;
+            pos++;
+        } else if (c == '/' && pos + 1 < len && text[pos + 1] == '*') {
+            pos = prefix_header__skip_block_comment(text, len, pos + 2);
+        } else if (c == '/' && pos + 1 < len && text[pos + 1] == '/') {
+            pos = prefix_header__skip_line(text, len, pos);
+        } else {
+            pos++;
+        }
+    }
+    return pos;
+}
+
+// Comments, whitespace and numbers are skipped
+static prefix_header__token prefix_header__next(prefix_header__scanner* s)
+{
+    const char* text = s->text;
+    const int len = s->len;
+    while (s->pos < len) {
+        int pos = s->pos;
+        char c = text[pos];
+        char n = pos + 1 < len ? text[pos + 1] : 0;
+        if (c == '\n') {
+            s->line_start = true;
+            s->pos++;
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v') {
+            s->pos++;
+        } else if (c == '/' && n == '/') {
+            s->pos = prefix_header__skip_line(text, len, pos);
+        } else if (c == '/' && n == '*') {
+            s->pos = prefix_header__skip_block_comment(text, len, pos + 2);
+        } else if (c == '\\' && (n == '\n' || n == '\r')) {
+            s->pos += n == '\r' && pos + 2 < len && text[pos + 2] == '\n' ? 3 : 2;
+        } else if (c == '#' && s->line_start) {
+            s->pos = prefix_header__skip_directive(text, len, pos);
+            return {TOKEN_DIRECTIVE, pos, s->pos};
+        } else if (prefix_header__is_digit(c) || (c == '.' && prefix_header__is_digit(n))) {
+            s->line_start = false;
+            s->pos = prefix_header__skip_number(text, len, pos + 1);
+        } else if (prefix_header__is_ident_start(c)) {
+            s->line_start = false;
+            int end = pos + 1;
+            while (end < len && prefix_header__is_ident(text[end]))
+                end++;
+            s->pos = end;
+            return {TOKEN_IDENT, pos, end};
+        } else {
+            s->line_start = false;
+            s->pos++;
+            return {TOKEN_PUNCT, pos, pos + 1};
+        }
+    }
+    return {TOKEN_END, len, len};
+}
+
+// Calls 'callback' for every identifier in the range, including the ones in preprocessor directives
+template <typename Fn>
+static void prefix_header__for_each_ident(const char* text, int start, int end, Fn callback)
+{
+    prefix_header__scanner s = {text, end, start, false};
+    for (prefix_header__token tok = prefix_header__next(&s); tok.type != TOKEN_END; tok = prefix_header__next(&s)) {
+        if (tok.type == TOKEN_IDENT) {
+            callback(tok.start, tok.end);
+        } else if (tok.type == TOKEN_DIRECTIVE) {
+            // skip '#', so the directive is scanned as ordinary tokens
+            prefix_header__for_each_ident(text, tok.start + 1, tok.end, callback);
+        }
+    }
+}
+
+// Returns the directive name ("define", "include", ...) and sets 'pos' after it
+static std::string prefix_header__directive_name(const char* text, int end, int* pos)
+{
+    int p = *pos + 1;   // skip '#'
+    while (p < end && (text[p] == ' ' || text[p] == '\t'))
+        p++;
+    int start = p;
+    while (p < end && prefix_header__is_ident(text[p]))
+        p++;
+    *pos = p;
+    return std::string(text + start, p - start);
+}
+
+static void prefix_header__add_func_refs(const prefix_header* h, int start, int end, std::vector<int>* refs)
+{
+    const char* text = h->text.c_str();
+    prefix_header__for_each_ident(text, start, end, [h, text, refs](int s, int e) {
+        auto it = h->names.find(std::string(text + s, e - s));
+        if (it != h->names.end())
+            refs->insert(refs->end(), it->second.begin(), it->second.end());
+    });
+    std::sort(refs->begin(), refs->end());
+    refs->erase(std::unique(refs->begin(), refs->end()), refs->end());
+}
+
+// Finds the top-level function definitions: '{' that comes right after the closing ')' of a parameter list
+// Declarations are terminated by ';', '}' or a preprocessor line
+static bool prefix_header__parse(prefix_header* h)
+{
+    const char* text = h->text.c_str();
+    prefix_header__scanner s = {text, (int)h->text.size(), 0, true};
+    std::unordered_set<std::string> macros;
+
+    int depth = 0;
+    int paren = 0;
+    int decl_start = 0;
+    bool decl_has_tokens = false;
+    bool keep_next = false;             // directive in the middle of the declaration
+    prefix_header__token last_ident = {TOKEN_END, 0, 0};
+    prefix_header__token name = {TOKEN_END, 0, 0};
+    char prev = 0;                      // last token: 'i' for identifiers, or the punctuation character
+    bool in_func = false;
+    prefix_header__func func = {};
+
+    for (prefix_header__token tok = prefix_header__next(&s); tok.type != TOKEN_END; tok = prefix_header__next(&s)) {
+        if (tok.type == TOKEN_DIRECTIVE) {
+            if (depth == 0) {
+                keep_next |= decl_has_tokens;
+                decl_start = tok.end;
+                int pos = tok.start;
+                if (prefix_header__directive_name(text, tok.end, &pos) == "define") {
+                    while (pos < tok.end && (text[pos] == ' ' || text[pos] == '\t'))
+                        pos++;
+                    int start = pos;
+                    while (pos < tok.end && prefix_header__is_ident(text[pos]))
+                        pos++;
+                    macros.insert(std::string(text + start, pos - start));
+                }
+            } else if (in_func) {
+                func.keep = true;
+            }
+            prev = '#';
+            continue;
+        }
+
+        decl_has_tokens = true;
+        if (tok.type == TOKEN_IDENT) {
+            if (depth == 0 && paren == 0)
+                last_ident = tok;
+            prev = 'i';
+            continue;
+        }
+
+        char c = text[tok.start];
+        switch (c) {
+            case '(':
+                if (depth == 0) {
+                    if (paren == 0)
+                        name = prev == 'i' ? last_ident : prefix_header__token{TOKEN_END, 0, 0};
+                    paren++;
+                }
+                break;
+            case ')':
+                if (depth == 0 && --paren < 0)
+                    return false;
+                break;
+            case '{':
+                if (depth == 0 && paren == 0 && prev == ')' && name.type == TOKEN_IDENT) {
+                    in_func = true;
+                    func = prefix_header__func();
+                    func.start = decl_start;
+                    func.name = std::string(text + name.start, name.end - name.start);
+                    func.keep = keep_next;
+                }
+                depth++;
+                break;
+            case '}':
+                if (depth == 0 || paren != 0)
+                    return false;
+                if (--depth == 0) {
+                    if (in_func) {
+                        func.end = tok.end;
+                        h->funcs.push_back(std::move(func));
+                        in_func = false;
+                    }
+                    decl_start = tok.end;
+                    decl_has_tokens = false;
+                    keep_next = false;
+                    name.type = TOKEN_END;
+                }
+                break;
+            case ';':
+                if (depth == 0) {
+                    if (paren != 0)
+                        return false;
+                    decl_start = tok.end;
+                    decl_has_tokens = false;
+                    keep_next = false;
+                    name.type = TOKEN_END;
+                }
+                break;
+            default:
+                break;
+        }
+        prev = c;
+    }
+
+    if (depth != 0 || paren != 0 || h->funcs.empty())
+        return false;
+
+    // Entry point is never referenced, functions that are named by macros may be defined by the macro
+    for (int i = 0; i < (int)h->funcs.size(); i++) {
+        prefix_header__func& f = h->funcs[i];
+        if (f.name == "main" || macros.find(f.name) != macros.end())
+            f.keep = true;
+        h->names[f.name].push_back(i);
+    }
+
+    int start = 0;
+    for (prefix_header__func& f : h->funcs) {
+        prefix_header__add_func_refs(h, f.start, f.end, &f.refs);
+        prefix_header__add_func_refs(h, start, f.start, &h->roots);
+        start = f.end;
+    }
+    prefix_header__add_func_refs(h, start, (int)h->text.size(), &h->roots);
+    return true;
+}
+
+static void prefix_header__destroy(const sx_alloc* alloc, prefix_header* h)
+{
+    h->~prefix_header();
+    sx_free(alloc, h);
+}
+
+prefix_header_cache* prefix_header_create_cache(const sx_alloc* alloc)
+{
+    prefix_header_cache* c = new(sx_malloc(alloc, sizeof(prefix_header_cache))) prefix_header_cache;
+    sx_assert(c);
+    c->alloc = alloc;
+    sx_mutex_init(&c->lock);
+    return c;
+}
+
+void prefix_header_destroy_cache(prefix_header_cache* c)
+{
+    sx_assert(c);
+    for (auto& it : c->headers)
+        prefix_header__destroy(c->alloc, it.second);
+    sx_mutex_release(&c->lock);
+    c->~prefix_header_cache();
+    sx_free(c->alloc, c);
+}
+
+const prefix_header* prefix_header_analyze(prefix_header_cache* c, const char* text, int len)
+{
+    uint64_t hash = sx_hash_xxh64(text, (size_t)len, 0);
+    sx_mutex_lock(&c->lock);
+    auto it = c->headers.find(hash);
+    prefix_header* h = it != c->headers.end() ? it->second : nullptr;
+    sx_mutex_unlock(&c->lock);
+    if (h)
+        return h->valid ? h : nullptr;
+
+    // Analyze outside of the lock, if another thread analyzes the same header at the same time, the first one is kept
+    prefix_header* nh = new(sx_malloc(c->alloc, sizeof(prefix_header))) prefix_header();
+    sx_assert(nh);
+    nh->text.assign(text, len);
+    nh->valid = prefix_header__parse(nh);
+
+    sx_mutex_lock(&c->lock);
+    prefix_header*& entry = c->headers[hash];
+    if (!entry) {
+        entry = nh;
+        nh = nullptr;
+    }
+    h = entry;
+    sx_mutex_unlock(&c->lock);
+
+    if (nh)
+        prefix_header__destroy(c->alloc, nh);
+    return h->valid ? h : nullptr;
+}
+
+prefix_header_state prefix_header_get_state(prefix_header_cache* c, uint64_t key)
+{
+    sx_mutex_lock(&c->lock);
+    auto it = c->states.find(key);
+    prefix_header_state state = it != c->states.end() ? it->second : PREFIX_HEADER_STATE_UNKNOWN;
+    sx_mutex_unlock(&c->lock);
+    return state;
+}
+
+void prefix_header_set_state(prefix_header_cache* c, uint64_t key, prefix_header_state state)
+{
+    sx_mutex_lock(&c->lock);
+    c->states[key] = state;
+    sx_mutex_unlock(&c->lock);
+}
+
+void prefix_header_add_refs(const prefix_header* h, const char* text, int len, std::vector<uint8_t>* used)
+{
+    used->resize(h->funcs.size(), 0);
+    prefix_header__for_each_ident(text, 0, len, [h, text, used](int s, int e) {
+        auto it = h->names.find(std::string(text + s, e - s));
+        if (it != h->names.end()) {
+            for (int i : it->second)
+                (*used)[i] = 1;
+        }
+    });
+}
+
+int prefix_header_reduce(const prefix_header* h, const std::vector<uint8_t>& used, std::string* text)
+{
+    const int num_funcs = (int)h->funcs.size();
+    std::vector<uint8_t> reached(num_funcs, 0);
+    std::vector<int> stack;
+    for (int i = 0; i < num_funcs; i++) {
+        if (h->funcs[i].keep || (i < (int)used.size() && used[i]))
+            stack.push_back(i);
+    }
+    stack.insert(stack.end(), h->roots.begin(), h->roots.end());
+
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (reached[i])
+            continue;
+        reached[i] = 1;
+        for (int r : h->funcs[i].refs) {
+            if (!reached[r])
+                stack.push_back(r);
+        }
+    }
+
+    *text = h->text;
+    int num_removed = 0;
+    for (int i = 0; i < num_funcs; i++) {
+        if (reached[i])
+            continue;
+        const prefix_header__func& f = h->funcs[i];
+        for (int k = f.start; k < f.end; k++) {
+            char c = (*text)[k];
+            if (c != '\n' && c != '\r')
+                (*text)[k] = ' ';
+        }
+        num_removed++;
+    }
+    return num_removed;
+}
+
+void prefix_header_scan_includes(const char* text, int len, std::vector<prefix_header_include>* includes)
+{
+    prefix_header__scanner s = {text, len, 0, true};
+    for (prefix_header__token tok = prefix_header__next(&s); tok.type != TOKEN_END; tok = prefix_header__next(&s)) {
+        if (tok.type != TOKEN_DIRECTIVE)
+            continue;
+
+        int pos = tok.start;
+        if (prefix_header__directive_name(text, tok.end, &pos) != "include")
+            continue;
+        while (pos < tok.end && (text[pos] == ' ' || text[pos] == '\t'))
+            pos++;
+        if (pos == tok.end || (text[pos] != '"' && text[pos] != '<'))
+            continue;
+
+        char close = text[pos] == '"' ? '"' : '>';
+        int start = ++pos;
+        while (pos < tok.end && text[pos] != close && text[pos] != '\n')
+            pos++;
+        if (pos < tok.end && text[pos] == close) {
+            prefix_header_include inc;
+            inc.name.assign(text + start, pos - start);
+            inc.local = close == '"';
+            inc.start = tok.start;
+            inc.end = tok.end;
+            includes->push_back(std::move(inc));
+        }
+    }
+}
+
+uint64_t prefix_header_hash_source(const char* text, int len, uint64_t seed)
+{
+    // Comments are replaced by a space, and lines are trimmed
+    std::string code;
+    code.reserve(len);
+    int line_start = 0;
+    for (int pos = 0; pos < len; ) {
+        char c = text[pos];
+        char n = pos + 1 < len ? text[pos + 1] : 0;
+        if (c == '/' && n == '/') {
+            pos = prefix_header__skip_line(text, len, pos);
+        } else if (c == '/' && n == '*') {
+            pos = prefix_header__skip_block_comment(text, len, pos + 2);
+            code += ' ';
+        } else if (c == '\n' || c == '\r') {
+            while (!code.empty() && (int)code.size() > line_start &&
+                   (code.back() == ' ' || code.back() == '\t'))
+            {
+                code.pop_back();
+            }
+            if ((int)code.size() > line_start)
+                code += '\n';
+            line_start = (int)code.size();
+            pos++;
+        } else if ((c == ' ' || c == '\t') && (int)code.size() == line_start) {
+            pos++;
+        } else {
+            code += c;
+            pos++;
+        }
+    }
+    return sx_hash_xxh64(code.c_str(), code.size(), seed);
+}
@@ -0,0 +1,74 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Prefix header (--pch): a shared include library that shaders include first, like a precompiled header
+// Most of the parse time of such libraries goes to function bodies that the shader never calls, so instead of
+// parsing the whole header in every stage, the header is compiled once for every define set, and later stages
+// get a reduced header, where the definitions of the functions that they can't reach are replaced by whitespace
+//      - Headers are analyzed on the text level: top-level function definitions, and the identifiers that each
+//        definition references. Analysis is cached by the hash of the header's content
+//      - Functions are reached by name (all overloads), from the identifiers of the stage, the other included files,
+//        and the rest of the header (macros, globals, ...). Functions that have preprocessor directives inside,
+//        or are named after a macro of the header, are always kept
+//      - Newlines are kept, so line numbers of the messages don't change
+//      - Validation state of the header (compiled with the prefix of the stage and define set) is cached by key,
+//        see prefix_header_get_state
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+#include <string>
+#include <vector>
+
+struct prefix_header;
+struct prefix_header_cache;
+
+// #include directive of a source
+struct prefix_header_include
+{
+    std::string name;
+    bool        local;          // "name", <name> otherwise
+    int         start;          // offset of the directive line
+    int         end;            // offset of the end of the directive line
+};
+
+enum prefix_header_state
+{
+    PREFIX_HEADER_STATE_UNKNOWN = 0,
+    PREFIX_HEADER_STATE_VALID,
+    PREFIX_HEADER_STATE_WARNINGS,   // compiles, but stages use the full header so they report the same warnings
+    PREFIX_HEADER_STATE_INVALID
+};
+
+prefix_header_cache*    prefix_header_create_cache(const sx_alloc* alloc);
+void                    prefix_header_destroy_cache(prefix_header_cache* c);
+
+// Returns NULL if the header can't be analyzed (unbalanced braces, no functions, ...), in that case the header is
+// used as it is. Returned header is owned by the cache. Thread-safe
+const prefix_header*    prefix_header_analyze(prefix_header_cache* c, const char* text, int len);
+
+// Validation state of the header with the key (header contents, prefix of the stage, defines, stage), thread-safe
+prefix_header_state     prefix_header_get_state(prefix_header_cache* c, uint64_t key);
+void                    prefix_header_set_state(prefix_header_cache* c, uint64_t key, prefix_header_state state);
+
+// Marks the functions of the header that are referenced by the text, 'used' is resized for the header
+void                    prefix_header_add_refs(const prefix_header* h, const char* text, int len,
+                                               std::vector<uint8_t>* used);
+
+// Writes the header text to 'text' without the definitions of the functions that are not reachable from 'used'
+// Returns the number of removed definitions
+int                     prefix_header_reduce(const prefix_header* h, const std::vector<uint8_t>& used,
+                                             std::string* text);
+
+// #include directives of the source, in order, including the ones in inactive #if blocks
+void                    prefix_header_scan_includes(const char* text, int len,
+                                                    std::vector<prefix_header_include>* includes);
+
+// Hash of the source without comments and blank lines
+uint64_t                prefix_header_hash_source(const char* text, int len, uint64_t seed);
@@ -41,6 +41,11 @@ sgs_file* sgs_create_file(const sx_alloc* alloc, const char* filepath, sgs_shade
 void sgs_destroy_file(sgs_file* f)
 {
     sx_assert(f);
+    sx_array_free(f->alloc, f->stages);
+    if (f->code_block)
+        sx_free(f->alloc, f->code_block);
+    if (f->reflect_block)
+        sx_free(f->alloc, f->reflect_block);
     f->~sgs_file();
     sx_free(f->alloc, f);
 }
@@ -98,8 +103,10 @@ void sgs_add_stage_reflect(sgs_file* f, sgs_shader_stage stage, const char* refl
 
 bool sgs_commit(sgs_file* f)
 {
+    // Written to a temp file first, and moved over the output when it's complete
+    std::string temp_filepath = f->filepath + ".tmp";
     sx_file_writer writer;
-    if (!sx_file_open_writer(&writer, f->filepath.c_str(), 0))
+    if (!sx_file_open_writer(&writer, temp_filepath.c_str(), 0))
         return false;
 
     int reflect_start_offset = sizeof(sgs_file_header) + sizeof(sgs_file_stage)*sx_array_count(f->stages);
@@ -120,6 +127,10 @@ bool sgs_commit(sgs_file* f)
         sx_file_write(&writer, f->code_block, f->code_block_size);
     sx_file_close_writer(&writer);
 
+    if (!sx_os_rename(temp_filepath.c_str(), f->filepath.c_str())) {
+        sx_os_del(temp_filepath.c_str());
+        return false;
+    }
     return true;
 }
 
@@ -0,0 +1,156 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "sgv-file.h"
+
+#include "sx/io.h"
+#include "sx/os.h"
+#include "sx/string.h"
+#include "sx/hash.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+struct sgv_file__variant
+{
+    sgv_file_variant            hdr;
+    std::vector<sgs_file_stage> stages;     // offsets are relative to the data block
+};
+
+struct sgv_file
+{
+    const sx_alloc*                         alloc       = nullptr;
+    std::string                             filepath    = {};
+    sgv_file_header                         hdr         = {};
+    std::vector<sgv_file__variant>          variants;
+    std::unordered_map<uint32_t, int>       variant_indices;    // key -> index in variants
+    std::string                             data;
+    std::unordered_map<uint64_t, int>       strings;    // hash -> offset in data, for sharing identical strings
+};
+
+// Returns offset of the string in data block
+static int sgv_file__add_string(sgv_file* f, const char* str, int* size = nullptr)
+{
+    int len = sx_strlen(str) + 1;
+    if (size)
+        *size = len;
+
+    uint64_t hash = sx_hash_xxh64(str, len, 0);
+    auto it = f->strings.find(hash);
+    if (it != f->strings.end() && sx_strequal(f->data.c_str() + it->second, str))
+        return it->second;
+
+    int offset = (int)f->data.size();
+    f->data.append(str, len);
+    f->strings[hash] = offset;
+    return offset;
+}
+
+static sgv_file__variant* sgv_file__find_variant(sgv_file* f, uint32_t key)
+{
+    auto it = f->variant_indices.find(key);
+    return it != f->variant_indices.end() ? &f->variants[it->second] : nullptr;
+}
+
+sgv_file* sgv_create_file(const sx_alloc* alloc, const char* filepath, sgs_shader_lang lang, int profile_ver)
+{
+    sgv_file* f = new(sx_malloc(alloc, sizeof(sgv_file))) sgv_file;
+    sx_assert(f);
+    f->alloc = alloc;
+    f->filepath = filepath;
+
+    f->hdr.sig = SGV_FILE_SIG;
+    f->hdr.version = SGV_FILE_VERSION;
+    f->hdr.lang = lang;
+    f->hdr.profile_ver = profile_ver;
+    return f;
+}
+
+void sgv_destroy_file(sgv_file* f)
+{
+    sx_assert(f);
+    f->~sgv_file();
+    sx_free(f->alloc, f);
+}
+
+void sgv_add_variant(sgv_file* f, uint32_t key, const char* defines)
+{
+    sx_assert(!sgv_file__find_variant(f, key) && "variant key must be unique");
+
+    sgv_file__variant v;
+    sx_memset(&v.hdr, 0x0, sizeof(v.hdr));
+    v.hdr.key = key;
+    v.hdr.defines_offset = sgv_file__add_string(f, defines);
+    f->variant_indices[key] = (int)f->variants.size();
+    f->variants.push_back(std::move(v));
+    ++f->hdr.num_variants;
+}
+
+void sgv_add_variant_stage(sgv_file* f, uint32_t key, sgs_shader_stage stage, const char* code,
+                           const char* reflect)
+{
+    sgv_file__variant* v = sgv_file__find_variant(f, key);
+    sx_assert(v && "variant must be added first");
+
+    sgs_file_stage s;
+    s.stage = stage;
+    s.code_offset = sgv_file__add_string(f, code, &s.code_size);
+    s.reflect_offset = sgv_file__add_string(f, reflect, &s.reflect_size);
+    v->stages.push_back(s);
+    ++v->hdr.num_stages;
+}
+
+bool sgv_commit(sgv_file* f)
+{
+    std::sort(f->variants.begin(), f->variants.end(),
+              [](const sgv_file__variant& a, const sgv_file__variant& b) { return a.hdr.key < b.hdr.key; });
+    f->variant_indices.clear();
+    for (int i = 0; i < (int)f->variants.size(); i++)
+        f->variant_indices[f->variants[i].hdr.key] = i;
+
+    int num_stages = 0;
+    for (const sgv_file__variant& v : f->variants)
+        num_stages += (int)v.stages.size();
+
+    int stages_start_offset = sizeof(sgv_file_header) + sizeof(sgv_file_variant)*(int)f->variants.size();
+    int data_start_offset = stages_start_offset + sizeof(sgs_file_stage)*num_stages;
+
+    // Written to a temp file first, and moved over the output when it's complete
+    std::string temp_filepath = f->filepath + ".tmp";
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, temp_filepath.c_str(), 0))
+        return false;
+
+    sx_file_write(&writer, &f->hdr, sizeof(sgv_file_header));
+
+    // Fix the offsets to absolute position of the file
+    int stage_offset = stages_start_offset;
+    for (const sgv_file__variant& v : f->variants) {
+        sgv_file_variant hdr = v.hdr;
+        hdr.defines_offset += data_start_offset;
+        hdr.stages_offset = stage_offset;
+        sx_file_write(&writer, &hdr, sizeof(hdr));
+        stage_offset += sizeof(sgs_file_stage)*(int)v.stages.size();
+    }
+
+    for (const sgv_file__variant& v : f->variants) {
+        for (sgs_file_stage s : v.stages) {
+            s.code_offset += data_start_offset;
+            s.reflect_offset += data_start_offset;
+            sx_file_write(&writer, &s, sizeof(s));
+        }
+    }
+
+    bool r = sx_file_write(&writer, f->data.c_str(), (int)f->data.size()) == (int)f->data.size();
+    sx_file_close_writer(&writer);
+
+    if (!r || !sx_os_rename(temp_filepath.c_str(), f->filepath.c_str())) {
+        sx_os_del(temp_filepath.c_str());
+        return false;
+    }
+    return true;
+}
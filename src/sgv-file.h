@@ -0,0 +1,54 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// SGV: Archive of shader variants (--variants), every variant is a program with it's own stages, like SGS files
+// File layout:
+//      sgv_file_header
+//      sgv_file_variant[num_variants]      sorted by key, so variants can be found by binary search
+//      sgs_file_stage[...]                 stages of every variant, offsets are absolute positions in the file
+//      data block                          null-terminated defines, reflection json and code strings
+// Identical code and reflection strings are only stored once and shared between variants
+//
+#pragma once
+
+#include "sgs-file.h"
+
+#pragma pack(push, 1)
+
+#define SGV_FILE_SIG        0x31564753  // "SGV1"
+#define SGV_FILE_VERSION    100
+
+struct sgv_file_variant
+{
+    uint32_t    key;                // index of the variant in the permutation spec (see README)
+    int         defines_offset;     // defines of the variant, seperated by comma (USE_FOG,NUM_LIGHTS=4)
+    int         num_stages;
+    int         stages_offset;      // offset to the first sgs_file_stage of the variant
+};
+
+struct sgv_file_header
+{
+    uint32_t    sig;
+    int         version;
+    int         lang;               // sgs_shader_lang
+    int         profile_ver;
+    int         num_variants;
+    // sgv_file_variant* variants;
+};
+
+#pragma pack(pop)
+
+struct sgv_file;
+
+sgv_file* sgv_create_file(const sx_alloc* alloc, const char* filepath, sgs_shader_lang lang, int profile_ver);
+void      sgv_destroy_file(sgv_file* f);
+// Variants can be added in any order, but keys must be unique
+void      sgv_add_variant(sgv_file* f, uint32_t key, const char* defines);
+void      sgv_add_variant_stage(sgv_file* f, uint32_t key, sgs_shader_stage stage, const char* code,
+                                const char* reflect);
+bool      sgv_commit(sgv_file* f);
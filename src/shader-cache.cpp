@@ -0,0 +1,212 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+#include "shader-cache.h"
+
+#include "sx/io.h"
+#include "sx/array.h"
+#include "sx/os.h"
+#include "sx/string.h"
+#include "sx/hash.h"
+#include "sx/atomic.h"
+#include "sx/threads.h"
+
+#include <time.h>
+#include <algorithm>
+
+static const char* k_entry_ext = ".gcs";
+static const char* k_temp_ext = ".tmp";
+
+// Temp files that are older than this are left from crashed processes, and are deleted on eviction
+static const uint64_t k_stale_temp_age = 3600;
+
+struct shader_cache
+{
+    const sx_alloc* alloc       = nullptr;
+    std::string     dir         = {};
+    uint64_t        max_size    = 0;
+    sx_atomic_int   hits        = 0;
+    sx_atomic_int   misses      = 0;
+    sx_atomic_int   writes      = 0;
+    sx_atomic_int   evicted     = 0;
+    sx_atomic_int   temp_id     = 0;
+};
+
+struct shader_cache__file
+{
+    char        name[64];
+    uint64_t    size;
+    uint64_t    last_modified;
+};
+
+struct shader_cache__listdir_data
+{
+    const sx_alloc*     alloc;
+    shader_cache__file* files;      // sx_array
+    std::string         dir;
+};
+
+static std::string shader_cache__entry_path(const shader_cache* c, uint64_t key)
+{
+    char name[64];
+    sx_snprintf(name, sizeof(name), "/%016llx%s", (unsigned long long)key, k_entry_ext);
+    return c->dir + name;
+}
+
+static bool shader_cache__has_ext(const char* filename, const char* ext)
+{
+    int len = sx_strlen(filename);
+    int ext_len = sx_strlen(ext);
+    return len > ext_len && sx_strequal(filename + len - ext_len, ext);
+}
+
+shader_cache* shader_cache_create(const sx_alloc* alloc, const char* dir, uint64_t max_size)
+{
+    sx_assert(dir);
+    if (!sx_os_path_isdir(dir) && !sx_os_mkdir(dir) && !sx_os_path_isdir(dir))
+        return nullptr;
+
+    shader_cache* c = new(sx_malloc(alloc, sizeof(shader_cache))) shader_cache;
+    c->alloc = alloc;
+    c->dir = dir;
+    std::replace(c->dir.begin(), c->dir.end(), '\\', '/');
+    if (c->dir.back() == '/')
+        c->dir.pop_back();
+    c->max_size = max_size;
+    return c;
+}
+
+void shader_cache_destroy(shader_cache* c)
+{
+    sx_assert(c);
+    c->~shader_cache();
+    sx_free(c->alloc, c);
+}
+
+bool shader_cache_load(shader_cache* c, uint64_t key, std::string* code, std::string* reflect)
+{
+    std::string filepath = shader_cache__entry_path(c, key);
+    sx_mem_block* mem = sx_file_load_bin(c->alloc, filepath.c_str());
+    if (!mem) {
+        sx_atomic_incr(&c->misses);
+        return false;
+    }
+
+    const shader_cache_entry_header* hdr = (const shader_cache_entry_header*)mem->data;
+    const char* data = (const char*)mem->data + sizeof(shader_cache_entry_header);
+    bool valid = mem->size >= (int)sizeof(shader_cache_entry_header) &&
+                 hdr->sig == SHADER_CACHE_SIG && hdr->version == SHADER_CACHE_VERSION && hdr->key == key &&
+                 hdr->code_size >= 0 && hdr->reflect_size >= 0 &&
+                 (int)sizeof(shader_cache_entry_header) + hdr->code_size + hdr->reflect_size == mem->size &&
+                 sx_hash_xxh64(data, hdr->code_size + hdr->reflect_size, 0) == hdr->data_hash;
+
+    if (valid) {
+        code->assign(data, hdr->code_size);
+        reflect->assign(data + hdr->code_size, hdr->reflect_size);
+
+        // update modification time, which is the 'last used' time of the entry for LRU eviction
+        sx_os_touch(filepath.c_str());
+        sx_atomic_incr(&c->hits);
+    } else {
+        // corrupted or from older version, will be replaced by the new compilation result
+        sx_os_del(filepath.c_str());
+        sx_atomic_incr(&c->misses);
+    }
+
+    sx_mem_destroy_block(mem);
+    return valid;
+}
+
+bool shader_cache_store(shader_cache* c, uint64_t key, const std::string& code, const std::string& reflect)
+{
+    std::string filepath = shader_cache__entry_path(c, key);
+
+    // Write to a unique temp file first, then move it to the entry path, so other processes never see partial data
+    char temp_name[128];
+    sx_snprintf(temp_name, sizeof(temp_name), ".%d.%u.%d%s", sx_os_getpid(), sx_thread_tid(),
+                sx_atomic_incr(&c->temp_id), k_temp_ext);
+    std::string temp_filepath = filepath + temp_name;
+
+    std::string data = code + reflect;
+    shader_cache_entry_header hdr;
+    hdr.sig = SHADER_CACHE_SIG;
+    hdr.version = SHADER_CACHE_VERSION;
+    hdr.key = key;
+    hdr.data_hash = sx_hash_xxh64(data.c_str(), data.size(), 0);
+    hdr.code_size = (int)code.size();
+    hdr.reflect_size = (int)reflect.size();
+
+    sx_file_writer writer;
+    if (!sx_file_open_writer(&writer, temp_filepath.c_str()))
+        return false;
+    bool r = sx_file_write(&writer, &hdr, sizeof(hdr)) == sizeof(hdr) &&
+             sx_file_write(&writer, data.c_str(), (int)data.size()) == (int)data.size();
+    sx_file_close_writer(&writer);
+
+    if (!r || !sx_os_rename(temp_filepath.c_str(), filepath.c_str())) {
+        sx_os_del(temp_filepath.c_str());
+        return false;
+    }
+
+    sx_atomic_incr(&c->writes);
+    return true;
+}
+
+static void shader_cache__listdir_cb(const char* filename, const sx_file_info* info, void* user)
+{
+    shader_cache__listdir_data* ldata = (shader_cache__listdir_data*)user;
+    if (info->type != SX_FILE_TYPE_REGULAR)
+        return;
+
+    if (shader_cache__has_ext(filename, k_entry_ext)) {
+        shader_cache__file f;
+        sx_strcpy(f.name, sizeof(f.name), filename);
+        f.size = info->size;
+        f.last_modified = info->last_modified;
+        sx_array_push(ldata->alloc, ldata->files, f);
+    } else if (shader_cache__has_ext(filename, k_temp_ext) &&
+               info->last_modified + k_stale_temp_age < (uint64_t)time(nullptr)) {
+        sx_os_del((ldata->dir + "/" + filename).c_str());
+    }
+}
+
+// Removes least recently used entries until the size of the cache is below max_size
+// Other processes may evict at the same time, failing to delete a file that's already deleted is harmless
+void shader_cache_evict(shader_cache* c)
+{
+    shader_cache__listdir_data ldata = {c->alloc, nullptr, c->dir};
+    if (!sx_os_listdir(c->dir.c_str(), shader_cache__listdir_cb, &ldata))
+        return;
+
+    uint64_t total_size = 0;
+    int num_files = sx_array_count(ldata.files);
+    for (int i = 0; i < num_files; i++)
+        total_size += ldata.files[i].size;
+
+    if (total_size > c->max_size) {
+        std::sort(ldata.files, ldata.files + num_files,
+                  [](const shader_cache__file& a, const shader_cache__file& b) {
+                      return a.last_modified < b.last_modified;
+                  });
+
+        for (int i = 0; i < num_files && total_size > c->max_size; i++) {
+            if (sx_os_del((c->dir + "/" + ldata.files[i].name).c_str()))
+                sx_atomic_incr(&c->evicted);
+            total_size -= ldata.files[i].size;
+        }
+    }
+
+    sx_array_free(c->alloc, ldata.files);
+}
+
+shader_cache_stats shader_cache_get_stats(const shader_cache* c)
+{
+    shader_cache_stats stats;
+    stats.hits = c->hits;
+    stats.misses = c->misses;
+    stats.writes = c->writes;
+    stats.evicted = c->evicted;
+    return stats;
+}
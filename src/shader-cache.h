@@ -0,0 +1,52 @@
+//
+// Copyright 2018 Sepehr Taghdisian (septag@github). All rights reserved.
+// License: https://github.com/septag/glslcc#license-bsd-2-clause
+//
+
+//
+// File version: 1.0.0
+//
+// Content-addressed cache of compiled shader stages on disk
+// Every entry is a single file named by the 64bit key (xxh64) of the stage, that holds the code and reflection data
+//      - Entries are written to a temp file and renamed, so multiple processes can share the same cache directory
+//      - Least recently used entries are removed when the total size of the cache exceeds the maximum size
+//
+#pragma once
+
+#include "sx/allocator.h"
+
+#include <string>
+
+#pragma pack(push, 1)
+
+#define SHADER_CACHE_SIG        0x43534347  // "GCSC"
+#define SHADER_CACHE_VERSION    100
+
+struct shader_cache_entry_header
+{
+    uint32_t    sig;
+    int         version;
+    uint64_t    key;
+    uint64_t    data_hash;       // xxh64 of code + reflection data, for detecting corrupted entries
+    int         code_size;
+    int         reflect_size;
+};
+
+#pragma pack(pop)
+
+struct shader_cache_stats
+{
+    int         hits;
+    int         misses;
+    int         writes;
+    int         evicted;
+};
+
+struct shader_cache;
+
+shader_cache* shader_cache_create(const sx_alloc* alloc, const char* dir, uint64_t max_size);
+void          shader_cache_destroy(shader_cache* c);
+bool          shader_cache_load(shader_cache* c, uint64_t key, std::string* code, std::string* reflect);
+bool          shader_cache_store(shader_cache* c, uint64_t key, const std::string& code, const std::string& reflect);
+void          shader_cache_evict(shader_cache* c);
+shader_cache_stats shader_cache_get_stats(const shader_cache* c);